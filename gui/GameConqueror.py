@@ -1061,10 +1061,24 @@ class GameConqueror():
         if (match_count > SCAN_RESULT_LIST_LIMIT):
             self.scanresult_liststore.clear()
         else:
+            datatype = self.scan_data_type_combobox.get_active_text()
             self.command_lock.acquire()
-            list_bytes = self.backend.send_command('list', get_output=True)
+            if datatype in ('bytearray', 'string'):
+                # the values of these are longer than a match record holds
+                list_bytes = self.backend.send_command('list', get_output=True)
+                matches = None
+            else:
+                matches = self.backend.get_matches(0, SCAN_RESULT_LIST_LIMIT)
             self.command_lock.release()
-            lines = filter(None, misc.decode(list_bytes).split('\n'))
+            if matches is None:
+                matches = []
+                for line in filter(None, misc.decode(list_bytes).split('\n')):
+                    (mid, line) = line.split(']', 1)
+                    mid = int(mid.strip(' []'))
+                    (addr_str, off_str, rt, val, t) = list(map(str.strip, line.split(',')[:5]))
+                    (rid, off_str) = off_str.split('+')
+                    matches.append((mid, int(addr_str, 16), int(rid), int(off_str, 16),
+                                    rt, val, t.strip(' []')))
 
             self.scanresult_tv.set_model(None)
             # temporarily disable model for scanresult_liststore for the sake of performance
@@ -1072,11 +1086,7 @@ class GameConqueror():
             if misc.PY3K:
                 addr = GObject.Value(GObject.TYPE_UINT64)
                 off = GObject.Value(GObject.TYPE_UINT64)
-            for line in lines:
-                (mid, line) = line.split(']', 1)
-                mid = int(mid.strip(' []'))
-                (addr_str, off_str, rt, val, t) = list(map(str.strip, line.split(',')[:5]))
-                t = t.strip(' []')
+            for (mid, addr_int, rid, off_int, rt, val, t) in matches:
                 if t == 'unknown':
                     continue
                 # `insert_with_valuesv` has the same function of `append`, but it's 7x faster
@@ -1084,11 +1094,11 @@ class GameConqueror():
                 # See: https://bugzilla.gnome.org/show_bug.cgi?id=769532
                 # Still 5x faster even with the extra baggage
                 if misc.PY3K:
-                    addr.set_uint64(int(addr_str, 16))
-                    off.set_uint64(int(off_str.split('+')[1], 16))
+                    addr.set_uint64(addr_int)
+                    off.set_uint64(off_int)
                 else:
-                    addr = long(addr_str, 16)
-                    off = long(off_str.split('+')[1], 16)
+                    addr = long(addr_int)
+                    off = long(off_int)
                 self.scanresult_liststore.insert_with_valuesv(-1, [0, 1, 2, 3, 4, 5, 6], [addr, val, t, True, off, rt, mid])
                 # self.scanresult_liststore.append([addr, val, t, True, off, rt, mid])
             self.scanresult_tv.set_model(self.scanresult_liststore)
@@ -1113,28 +1123,44 @@ class GameConqueror():
             for i in self.cheatlist_liststore:
                 if i[1] and i[6]: # locked and valid
                     self.write_value(i[3], i[4], i[5]) # addr, typestr, value
-            # Update visible (and unlocked) cheat list rows
-            rows = self.get_visible_rows(self.cheatlist_tv)
-            for i in rows:
+            # Visible (and unlocked) cheat list rows and visible scanresult rows,
+            # all read at once
+            cheat_rows = []
+            for i in self.get_visible_rows(self.cheatlist_tv):
                 lockflag, locked, desc, addr, typestr, value, valid = self.cheatlist_liststore[i]
                 if valid and not locked:
-                    newvalue = self.read_value(addr, typestr, value)
-                    if newvalue is None:
-                        self.cheatlist_liststore[i] = (lockflag, False, desc, addr, typestr, '??', False)
-                    elif newvalue != value and not self.cheatlist_editing:
-                        self.cheatlist_liststore[i] = (lockflag, locked, desc, addr, typestr, str(newvalue), valid)
-            # Update visible scanresult rows
-            rows = self.get_visible_rows(self.scanresult_tv)
-            for i in rows:
-                row = self.scanresult_liststore[i]
-                addr, cur_value, scanmem_type, valid = row[:4]
+                    cheat_rows.append((i, typestr))
+            result_rows = []
+            for i in self.get_visible_rows(self.scanresult_tv):
+                addr, cur_value, scanmem_type, valid = self.scanresult_liststore[i][:4]
                 if valid:
-                    new_value = self.read_value(addr, TYPENAMES_S2G[scanmem_type.split(' ', 1)[0]], cur_value)
-                    if new_value is not None:
-                        row[1] = str(new_value)
-                    else:
-                        row[1] = '??'
-                        row[3] = False
+                    result_rows.append((i, TYPENAMES_S2G[scanmem_type.split(' ', 1)[0]]))
+            spans = []
+            for i, typestr in cheat_rows:
+                row = self.cheatlist_liststore[i]
+                spans.append((row[3], self.get_type_size(typestr, row[5])))
+            for i, typestr in result_rows:
+                row = self.scanresult_liststore[i]
+                spans.append((row[0], self.get_type_size(typestr, row[1])))
+            data = self.read_many(spans)
+
+            # Update the cheat list rows
+            for (i, typestr), databytes in zip(cheat_rows, data[:len(cheat_rows)]):
+                lockflag, locked, desc, addr, typestr, value, valid = self.cheatlist_liststore[i]
+                newvalue = self.bytes2value(typestr, databytes)
+                if newvalue is None:
+                    self.cheatlist_liststore[i] = (lockflag, False, desc, addr, typestr, '??', False)
+                elif newvalue != value and not self.cheatlist_editing:
+                    self.cheatlist_liststore[i] = (lockflag, locked, desc, addr, typestr, str(newvalue), valid)
+            # Update the scanresult rows
+            for (i, typestr), databytes in zip(result_rows, data[len(cheat_rows):]):
+                row = self.scanresult_liststore[i]
+                new_value = self.bytes2value(typestr, databytes)
+                if new_value is not None:
+                    row[1] = str(new_value)
+                else:
+                    row[1] = '??'
+                    row[3] = False
 
             Gdk.threads_leave()
             self.command_lock.release()
@@ -1158,6 +1184,32 @@ class GameConqueror():
             data = None
         return data
             
+    # The bytes at each (addr, length) of `spans`, None where they cannot be
+    # read, with the target stopped once; addr could be int or str
+    def read_many(self, spans):
+        if not spans:
+            return []
+        spans = [(addr, int(length or 0)) for addr, length in spans]
+        args = []
+        for addr, length in spans:
+            if not isinstance(addr,str):
+                addr = '%x'%(addr,)
+            args.append('%s:%d' % (addr, length))
+
+        self.command_lock.acquire()
+        data = self.backend.send_command('readmany ' + ' '.join(args), get_output=True)
+        self.command_lock.release()
+
+        # a byte per span telling whether it was read, then the bytes of all
+        if len(data) != len(spans) + sum(length for addr, length in spans):
+            return [None] * len(spans)
+        result = []
+        offset = len(spans)
+        for i, (addr, length) in enumerate(spans):
+            result.append(data[offset:offset+length] if data[i] else None)
+            offset += length
+        return result
+
     # addr could be int or str
     def write_value(self, addr, typestr, value):
         if not isinstance(addr,str):
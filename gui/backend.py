@@ -20,10 +20,61 @@
 import sys
 import os
 import ctypes
+import struct
 import tempfile
 
 import misc
 
+# sm_match_record_t of scanmem.h
+class MatchRecord(ctypes.Structure):
+    _fields_ = [('address', ctypes.c_uint64)
+               ,('offset', ctypes.c_uint64)
+               ,('value', ctypes.c_uint64)
+               ,('region_id', ctypes.c_uint32)
+               ,('flags', ctypes.c_uint16)
+               ,('region_type', ctypes.c_uint8)
+               ,('reserved', ctypes.c_uint8)
+               ]
+
+REGION_TYPE_NAMES = ['misc', 'code', 'exe', 'heap', 'stack']
+
+# match_flags of value.h: name, bit of the unsigned type, bit of the signed type
+INTEGER_FLAGS = [('I64', 1 << 6, 1 << 7, 'Q', 'q')
+                ,('I32', 1 << 4, 1 << 5, 'I', 'i')
+                ,('I16', 1 << 2, 1 << 3, 'H', 'h')
+                ,('I8', 1 << 0, 1 << 1, 'B', 'b')
+                ]
+FLAG_F32 = 1 << 8
+FLAG_F64 = 1 << 9
+
+# the value and the types of a numeric match, the way valtostr() prints them
+def format_match_value(value, flags):
+    # the number in host byte order, already swapped back by the library
+    raw = struct.pack('=Q', value)
+    types = []
+    text = None
+    for (name, u, s, ufmt, sfmt) in INTEGER_FLAGS:
+        if flags & u and flags & s:
+            types.append(name)
+        elif flags & u:
+            types.append(name + 'u')
+        elif flags & s:
+            types.append(name + 's')
+        if text is None and flags & (u | s):
+            fmt = ufmt if flags & u else sfmt
+            text = str(struct.unpack('=' + fmt, raw[:struct.calcsize(fmt)])[0])
+    if flags & FLAG_F64:
+        types.append('F64')
+    if flags & FLAG_F32:
+        types.append('F32')
+    if text is None and flags & FLAG_F64:
+        text = '%g' % struct.unpack('=d', raw)[0]
+    elif text is None and flags & FLAG_F32:
+        text = '%g' % struct.unpack('=f', raw[:4])[0]
+    if text is None:
+        return ('unknown', 'unknown')
+    return (text, ' '.join(types))
+
 class GameConquerorBackend():
     BACKEND_FUNCS = {
         'sm_init' : (ctypes.c_bool, ),
@@ -33,6 +84,7 @@ class GameConquerorBackend():
         'sm_get_num_matches' : (ctypes.c_ulong, ),
         'sm_get_version' : (ctypes.c_char_p, ),
         'sm_get_scan_progress' : (ctypes.c_double, ),
+        'sm_get_matches' : (ctypes.c_size_t, ctypes.c_size_t, ctypes.c_size_t, ctypes.POINTER(MatchRecord)),
         'sm_set_stop_flag' : (ctypes.c_bool, )
     }
 
@@ -70,6 +122,20 @@ class GameConquerorBackend():
     def get_match_count(self):
         return self.lib.sm_get_num_matches()
 
+    # The numeric matches with ids from `first` on, at most `count` of them, as
+    # tuples (match-id, address, region id, offset, region type, value, types);
+    # the fields `list` prints, without formatting and parsing all of them.
+    def get_matches(self, first, count):
+        records = (MatchRecord * count)()
+        n = self.lib.sm_get_matches(first, count, records)
+        matches = []
+        for i in range(n):
+            r = records[i]
+            (value, types) = format_match_value(r.value, r.flags)
+            region_type = REGION_TYPE_NAMES[r.region_type] if r.region_id != 0xffffffff else '??'
+            matches.append((first + i, r.address, r.region_id, r.offset, region_type, value, types))
+        return matches
+
     def get_version(self):
         return misc.decode(self.lib.sm_get_version())
 
@@ -0,0 +1,382 @@
+/*
+    Saving the memory of a target to an image, and reading it back.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "core.h"
+#include "show_message.h"
+
+static inline uint64_t page_align(uint64_t n, uint64_t page_size)
+{
+    return (n + page_size - 1) & ~(page_size - 1);
+}
+
+static bool transfer_at(int fd, char *p, size_t len, off_t offset, bool write)
+{
+    while (len > 0) {
+        ssize_t n = write ? pwrite(fd, p, len, offset) : pread(fd, p, len, offset);
+
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool sm_read_at(int fd, void *buf, size_t len, off_t offset)
+{
+    return transfer_at(fd, buf, len, offset, false);
+}
+
+bool sm_write_at(int fd, const void *buf, size_t len, off_t offset)
+{
+    return transfer_at(fd, (char *) buf, len, offset, true);
+}
+
+bool sm_savecore(globals_t *vars, const char *path)
+{
+    const region_table_t *table = vars->regions;
+    size_t count = table->size, num_holes = 0, i;
+    uint64_t page_size = sysconf(_SC_PAGESIZE), pos, names_size = 0, name_pos = 0;
+    unsigned long long missing = 0;
+    sm_core_header_t header;
+    sm_core_region_t *regions;
+    sm_core_hole_t *core_holes = NULL;
+    address_range_t *ranges, *holes = NULL;
+    off_t *offsets;
+    char *names;
+    bool residency, ret = false;
+    int fd = -1;
+
+    if (count == 0) {
+        show_error("there are no regions to save.\n");
+        return false;
+    }
+
+    /* an image saved again keeps what it knows */
+    if (vars->image)
+        residency = (vars->image->header.flags & SM_CORE_RESIDENCY) != 0;
+    else
+        residency = sm_readsmaps(vars->target, vars->regions);
+
+    for (i = 0; i < count; i++)
+        names_size += strlen(table->regions[i]->filename) + 1;
+
+    regions = calloc(count, sizeof(sm_core_region_t));
+    ranges = calloc(count, sizeof(address_range_t));
+    offsets = calloc(count, sizeof(off_t));
+    names = malloc(names_size);
+    if (!regions || !ranges || !offsets || !names) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto out;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SM_CORE_MAGIC, sizeof(header.magic));
+    header.num_regions = count;
+    header.flags = residency ? SM_CORE_RESIDENCY : 0;
+    header.names_offset = sizeof(header) + count * sizeof(sm_core_region_t);
+    header.names_size = names_size;
+    header.pid = vars->image ? vars->image->header.pid : vars->target;
+    header.region_scan_level = vars->image ? vars->image->header.region_scan_level
+                                           : vars->options.region_scan_level;
+    header.time = time(NULL);
+
+    /* every region starts on a page, so that pages of zeros can be holes */
+    pos = page_align(header.names_offset + names_size, page_size);
+    for (i = 0; i < count; i++) {
+        const region_t *r = table->regions[i];
+        sm_core_region_t *c = &regions[i];
+        size_t len = strlen(r->filename);
+
+        c->start = r->start;
+        c->size = r->size;
+        c->load_addr = r->load_addr;
+        c->data_offset = pos;
+        c->offset = r->offset;
+        c->inode = r->inode;
+        c->rss = r->rss;
+        c->anonymous = r->anonymous;
+        c->dirty = r->dirty;
+        c->name_offset = name_pos;
+        c->name_length = len;
+        c->id = r->id;
+        c->type = r->type;
+        c->flags = (r->flags.read ? SM_CORE_READ : 0) |
+                   (r->flags.write ? SM_CORE_WRITE : 0) |
+                   (r->flags.exec ? SM_CORE_EXEC : 0) |
+                   (r->flags.shared ? SM_CORE_SHARED : 0) |
+                   (r->flags.private ? SM_CORE_PRIVATE : 0);
+        memcpy(names + name_pos, r->filename, len + 1);
+        name_pos += len + 1;
+
+        ranges[i].start = r->start;
+        ranges[i].end = r->start + r->size;
+        offsets[i] = (off_t) pos;
+        pos += page_align(r->size, page_size);
+    }
+    header.holes_offset = pos;
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+        show_error("failed to open `%s`: %s.\n", path, strerror(errno));
+        goto out;
+    }
+
+    if (!sm_dump_memory(vars, ranges, offsets, count, fd, &holes, &num_holes))
+        goto out;
+    if (vars->stop_flag) {
+        show_warn("interrupted, the image is not saved.\n");
+        goto out;
+    }
+
+    if (num_holes > 0 && (core_holes = calloc(num_holes, sizeof(sm_core_hole_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto out;
+    }
+    for (i = 0; i < num_holes; i++) {
+        core_holes[i].start = holes[i].start;
+        core_holes[i].end = holes[i].end;
+        missing += holes[i].end - holes[i].start;
+    }
+    header.num_holes = num_holes;
+
+    /* the header goes last, an image is not one before it is complete */
+    if (!sm_write_at(fd, core_holes, num_holes * sizeof(sm_core_hole_t), (off_t) header.holes_offset) ||
+        !sm_write_at(fd, regions, count * sizeof(sm_core_region_t), sizeof(header)) ||
+        !sm_write_at(fd, names, names_size, (off_t) header.names_offset) ||
+        !sm_write_at(fd, &header, sizeof(header), 0)) {
+        show_error("failed to write `%s`: %s.\n", path, strerror(errno));
+        goto out;
+    }
+    ret = true;
+
+    show_info("saved %zu regions of %d to `%s`.\n", count, header.pid, path);
+    if (missing > 0)
+        show_warn("%llu bytes could not be read, they are missing from the image.\n", missing);
+
+out:
+    if (fd != -1 && close(fd) == -1 && ret) {
+        show_error("failed to write `%s`: %s.\n", path, strerror(errno));
+        ret = false;
+    }
+    if (fd != -1 && !ret)
+        unlink(path);
+    free(regions);
+    free(ranges);
+    free(offsets);
+    free(names);
+    free(holes);
+    free(core_holes);
+    return ret;
+}
+
+sm_image_t *sm_image_open(const char *path)
+{
+    sm_image_t *image;
+    sm_core_header_t *h;
+    struct stat st;
+    uint64_t size, prev_end = 0;
+    size_t i;
+
+    if ((image = calloc(1, sizeof(sm_image_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return NULL;
+    }
+    h = &image->header;
+
+    if ((image->fd = open(path, O_RDONLY)) == -1) {
+        show_error("failed to open `%s`: %s.\n", path, strerror(errno));
+        free(image);
+        return NULL;
+    }
+    if (fstat(image->fd, &st) == -1 || !sm_read_at(image->fd, h, sizeof(*h), 0) ||
+        memcmp(h->magic, SM_CORE_MAGIC, sizeof(h->magic)) != 0) {
+        show_error("`%s` is not an image, see `help savecore`.\n", path);
+        goto fail;
+    }
+
+    /* everything the header points to has to be in the file */
+    size = st.st_size;
+    if (h->num_regions > (size - sizeof(*h)) / sizeof(sm_core_region_t) ||
+        h->names_offset > size || h->names_size > size - h->names_offset ||
+        h->holes_offset > size || h->num_holes > (size - h->holes_offset) / sizeof(sm_core_hole_t))
+        goto corrupt;
+
+    image->regions = calloc(h->num_regions, sizeof(sm_core_region_t));
+    image->names = malloc(h->names_size + 1);
+    image->holes = calloc(h->num_holes, sizeof(sm_core_hole_t));
+    image->path = strdup(path);
+    if ((h->num_regions && !image->regions) || !image->names ||
+        (h->num_holes && !image->holes) || !image->path) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto fail;
+    }
+    if (!sm_read_at(image->fd, image->regions, h->num_regions * sizeof(sm_core_region_t), sizeof(*h)) ||
+        !sm_read_at(image->fd, image->names, h->names_size, (off_t) h->names_offset) ||
+        !sm_read_at(image->fd, image->holes, h->num_holes * sizeof(sm_core_hole_t), (off_t) h->holes_offset))
+        goto corrupt;
+    image->names[h->names_size] = '\0';
+
+    /* the regions are searched by address, they have to be in order */
+    for (i = 0; i < h->num_regions; i++) {
+        const sm_core_region_t *c = &image->regions[i];
+
+        if (c->start < prev_end || c->start + c->size < c->start ||
+            c->name_offset > h->names_size || c->name_length > h->names_size - c->name_offset ||
+            c->type > REGION_TYPE_STACK)
+            goto corrupt;
+        prev_end = c->start + c->size;
+    }
+    for (i = 1; i < h->num_holes; i++) {
+        if (image->holes[i].start < image->holes[i - 1].end)
+            goto corrupt;
+    }
+
+    return image;
+
+corrupt:
+    show_error("`%s` is damaged.\n", path);
+fail:
+    sm_image_close(image);
+    return NULL;
+}
+
+void sm_image_close(sm_image_t *image)
+{
+    if (image == NULL)
+        return;
+    if (image->fd != -1)
+        close(image->fd);
+    free(image->regions);
+    free(image->names);
+    free(image->holes);
+    free(image->path);
+    free(image);
+}
+
+/* the region containing `addr`, or NULL */
+static const sm_core_region_t *find_region(const sm_image_t *image, uintptr_t addr)
+{
+    size_t lo = 0, hi = image->header.num_regions;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (image->regions[mid].start + image->regions[mid].size <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < image->header.num_regions && image->regions[lo].start <= addr)
+        return &image->regions[lo];
+    return NULL;
+}
+
+/* the first hole ending above `addr`, or NULL */
+static const sm_core_hole_t *next_hole(const sm_image_t *image, uintptr_t addr)
+{
+    size_t lo = 0, hi = image->header.num_holes;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (image->holes[mid].end <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < image->header.num_holes) ? &image->holes[lo] : NULL;
+}
+
+size_t sm_image_read(sm_image_t *image, uint8_t *dest, uintptr_t addr, size_t size)
+{
+    size_t nread = 0;
+
+    /* regions next to each other are read in one go, like in the target */
+    while (nread < size) {
+        uintptr_t at = addr + nread;
+        const sm_core_region_t *r = find_region(image, at);
+        const sm_core_hole_t *hole = next_hole(image, at);
+        size_t n;
+        ssize_t got;
+
+        if (r == NULL || (hole && hole->start <= at))
+            break;
+        n = MIN(size - nread, r->start + r->size - at);
+        if (hole && hole->start - at < n)
+            n = hole->start - at;
+
+        got = pread(image->fd, dest + nread, n, (off_t) (r->data_offset + (at - r->start)));
+        if (got == -1 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        nread += got;
+    }
+    return nread;
+}
+
+bool sm_image_regions(const sm_image_t *image, region_table_t *regions)
+{
+    size_t i;
+
+    for (i = 0; i < image->header.num_regions; i++) {
+        const sm_core_region_t *c = &image->regions[i];
+        region_t *r;
+
+        if ((r = rt_alloc(regions, c->name_length)) == NULL)
+            return false;
+        r->start = c->start;
+        r->size = c->size;
+        r->type = c->type;
+        r->load_addr = c->load_addr;
+        r->flags.read = (c->flags & SM_CORE_READ) != 0;
+        r->flags.write = (c->flags & SM_CORE_WRITE) != 0;
+        r->flags.exec = (c->flags & SM_CORE_EXEC) != 0;
+        r->flags.shared = (c->flags & SM_CORE_SHARED) != 0;
+        r->flags.private = (c->flags & SM_CORE_PRIVATE) != 0;
+        r->offset = c->offset;
+        r->inode = c->inode;
+        r->rss = c->rss;
+        r->anonymous = c->anonymous;
+        r->dirty = c->dirty;
+        r->id = c->id;
+        memcpy(r->filename, image->names + c->name_offset, c->name_length);
+        r->filename[c->name_length] = '\0';
+        if (!rt_append(regions, r))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+/*
+    Saving the memory of a target to an image, and reading it back.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_H
+#define CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "maps.h"
+#include "scanmem.h"
+
+/*
+ * An image holds the regions of a target as they were when it was saved,
+ * in the byte order of the host:
+ *
+ *   sm_core_header_t               at the start of the file
+ *   sm_core_region_t[num_regions]  sorted by address
+ *   names                          the file names of the regions, each
+ *                                  followed by a zero
+ *   contents                       of every region, from a page boundary;
+ *                                  pages of zeros and what could not be
+ *                                  read are holes in the file
+ *   sm_core_hole_t[num_holes]      what could not be read, sorted
+ */
+#define SM_CORE_MAGIC "SMCORE\1\0"
+
+/* header flags */
+#define SM_CORE_RESIDENCY 1         /* rss, anonymous and dirty are known */
+
+/* region flags */
+#define SM_CORE_READ 1
+#define SM_CORE_WRITE 2
+#define SM_CORE_EXEC 4
+#define SM_CORE_SHARED 8
+#define SM_CORE_PRIVATE 16
+
+typedef struct {
+    char magic[8];
+    uint32_t num_regions;
+    uint32_t flags;
+    uint64_t num_holes;
+    uint64_t holes_offset;          /* of the holes in the file */
+    uint64_t names_offset;
+    uint64_t names_size;
+    int32_t pid;                    /* of the target */
+    uint32_t region_scan_level;     /* which regions were saved */
+    uint64_t time;                  /* seconds since the epoch */
+} sm_core_header_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t size;
+    uint64_t load_addr;
+    uint64_t data_offset;           /* of the contents in the image */
+    uint64_t offset;                /* into the mapped file */
+    uint64_t inode;
+    uint64_t rss;
+    uint64_t anonymous;
+    uint64_t dirty;
+    uint64_t name_offset;           /* into the names */
+    uint32_t name_length;
+    uint32_t id;
+    uint32_t type;                  /* a region_type_t */
+    uint32_t flags;                 /* SM_CORE_READ... */
+} sm_core_region_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+} sm_core_hole_t;
+
+/* An open image. It is only read with pread(), so that the readers of
+ * several threads can share it. */
+typedef struct sm_image {
+    int fd;
+    char *path;
+    sm_core_header_t header;
+    sm_core_region_t *regions;
+    char *names;
+    sm_core_hole_t *holes;
+} sm_image_t;
+
+/* Save the regions of `vars` to `path`, with the target stopped once.
+ * Gives up if `stop_flag` is set, nothing is left at `path` then. */
+bool sm_savecore(globals_t *vars, const char *path);
+
+sm_image_t *sm_image_open(const char *path);
+void sm_image_close(sm_image_t *image);
+
+/* like reading the target when it was saved: up to `size` bytes from
+ * `addr`, stopping where it was not mapped or could not be read */
+size_t sm_image_read(sm_image_t *image, uint8_t *dest, uintptr_t addr, size_t size);
+
+/* add the regions of `image` to the empty table `regions`, with their ids */
+bool sm_image_regions(const sm_image_t *image, region_table_t *regions);
+
+/* all of `len` bytes at `offset` of `fd`, false on an error or the end of it */
+bool sm_read_at(int fd, void *buf, size_t len, off_t offset);
+bool sm_write_at(int fd, const void *buf, size_t len, off_t offset);
+
+#endif /* CORE_H */
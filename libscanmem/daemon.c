@@ -0,0 +1,505 @@
+/*
+    Serving the session to other processes over a unix socket.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "common.h"
+#include "daemon.h"
+#include "scanmem.h"
+#include "show_message.h"
+
+/* what is read from a client at once */
+#define READ_SIZE (1 << 16)
+
+typedef struct {
+    int fd;
+    bool eof;                   /* no more requests, answer and close */
+    uint8_t *in;                /* requests received, the last one maybe partly */
+    size_t in_length, in_capacity;
+    uint8_t *out;               /* responses not sent yet, from `out_sent` */
+    size_t out_length, out_capacity, out_sent;
+} client_t;
+
+static bool reserve(uint8_t **buf, size_t *capacity, size_t needed)
+{
+    size_t grown = *capacity ? *capacity : READ_SIZE;
+    uint8_t *p;
+
+    if (needed <= *capacity)
+        return true;
+    while (grown < needed)
+        grown *= 2;
+    if ((p = realloc(*buf, grown)) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return false;
+    }
+    *buf = p;
+    *capacity = grown;
+    return true;
+}
+
+/* Make room for a response of up to `length` bytes and return where its
+ * payload goes, respond_end() then completes it. Payloads are not aligned. */
+static uint8_t *respond(client_t *client, size_t length)
+{
+    if (!reserve(&client->out, &client->out_capacity,
+                 client->out_length + sizeof(sm_daemon_header_t) + length))
+        return NULL;
+    return client->out + client->out_length + sizeof(sm_daemon_header_t);
+}
+
+static void respond_end(client_t *client, uint32_t tag, uint16_t status, size_t length)
+{
+    sm_daemon_header_t header;
+
+    memset(&header, 0, sizeof(header));
+    header.op = status;
+    header.tag = tag;
+    header.length = (status == SM_DAEMON_OK) ? length : 0;
+    memcpy(client->out + client->out_length, &header, sizeof(header));
+    client->out_length += sizeof(header) + header.length;
+}
+
+static uint16_t handle_scan(const uint8_t *payload, uint64_t *num_matches)
+{
+    sm_daemon_scan_t scan;
+    uservalue_t values[2];
+    int k;
+
+    memcpy(&scan, payload, sizeof(scan));
+    if (scan.match_type > MATCHDECREASEDBY)
+        return SM_DAEMON_BAD_REQUEST;
+    if (sm_globals.options.scan_data_type == BYTEARRAY || sm_globals.options.scan_data_type == STRING) {
+        show_error("scan_data_type is not a number, see `help option`.\n");
+        return SM_DAEMON_FAILED;
+    }
+
+    for (k = 0; k < 2; k++) {
+        if (scan.is_float) {
+            double f;
+
+            memcpy(&f, &scan.values[k], sizeof(f));
+            set_uservalue_float(&values[k], f);
+        } else {
+            set_uservalue_int(&values[k], (int64_t) scan.values[k]);
+        }
+    }
+    if (scan.match_type == MATCHRANGE)
+        values[0].flags &= values[1].flags;
+
+    if (!sm_scan(scan.match_type, values))
+        return SM_DAEMON_FAILED;
+    *num_matches = sm_get_num_matches();
+    return SM_DAEMON_OK;
+}
+
+static uint16_t handle_list(client_t *client, const sm_daemon_range_t *range, size_t *length)
+{
+    size_t count = MIN(range->count, SM_DAEMON_MAX_PAYLOAD / sizeof(sm_match_record_t));
+    sm_match_record_t *records;
+    uint8_t *out;
+    size_t n;
+
+    if ((records = calloc(count ? count : 1, sizeof(sm_match_record_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return SM_DAEMON_FAILED;
+    }
+    n = sm_get_matches(range->first, count, records);
+    *length = n * sizeof(sm_match_record_t);
+    if ((out = respond(client, *length)) == NULL) {
+        free(records);
+        return SM_DAEMON_FAILED;
+    }
+    memcpy(out, records, *length);
+    free(records);
+    return SM_DAEMON_OK;
+}
+
+static uint16_t handle_regions(client_t *client, const sm_daemon_range_t *range, size_t *length)
+{
+    size_t count = MIN(range->count, sm_get_num_regions());
+    sm_region_record_t *records;
+    size_t n, i;
+
+    if ((records = calloc(count ? count : 1, sizeof(sm_region_record_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return SM_DAEMON_FAILED;
+    }
+    n = sm_get_regions(range->first, count, records);
+
+    /* as many as fit in a payload */
+    *length = 0;
+    for (i = 0; i < n; i++) {
+        sm_daemon_region_t region;
+        size_t name_length = MIN(strlen(records[i].filename), UINT16_MAX);
+        uint8_t *out;
+
+        if (*length + sizeof(region) + name_length > SM_DAEMON_MAX_PAYLOAD)
+            break;
+        if ((out = respond(client, *length + sizeof(region) + name_length)) == NULL) {
+            free(records);
+            return SM_DAEMON_FAILED;
+        }
+        memset(&region, 0, sizeof(region));
+        region.start = records[i].start;
+        region.size = records[i].size;
+        region.load_addr = records[i].load_addr;
+        region.id = records[i].id;
+        region.type = records[i].type;
+        region.flags = records[i].flags;
+        region.name_length = name_length;
+        memcpy(out + *length, &region, sizeof(region));
+        memcpy(out + *length + sizeof(region), records[i].filename, name_length);
+        *length += sizeof(region) + name_length;
+    }
+    free(records);
+    return SM_DAEMON_OK;
+}
+
+static uint16_t handle_readmany(client_t *client, const uint8_t *payload, size_t count,
+                                size_t *length)
+{
+    sm_read_span_t *spans;
+    uint8_t *out;
+    size_t total = count, i;
+    uint16_t status = SM_DAEMON_OK;
+
+    if ((spans = calloc(count ? count : 1, sizeof(sm_read_span_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return SM_DAEMON_FAILED;
+    }
+    for (i = 0; i < count; i++) {
+        sm_daemon_read_t rd;
+
+        memcpy(&rd, payload + i * sizeof(rd), sizeof(rd));
+        spans[i].address = rd.address;
+        spans[i].length = rd.length;
+        total += rd.length;
+    }
+
+    if (total > SM_DAEMON_MAX_PAYLOAD) {
+        status = SM_DAEMON_BAD_REQUEST;
+    } else if ((out = respond(client, total)) == NULL || !sm_read_many(spans, count, out + count)) {
+        status = SM_DAEMON_FAILED;
+    } else {
+        for (i = 0; i < count; i++)
+            out[i] = spans[i].ok ? 1 : 0;
+        *length = total;
+    }
+    free(spans);
+    return status;
+}
+
+/* Answer one request. Returns false if the client cannot be answered
+ * anymore, a failed request is answered with its status. */
+static bool handle(client_t *client, const sm_daemon_header_t *request, const uint8_t *payload)
+{
+    uint16_t status = SM_DAEMON_BAD_REQUEST;
+    size_t length = 0;
+    uint8_t *out;
+
+    switch (request->op) {
+    case SM_DAEMON_VERSION:
+        if (request->length == 0 && (out = respond(client, sizeof(uint32_t)))) {
+            uint32_t version = sm_get_api_version();
+
+            memcpy(out, &version, sizeof(version));
+            length = sizeof(version);
+            status = SM_DAEMON_OK;
+        }
+        break;
+    case SM_DAEMON_COMMAND: {
+        char *line;
+
+        if ((line = malloc(request->length + 1)) == NULL) {
+            show_error("sorry, there was a memory allocation error.\n");
+            return false;
+        }
+        memcpy(line, payload, request->length);
+        line[request->length] = '\0';
+        status = sm_exec_cmd(line) ? SM_DAEMON_OK : SM_DAEMON_FAILED;
+        free(line);
+        break;
+    }
+    case SM_DAEMON_SCAN:
+        if (request->length == sizeof(sm_daemon_scan_t)) {
+            uint64_t num_matches = 0;
+
+            status = handle_scan(payload, &num_matches);
+            if (status == SM_DAEMON_OK && (out = respond(client, sizeof(num_matches)))) {
+                memcpy(out, &num_matches, sizeof(num_matches));
+                length = sizeof(num_matches);
+            }
+        }
+        break;
+    case SM_DAEMON_STATUS:
+        if (request->length == 0 && (out = respond(client, sizeof(sm_daemon_status_t)))) {
+            sm_daemon_status_t st;
+
+            memset(&st, 0, sizeof(st));
+            st.num_matches = sm_get_num_matches();
+            st.num_regions = sm_get_num_regions();
+            st.scan_progress = sm_get_scan_progress();
+            st.target = sm_globals.target;
+            memcpy(out, &st, sizeof(st));
+            length = sizeof(st);
+            status = SM_DAEMON_OK;
+        }
+        break;
+    case SM_DAEMON_LIST:
+    case SM_DAEMON_REGIONS:
+        if (request->length == sizeof(sm_daemon_range_t)) {
+            sm_daemon_range_t range;
+
+            memcpy(&range, payload, sizeof(range));
+            if (request->op == SM_DAEMON_LIST)
+                status = handle_list(client, &range, &length);
+            else
+                status = handle_regions(client, &range, &length);
+        }
+        break;
+    case SM_DAEMON_READ:
+        if (request->length == sizeof(sm_daemon_read_t)) {
+            sm_daemon_read_t rd;
+
+            memcpy(&rd, payload, sizeof(rd));
+            if (rd.length <= SM_DAEMON_MAX_PAYLOAD && (out = respond(client, rd.length))) {
+                status = sm_read_memory(rd.address, out, rd.length) ? SM_DAEMON_OK : SM_DAEMON_FAILED;
+                length = rd.length;
+            }
+        }
+        break;
+    case SM_DAEMON_WRITE:
+        if (request->length >= sizeof(uint64_t)) {
+            uint64_t address;
+
+            memcpy(&address, payload, sizeof(address));
+            status = sm_write_memory(address, payload + sizeof(address),
+                                     request->length - sizeof(address)) ? SM_DAEMON_OK : SM_DAEMON_FAILED;
+        }
+        break;
+    case SM_DAEMON_READMANY:
+        if (request->length % sizeof(sm_daemon_read_t) == 0)
+            status = handle_readmany(client, payload, request->length / sizeof(sm_daemon_read_t),
+                                     &length);
+        break;
+    default:
+        break;
+    }
+
+    /* even a failure is answered, the space for it is there unless out of memory */
+    if (respond(client, 0) == NULL)
+        return false;
+    respond_end(client, request->tag, status, length);
+    return true;
+}
+
+/* handle every complete request received */
+static bool client_process(client_t *client)
+{
+    size_t done = 0;
+    bool ok = true;
+
+    while (ok && client->in_length - done >= sizeof(sm_daemon_header_t)) {
+        sm_daemon_header_t header;
+
+        memcpy(&header, client->in + done, sizeof(header));
+        if (header.length > SM_DAEMON_MAX_PAYLOAD) {
+            show_warn("dropping a client sending a request of %u bytes.\n", header.length);
+            return false;
+        }
+        if (client->in_length - done < sizeof(header) + header.length)
+            break;
+        ok = handle(client, &header, client->in + done + sizeof(header));
+        done += sizeof(header) + header.length;
+
+        /* the session ends with the `exit` command */
+        if (sm_globals.exit)
+            break;
+    }
+    memmove(client->in, client->in + done, client->in_length - done);
+    client->in_length -= done;
+    return ok;
+}
+
+static bool client_read(client_t *client)
+{
+    ssize_t n;
+
+    if (!reserve(&client->in, &client->in_capacity, client->in_length + READ_SIZE))
+        return false;
+    while ((n = read(client->fd, client->in + client->in_length, READ_SIZE)) == -1 && errno == EINTR)
+        ;
+    if (n == -1)
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    if (n == 0) {
+        client->eof = true;
+        return true;
+    }
+    client->in_length += n;
+    return client_process(client);
+}
+
+static bool client_write(client_t *client)
+{
+    while (client->out_sent < client->out_length) {
+        ssize_t n = send(client->fd, client->out + client->out_sent,
+                         client->out_length - client->out_sent, MSG_NOSIGNAL);
+
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client->out_sent += n;
+    }
+    client->out_length = client->out_sent = 0;
+    return true;
+}
+
+static void client_close(client_t *client)
+{
+    close(client->fd);
+    free(client->in);
+    free(client->out);
+}
+
+bool sm_daemon_run(const char *path)
+{
+    client_t clients[SM_DAEMON_MAX_CLIENTS];
+    struct pollfd fds[SM_DAEMON_MAX_CLIENTS + 1];
+    size_t num_clients = 0, i;
+    struct sockaddr_un addr;
+    struct stat st;
+    mode_t mask;
+    int listener;
+    bool ret = true;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        show_error("the socket path `%s` is too long.\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    if ((listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+        show_error("failed to create a socket: %s.\n", strerror(errno));
+        return false;
+    }
+    /* a socket left behind by a daemon which is gone refuses connections */
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int err = 0;
+
+        if (probe == -1 || connect(probe, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+            err = errno;
+        if (probe != -1)
+            close(probe);
+        if (err != ECONNREFUSED) {
+            if (err == 0 || err == EAGAIN)
+                show_error("a daemon is already serving on `%s`.\n", path);
+            else
+                show_error("failed to check `%s`: %s.\n", path, strerror(err));
+            close(listener);
+            return false;
+        }
+        unlink(path);
+    }
+    mask = umask(0077);
+    if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(listener, 16) == -1) {
+        show_error("failed to listen on `%s`: %s.\n", path, strerror(errno));
+        umask(mask);
+        close(listener);
+        return false;
+    }
+    umask(mask);
+    show_info("serving the session on %s.\n", path);
+
+    while (!sm_globals.exit) {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (i = 0; i < num_clients; i++) {
+            size_t pending = clients[i].out_length - clients[i].out_sent;
+
+            fds[i + 1].fd = clients[i].fd;
+            /* a client not taking its responses sends nothing more for now */
+            fds[i + 1].events = (!clients[i].eof && pending < SM_DAEMON_MAX_PAYLOAD ? POLLIN : 0) |
+                                (pending ? POLLOUT : 0);
+            fds[i + 1].revents = 0;
+        }
+        if (poll(fds, num_clients + 1, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            show_error("failed to wait for the clients: %s.\n", strerror(errno));
+            ret = false;
+            break;
+        }
+
+        /* from the last, so that the one taking the place of a closed one is done */
+        for (i = num_clients; i-- > 0 && !sm_globals.exit; ) {
+            client_t *client = &clients[i];
+            short revents = fds[i + 1].revents;
+            bool ok = !(revents & (POLLERR | POLLNVAL));
+
+            if (ok && (revents & (POLLIN | POLLHUP)) && !client->eof)
+                ok = client_read(client);
+            if (ok)
+                ok = client_write(client);
+            if (!ok || (client->eof && client->out_length == 0)) {
+                client_close(client);
+                clients[i] = clients[--num_clients];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+
+            while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+                if (num_clients == SM_DAEMON_MAX_CLIENTS) {
+                    show_warn("refusing a client, there are already %d.\n", SM_DAEMON_MAX_CLIENTS);
+                    close(fd);
+                    continue;
+                }
+                memset(&clients[num_clients], 0, sizeof(client_t));
+                clients[num_clients++].fd = fd;
+            }
+        }
+    }
+
+    /* the answer to `exit`, at least */
+    for (i = 0; i < num_clients; i++) {
+        client_write(&clients[i]);
+        client_close(&clients[i]);
+    }
+    close(listener);
+    unlink(path);
+    return ret;
+}
@@ -0,0 +1,108 @@
+/*
+    Serving the session to other processes over a unix socket.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The protocol. Every request and every response is a header followed by
+ * `length` bytes of payload, all in the byte order of the host. A client
+ * may send any number of requests without waiting: they are handled in
+ * the order they arrive, and each response carries the tag of its request.
+ * Requests of all the clients act on the one session, one at a time.
+ */
+typedef struct {
+    uint32_t length;            /* of the payload */
+    uint16_t op;                /* SM_DAEMON_* in a request, a status in a response */
+    uint16_t reserved;
+    uint32_t tag;               /* chosen by the client, sent back as is */
+    uint32_t reserved2;
+} sm_daemon_header_t;
+
+/* the largest payload either way */
+#define SM_DAEMON_MAX_PAYLOAD (16 << 20)
+#define SM_DAEMON_MAX_CLIENTS 64
+
+/* requests, with their payload and that of their response */
+enum {
+    SM_DAEMON_VERSION = 1,      /* -> uint32_t SM_API_VERSION */
+    SM_DAEMON_COMMAND,          /* command line, its output stays with the daemon -> nothing */
+    SM_DAEMON_SCAN,             /* sm_daemon_scan_t -> uint64_t number of matches */
+    SM_DAEMON_STATUS,           /* -> sm_daemon_status_t */
+    SM_DAEMON_LIST,             /* sm_daemon_range_t -> sm_match_record_t[] */
+    SM_DAEMON_REGIONS,          /* sm_daemon_range_t -> sm_daemon_region_t[], each with its name */
+    SM_DAEMON_READ,             /* sm_daemon_read_t -> the bytes */
+    SM_DAEMON_WRITE,            /* uint64_t address, then the bytes -> nothing */
+    SM_DAEMON_READMANY          /* sm_daemon_read_t[] -> a byte per read, 1 if it could be
+                                   done, then the bytes of all of them, see sm_readmany() */
+};
+
+/* response statuses */
+enum {
+    SM_DAEMON_OK = 0,
+    SM_DAEMON_FAILED,           /* the request was understood, but did not succeed */
+    SM_DAEMON_BAD_REQUEST       /* an unknown op, or a payload of the wrong size */
+};
+
+typedef struct {
+    uint32_t match_type;        /* a scan_match_type_t */
+    uint32_t is_float;          /* whether the values are doubles, or else int64_t */
+    uint64_t values[2];         /* the second one ends a MATCHRANGE */
+} sm_daemon_scan_t;
+
+typedef struct {
+    uint64_t first;
+    uint32_t count;
+    uint32_t reserved;
+} sm_daemon_range_t;
+
+typedef struct {
+    uint64_t address;
+    uint32_t length;
+    uint32_t reserved;
+} sm_daemon_read_t;
+
+typedef struct {
+    uint64_t num_matches;
+    uint64_t num_regions;
+    double scan_progress;
+    int32_t target;             /* 0 without one */
+    uint32_t reserved;
+} sm_daemon_status_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t size;
+    uint64_t load_addr;
+    uint32_t id;
+    uint8_t type;               /* a region_type_t */
+    uint8_t flags;              /* SM_REGION_* */
+    uint16_t name_length;       /* of the file name following, without a NUL */
+} sm_daemon_region_t;
+
+/* Serve the session on a unix socket at `path` until the `exit` command.
+ * The socket is only accessible to the user running the daemon. Fails if
+ * a daemon already serves on `path`, a socket left there by one which is
+ * gone is replaced. */
+bool sm_daemon_run(const char *path);
+
+#endif /* DAEMON_H */
@@ -0,0 +1,308 @@
+/*
+    Keeping memory locations at fixed values.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "common.h"
+#include "freeze.h"
+#include "show_message.h"
+
+#ifndef IOV_MAX
+# define IOV_MAX 1024
+#endif
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+sm_freezer_t *sm_freezer_create(pid_t pid)
+{
+    sm_freezer_t *freezer;
+    pthread_condattr_t attr;
+
+    if ((freezer = calloc(1, sizeof(sm_freezer_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return NULL;
+    }
+    freezer->pid = pid;
+    freezer->memfd = -1;
+#if HAVE_PROCMEM
+    {
+        char mem[32];
+
+        /* unlike process_vm_writev(), this writes to read-only pages too */
+        snprintf(mem, sizeof(mem), "/proc/%d/mem", pid);
+        freezer->memfd = open(mem, O_RDWR);
+    }
+#endif
+
+    pthread_mutex_init(&freezer->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&freezer->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    return freezer;
+}
+
+void sm_freezer_destroy(sm_freezer_t *freezer)
+{
+    if (freezer == NULL)
+        return;
+
+    if (freezer->running) {
+        pthread_mutex_lock(&freezer->lock);
+        freezer->stop = true;
+        pthread_cond_signal(&freezer->changed);
+        pthread_mutex_unlock(&freezer->lock);
+        pthread_join(freezer->thread, NULL);
+    }
+    if (freezer->memfd != -1)
+        close(freezer->memfd);
+    pthread_cond_destroy(&freezer->changed);
+    pthread_mutex_destroy(&freezer->lock);
+    free(freezer->entries);
+    free(freezer);
+}
+
+static bool write_one(sm_freezer_t *freezer, const struct iovec *local, const struct iovec *remote)
+{
+    if (freezer->memfd == -1)
+        return false;
+    return pwrite(freezer->memfd, local->iov_base, local->iov_len,
+                  (off_t) (uintptr_t) remote->iov_base) == (ssize_t) local->iov_len;
+}
+
+/* Write the due entries, in as few system calls as possible. A batch stops at
+ * the first entry which cannot be written, it gets another chance through
+ * /proc/pid/mem and the rest of the batch is written again. */
+static void write_values(sm_freezer_t *freezer, sm_freeze_entry_t **due, struct iovec *local,
+                         struct iovec *remote, size_t count)
+{
+    size_t done = 0;
+    bool use_memfd = false;
+
+    while (done < count) {
+        size_t n = MIN(count - done, IOV_MAX);
+        ssize_t nwritten;
+
+        if (use_memfd) {
+            if (write_one(freezer, &local[done], &remote[done]))
+                due[done]->writes++;
+            else
+                due[done]->errors++;
+            done++;
+            continue;
+        }
+
+        nwritten = process_vm_writev(freezer->pid, &local[done], n, &remote[done], n, 0);
+        if (nwritten == -1) {
+            if (errno == ESRCH) {
+                __atomic_store_n(&freezer->failed, true, __ATOMIC_RELEASE);
+                return;
+            }
+            if (errno == ENOSYS || errno == EPERM)
+                use_memfd = true;
+            else if (write_one(freezer, &local[done], &remote[done]))
+                due[done++]->writes++;
+            else
+                due[done++]->errors++;
+            continue;
+        }
+
+        for ( ; n > 0 && (size_t) nwritten >= local[done].iov_len; n--, done++) {
+            nwritten -= local[done].iov_len;
+            due[done]->writes++;
+        }
+        if (n > 0) {
+            if (write_one(freezer, &local[done], &remote[done]))
+                due[done++]->writes++;
+            else
+                due[done++]->errors++;
+        }
+    }
+}
+
+static void *freezer_thread(void *arg)
+{
+    sm_freezer_t *freezer = arg;
+    sm_freeze_entry_t **due = NULL;
+    struct iovec *local = NULL, *remote = NULL;
+    size_t capacity = 0;
+
+    pthread_mutex_lock(&freezer->lock);
+    while (!freezer->stop) {
+        uint64_t now = now_ns(), next = UINT64_MAX;
+        size_t count = 0, i;
+
+        if (capacity < freezer->count) {
+            capacity = freezer->capacity;
+            free(due);
+            free(local);
+            free(remote);
+            due = calloc(capacity, sizeof(sm_freeze_entry_t *));
+            local = calloc(capacity, sizeof(struct iovec));
+            remote = calloc(capacity, sizeof(struct iovec));
+            if (!due || !local || !remote) {
+                show_error("sorry, there was a memory allocation error.\n");
+                __atomic_store_n(&freezer->failed, true, __ATOMIC_RELEASE);
+                break;
+            }
+        }
+
+        for (i = 0; i < freezer->count; i++) {
+            sm_freeze_entry_t *entry = &freezer->entries[i];
+
+            if (entry->next_ns <= now) {
+                due[count] = entry;
+                local[count].iov_base = entry->data;
+                local[count].iov_len = entry->width;
+                remote[count].iov_base = (void *) entry->address;
+                remote[count].iov_len = entry->width;
+                count++;
+
+                /* keep the pace, unless ticks were missed */
+                entry->next_ns += entry->interval_ns;
+                if (entry->next_ns <= now)
+                    entry->next_ns = now + entry->interval_ns;
+            }
+            next = MIN(next, entry->next_ns);
+        }
+
+        if (count > 0)
+            write_values(freezer, due, local, remote, count);
+        if (sm_freezer_failed(freezer))
+            break;
+
+        if (next == UINT64_MAX) {
+            pthread_cond_wait(&freezer->changed, &freezer->lock);
+        } else {
+            struct timespec wakeup = { next / 1000000000ULL, next % 1000000000ULL };
+
+            pthread_cond_timedwait(&freezer->changed, &freezer->lock, &wakeup);
+        }
+    }
+    pthread_mutex_unlock(&freezer->lock);
+
+    free(due);
+    free(local);
+    free(remote);
+    return NULL;
+}
+
+long sm_freezer_add(sm_freezer_t *freezer, uintptr_t address, const void *data, size_t width,
+                    match_flags flags, uint64_t interval_ns)
+{
+    sm_freeze_entry_t *entry;
+    long id = -1;
+
+    if (width == 0 || width > sizeof(uint64_t) || interval_ns == 0)
+        return -1;
+    if (sm_freezer_failed(freezer)) {
+        show_error("the target is gone.\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&freezer->lock);
+    if (freezer->count == freezer->capacity) {
+        size_t capacity = freezer->capacity ? freezer->capacity * 2 : 16;
+        sm_freeze_entry_t *entries;
+
+        if ((entries = realloc(freezer->entries, capacity * sizeof(sm_freeze_entry_t))) == NULL) {
+            show_error("sorry, there was a memory allocation error.\n");
+            goto out;
+        }
+        freezer->entries = entries;
+        freezer->capacity = capacity;
+    }
+
+    entry = &freezer->entries[freezer->count];
+    memset(entry, 0, sizeof(sm_freeze_entry_t));
+    entry->id = freezer->next_id;
+    entry->address = address;
+    entry->width = width;
+    memcpy(entry->data, data, width);
+    entry->flags = flags;
+    entry->interval_ns = interval_ns;
+    entry->next_ns = now_ns();
+
+    if (!freezer->running) {
+        if (pthread_create(&freezer->thread, NULL, freezer_thread, freezer) != 0) {
+            show_error("failed to start the freezer thread.\n");
+            goto out;
+        }
+        freezer->running = true;
+    }
+    freezer->count++;
+    id = (long) freezer->next_id++;
+    pthread_cond_signal(&freezer->changed);
+
+out:
+    pthread_mutex_unlock(&freezer->lock);
+    return id;
+}
+
+bool sm_freezer_remove(sm_freezer_t *freezer, unsigned long id)
+{
+    bool found = false;
+    size_t i;
+
+    pthread_mutex_lock(&freezer->lock);
+    for (i = 0; i < freezer->count; i++) {
+        if (freezer->entries[i].id == id) {
+            memmove(&freezer->entries[i], &freezer->entries[i + 1],
+                    (freezer->count - i - 1) * sizeof(sm_freeze_entry_t));
+            freezer->count--;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&freezer->lock);
+    return found;
+}
+
+size_t sm_freezer_list(sm_freezer_t *freezer, sm_freeze_entry_t **out)
+{
+    size_t count;
+
+    pthread_mutex_lock(&freezer->lock);
+    count = freezer->count;
+    *out = NULL;
+    if (count > 0 && (*out = malloc(count * sizeof(sm_freeze_entry_t))) != NULL)
+        memcpy(*out, freezer->entries, count * sizeof(sm_freeze_entry_t));
+    else
+        count = 0;
+    pthread_mutex_unlock(&freezer->lock);
+    return count;
+}
@@ -0,0 +1,79 @@
+/*
+    Keeping memory locations at fixed values.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FREEZE_H
+#define FREEZE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "value.h"
+
+typedef struct {
+    unsigned long id;
+    uintptr_t address;
+    size_t width;               /* bytes written, up to 8 */
+    uint8_t data[sizeof(uint64_t)];
+    match_flags flags;          /* how to show the value */
+    uint64_t interval_ns;
+    uint64_t next_ns;           /* when it is written next */
+    unsigned long writes;
+    unsigned long errors;       /* failed writes */
+} sm_freeze_entry_t;
+
+/* The entries are rewritten by a thread of their own, all those due in the
+ * same tick with a single system call. The table is shared with the thread
+ * and only ever touched with `lock` held. */
+typedef struct sm_freezer {
+    pid_t pid;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;     /* signalled when entries come and go */
+    sm_freeze_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    unsigned long next_id;
+    bool running;
+    bool stop;                  /* tells the thread to stop */
+    bool failed;                /* set by the thread if the target is gone */
+    int memfd;                  /* /proc/pid/mem, for what cannot be written otherwise */
+} sm_freezer_t;
+
+sm_freezer_t *sm_freezer_create(pid_t pid);
+/* stops the thread, the target keeps the values last written */
+void sm_freezer_destroy(sm_freezer_t *freezer);
+
+/* Keep the `width` bytes at `data` written to `address` every `interval_ns`,
+ * the first write happens right away. Returns the id of the entry, or -1. */
+long sm_freezer_add(sm_freezer_t *freezer, uintptr_t address, const void *data, size_t width,
+                    match_flags flags, uint64_t interval_ns);
+bool sm_freezer_remove(sm_freezer_t *freezer, unsigned long id);
+
+/* copy the entries to `out`, which has to be freed, and return how many */
+size_t sm_freezer_list(sm_freezer_t *freezer, sm_freeze_entry_t **out);
+
+static inline bool sm_freezer_failed(sm_freezer_t *freezer)
+{
+    return __atomic_load_n(&freezer->failed, __ATOMIC_ACQUIRE);
+}
+
+#endif /* FREEZE_H */
@@ -0,0 +1,504 @@
+/*
+    Scanning a group of processes at once.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "core.h"
+#include "group.h"
+#include "interrupt.h"
+#include "show_message.h"
+#include "targetmem.h"
+
+sm_group_t *sm_group_create(void)
+{
+    sm_group_t *group;
+
+    if ((group = calloc(1, sizeof(sm_group_t))) == NULL)
+        show_error("sorry, there was a memory allocation error.\n");
+    return group;
+}
+
+/* forget everything known about a member, the pid and image are kept */
+static void member_unload(sm_member_t *member)
+{
+    globals_t *vars = &member->vars;
+
+    free(vars->matches);
+    vars->matches = NULL;
+    vars->num_matches = 0;
+    rt_destroy(vars->regions);
+    vars->regions = NULL;
+    sm_reader_close(&vars->reader);
+}
+
+static bool member_load(sm_member_t *member, const globals_t *vars)
+{
+    globals_t *mvars = &member->vars;
+
+    mvars->options = vars->options;
+
+    if ((mvars->regions = rt_init()) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return false;
+    }
+    if (mvars->image) {
+        if (!sm_image_regions(mvars->image, mvars->regions))
+            return false;
+        sm_reader_open_image(&mvars->reader, mvars->image);
+        return true;
+    }
+    if (!sm_readmaps(mvars->target, mvars->regions, vars->options.region_scan_level)) {
+        show_error("failed to read the regions of %d.\n", mvars->target);
+        return false;
+    }
+    return sm_reader_open(&mvars->reader, mvars->target);
+}
+
+void sm_group_destroy(sm_group_t *group)
+{
+    size_t i;
+
+    if (group == NULL)
+        return;
+
+    for (i = 0; i < group->count; i++) {
+        member_unload(&group->members[i]);
+        sm_image_close(group->members[i].vars.image);
+    }
+    free(group->members);
+    free(group);
+}
+
+/* a new member past the last one, counted once it is loaded */
+static sm_member_t *new_member(sm_group_t *group)
+{
+    sm_member_t *members, *member;
+
+    if ((members = realloc(group->members, (group->count + 1) * sizeof(sm_member_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return NULL;
+    }
+    group->members = members;
+
+    member = &members[group->count];
+    memset(member, 0, sizeof(sm_member_t));
+    member->vars.reader.procmem_fd = -1;
+    return member;
+}
+
+bool sm_group_add(sm_group_t *group, const globals_t *vars, pid_t pid)
+{
+    sm_member_t *member;
+    size_t i;
+
+    for (i = 0; i < group->count; i++) {
+        if (group->members[i].vars.target == pid && group->members[i].vars.image == NULL) {
+            show_warn("%d is already in the group.\n", pid);
+            return true;
+        }
+    }
+
+    if ((member = new_member(group)) == NULL)
+        return false;
+    member->vars.target = pid;
+
+    if (!member_load(member, vars)) {
+        member_unload(member);
+        return false;
+    }
+
+    group->count++;
+    return true;
+}
+
+bool sm_group_add_image(sm_group_t *group, const globals_t *vars, const char *path)
+{
+    sm_member_t *member;
+    sm_image_t *image;
+
+    if ((image = sm_image_open(path)) == NULL)
+        return false;
+    if ((member = new_member(group)) == NULL) {
+        sm_image_close(image);
+        return false;
+    }
+    member->vars.target = image->header.pid;
+    member->vars.image = image;
+
+    if (!member_load(member, vars)) {
+        member_unload(member);
+        sm_image_close(image);
+        return false;
+    }
+
+    group->count++;
+    return true;
+}
+
+/* check if the executable of `pid` is called `name` */
+static bool process_has_name(pid_t pid, const char *name)
+{
+    char path[32];
+    char exe[PATH_MAX];
+    const char *base;
+    ssize_t len;
+    FILE *comm;
+    bool ret = false;
+
+    snprintf(path, sizeof(path), "/proc/%d/exe", pid);
+    if ((len = readlink(path, exe, sizeof(exe) - 1)) > 0) {
+        exe[len] = '\0';
+        base = strrchr(exe, '/');
+        return strcmp(base ? base + 1 : exe, name) == 0;
+    }
+
+    /* the link needs more permissions than the command name */
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    if ((comm = fopen(path, "r")) == NULL)
+        return false;
+    if (fgets(exe, sizeof(exe), comm)) {
+        exe[strcspn(exe, "\n")] = '\0';
+        ret = (strcmp(exe, name) == 0);
+    }
+    fclose(comm);
+    return ret;
+}
+
+size_t sm_group_add_by_name(sm_group_t *group, const globals_t *vars, const char *name)
+{
+    DIR *proc;
+    struct dirent *entry;
+    pid_t self = getpid();
+    size_t added = 0;
+
+    if ((proc = opendir("/proc")) == NULL) {
+        show_error("failed to open /proc.\n");
+        return 0;
+    }
+
+    while ((entry = readdir(proc)) != NULL) {
+        char *end;
+        pid_t pid = (pid_t) strtol(entry->d_name, &end, 10);
+
+        if (*end != '\0' || pid <= 0 || pid == self)
+            continue;
+        if (process_has_name(pid, name) && sm_group_add(group, vars, pid))
+            added++;
+    }
+
+    closedir(proc);
+    return added;
+}
+
+bool sm_group_remove(sm_group_t *group, pid_t pid)
+{
+    size_t i;
+
+    for (i = 0; i < group->count; i++) {
+        if (group->members[i].vars.target == pid) {
+            member_unload(&group->members[i]);
+            sm_image_close(group->members[i].vars.image);
+            memmove(&group->members[i], &group->members[i + 1],
+                    (group->count - i - 1) * sizeof(sm_member_t));
+            group->count--;
+            return true;
+        }
+    }
+
+    show_error("%d is not in the group.\n", pid);
+    return false;
+}
+
+bool sm_group_reset(sm_group_t *group, const globals_t *vars)
+{
+    bool ret = true;
+    size_t i;
+
+    for (i = 0; i < group->count; i++) {
+        member_unload(&group->members[i]);
+        if (!member_load(&group->members[i], vars)) {
+            show_warn("%d may have exited, use `group remove`.\n",
+                      group->members[i].vars.target);
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+typedef struct {
+    sm_member_t *member;
+    scan_match_type_t match_type;
+    const uservalue_t *uservalue;
+} scan_job_t;
+
+static void *scan_member(void *arg)
+{
+    scan_job_t *job = arg;
+    globals_t *vars = &job->member->vars;
+
+    sm_set_scan_worker(true);
+
+    if (vars->matches && job->match_type != MATCHANY) {
+        /* nothing left to check */
+        if (vars->num_matches == 0) {
+            job->member->ok = true;
+            return NULL;
+        }
+        job->member->ok = sm_checkmatches(vars, &vars->reader, job->match_type, job->uservalue);
+    } else {
+        free(vars->matches);
+        vars->matches = NULL;
+        vars->num_matches = 0;
+        job->member->ok = sm_searchregions(vars, &vars->reader, job->match_type, job->uservalue);
+    }
+
+    if (!job->member->ok)
+        show_error("failed to scan %d.\n", vars->target);
+    return NULL;
+}
+
+bool sm_group_scan(sm_group_t *group, const globals_t *vars, scan_match_type_t match_type,
+                   const uservalue_t *uservalue)
+{
+    pthread_t *threads;
+    scan_job_t *jobs;
+    bool *started;
+    bool ret = true;
+    size_t i;
+
+    if (group == NULL || group->count == 0) {
+        show_error("the group is empty, see `help group`.\n");
+        return false;
+    }
+
+    threads = calloc(group->count, sizeof(pthread_t));
+    jobs = calloc(group->count, sizeof(scan_job_t));
+    started = calloc(group->count, sizeof(bool));
+    if (threads == NULL || jobs == NULL || started == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        ret = false;
+        goto out;
+    }
+
+    for (i = 0; i < group->count; i++) {
+        sm_member_t *member = &group->members[i];
+
+        member->vars.options = vars->options;
+        member->vars.stop_flag = false;
+        member->ok = false;
+        jobs[i].member = member;
+        jobs[i].match_type = match_type;
+        jobs[i].uservalue = uservalue;
+    }
+
+    /* the workers only look at their stop flag, see sm_set_stop_flag() */
+    INTERRUPTABLESCAN();
+
+    for (i = 0; i < group->count; i++) {
+        started[i] = (pthread_create(&threads[i], NULL, scan_member, &jobs[i]) == 0);
+        if (!started[i])
+            show_error("failed to start a scan thread for %d.\n",
+                       group->members[i].vars.target);
+    }
+    for (i = 0; i < group->count; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
+
+    ENDINTERRUPTABLE();
+
+    for (i = 0; i < group->count; i++) {
+        const globals_t *mvars = &group->members[i].vars;
+
+        show_info("%d: %lu matches.\n", mvars->target, mvars->num_matches);
+        ret = ret && group->members[i].ok;
+    }
+
+out:
+    free(started);
+    free(jobs);
+    free(threads);
+    return ret;
+}
+
+/* Walks the matches of a member in order of position. Matches and regions
+ * are both sorted by address and region ids follow the same order, so the
+ * positions come sorted as well. */
+typedef struct {
+    globals_t *vars;
+    size_t region;              /* index of the region of the current match */
+    swath_t *swath;
+    size_t index;
+    sm_match_pos_t pos;
+    old_value_and_match_info *match;    /* NULL when done */
+} match_cursor_t;
+
+/* Move to the next match, starting with the one at `index`.
+ * Matches outside of the known regions cannot be compared and are dropped. */
+static void cursor_seek(match_cursor_t *cursor)
+{
+    const region_table_t *regions = cursor->vars->regions;
+    swath_t *swath = cursor->swath;
+
+    while (swath->first_byte_in_child) {
+        for ( ; cursor->index < swath->number_of_bytes; cursor->index++) {
+            uintptr_t address = swath__remote_address_of_nth_element(swath, cursor->index);
+            old_value_and_match_info *match = &swath->data[cursor->index];
+            region_t *region;
+
+            if (match->flags == flags_empty)
+                continue;
+
+            while (cursor->region < regions->size &&
+                   regions->regions[cursor->region]->start +
+                   regions->regions[cursor->region]->size <= address)
+                cursor->region++;
+            if (cursor->region == regions->size ||
+                address < regions->regions[cursor->region]->start) {
+                match->flags = flags_empty;
+                cursor->vars->num_matches--;
+                continue;
+            }
+
+            region = regions->regions[cursor->region];
+            cursor->swath = swath;
+            cursor->pos.region = region;
+            cursor->pos.offset = address - region->load_addr;
+            cursor->match = match;
+            return;
+        }
+        swath = swath__local_address_beyond_last_element(swath);
+        cursor->index = 0;
+    }
+
+    cursor->swath = swath;
+    cursor->match = NULL;
+}
+
+static inline void cursor_next(match_cursor_t *cursor)
+{
+    cursor->index++;
+    cursor_seek(cursor);
+}
+
+static inline int compare_pos(const sm_match_pos_t *x, const sm_match_pos_t *y)
+{
+    if (x->region->id != y->region->id)
+        return (x->region->id < y->region->id) ? -1 : 1;
+    if (x->offset != y->offset)
+        return (x->offset < y->offset) ? -1 : 1;
+    return 0;
+}
+
+size_t sm_group_intersect(sm_group_t *group, sm_match_pos_t *common, size_t max)
+{
+    match_cursor_t *cursors;
+    size_t ncommon = 0;
+    size_t i;
+
+    if (group == NULL || group->count == 0) {
+        show_error("the group is empty, see `help group`.\n");
+        return (size_t) -1;
+    }
+
+    for (i = 0; i < group->count; i++) {
+        if (group->members[i].vars.matches == NULL) {
+            show_error("%d has not been scanned yet.\n", group->members[i].vars.target);
+            return (size_t) -1;
+        }
+    }
+
+    if ((cursors = calloc(group->count, sizeof(match_cursor_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return (size_t) -1;
+    }
+
+    for (i = 0; i < group->count; i++) {
+        cursors[i].vars = &group->members[i].vars;
+        cursors[i].swath = cursors[i].vars->matches->swaths;
+        cursor_seek(&cursors[i]);
+    }
+
+    /* Merge the members: while every cursor is at the same position, the
+     * position is common, otherwise the matches at the lowest one are not. */
+    for ( ; ; ) {
+        const sm_match_pos_t *lowest = NULL;
+        bool same = true;
+        bool done = false;
+
+        for (i = 0; i < group->count; i++) {
+            if (cursors[i].match == NULL) {
+                done = true;
+                continue;
+            }
+            if (lowest == NULL) {
+                lowest = &cursors[i].pos;
+            } else if (compare_pos(&cursors[i].pos, lowest) != 0) {
+                same = false;
+                if (compare_pos(&cursors[i].pos, lowest) < 0)
+                    lowest = &cursors[i].pos;
+            }
+        }
+        if (lowest == NULL)
+            break;
+
+        if (same && !done) {
+            if (ncommon < max)
+                common[ncommon] = *lowest;
+            ncommon++;
+            for (i = 0; i < group->count; i++)
+                cursor_next(&cursors[i]);
+            continue;
+        }
+
+        /* drop everything at the lowest position, or everything left once
+         * any member is out of matches */
+        sm_match_pos_t drop = *lowest;
+        for (i = 0; i < group->count; i++) {
+            if (cursors[i].match && (done || compare_pos(&cursors[i].pos, &drop) == 0)) {
+                cursors[i].match->flags = flags_empty;
+                cursors[i].vars->num_matches--;
+                cursor_next(&cursors[i]);
+            }
+        }
+    }
+
+    free(cursors);
+    return ncommon;
+}
+
+void sm_group_set_stop_flag(sm_group_t *group, bool stop_flag)
+{
+    size_t i;
+
+    if (group == NULL)
+        return;
+    for (i = 0; i < group->count; i++)
+        group->members[i].vars.stop_flag = stop_flag;
+}
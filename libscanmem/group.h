@@ -0,0 +1,83 @@
+/*
+    Scanning a group of processes at once.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "maps.h"
+#include "scanmem.h"
+#include "scanroutines.h"
+#include "value.h"
+
+/* A process of a group. Every member is a session of its own, with its
+ * target, regions, matches and reader kept in `vars`; only the options are
+ * taken over from the main session before each scan. A member may be an
+ * image instead, its `target` is then the pid it was saved from and never
+ * attached to. */
+typedef struct {
+    globals_t vars;
+    bool ok;                    /* result of the last scan */
+} sm_member_t;
+
+typedef struct sm_group {
+    size_t count;
+    sm_member_t *members;
+} sm_group_t;
+
+/* Position of a match which can be compared across processes running the
+ * same program: the region id and the offset from its load address, like
+ * printed by `list`. */
+typedef struct {
+    const region_t *region;
+    unsigned long offset;
+} sm_match_pos_t;
+
+sm_group_t *sm_group_create(void);
+void sm_group_destroy(sm_group_t *group);
+
+/* add a process, reading its regions with the options of `vars` */
+bool sm_group_add(sm_group_t *group, const globals_t *vars, pid_t pid);
+/* add the image saved at `path`, see core.h */
+bool sm_group_add_image(sm_group_t *group, const globals_t *vars, const char *path);
+/* add every process whose executable is called `name`, returns how many were added */
+size_t sm_group_add_by_name(sm_group_t *group, const globals_t *vars, const char *name);
+bool sm_group_remove(sm_group_t *group, pid_t pid);
+/* drop all matches and read the regions of every member again */
+bool sm_group_reset(sm_group_t *group, const globals_t *vars);
+
+/* Scan every member in a thread of its own. Members without matches are
+ * searched, the others are checked; MATCHANY takes a snapshot.
+ * Returns false if the scan failed for any member. */
+bool sm_group_scan(sm_group_t *group, const globals_t *vars, scan_match_type_t match_type,
+                   const uservalue_t *uservalue);
+
+/* Keep only the matches whose position is matched in every member.
+ * Up to `max` of the common positions are stored in `common`, sorted and
+ * pointing into the regions of the first member. Returns the number of
+ * common positions, or (size_t)-1 on error. */
+size_t sm_group_intersect(sm_group_t *group, sm_match_pos_t *common, size_t max);
+
+/* async-signal safe, used to interrupt a running group scan */
+void sm_group_set_stop_flag(sm_group_t *group, bool stop_flag);
+
+#endif /* GROUP_H */
@@ -44,16 +44,24 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <ctype.h>
+#include <fcntl.h>
 
 #include "common.h"
 #include "commands.h"
+#include "core.h"
 #include "endianness.h"
+#include "freeze.h"
+#include "group.h"
+#include "layout.h"
 #include "handlers.h"
 #include "interrupt.h"
+#include "pointer.h"
+#include "recorder.h"
 #include "scanmem.h"
 #include "scanroutines.h"
 #include "sets.h"
 #include "show_message.h"
+#include "watch.h"
 
 #define USEPARAMS() ((void) vars, (void) argv, (void) argc)     /* macro to hide gcc unused warnings */
 
@@ -86,6 +94,12 @@
 #define POINTER_FMT "%12lx"
 #endif
 
+/* a process, or an image scanned instead, see handler__loadcore() */
+static inline bool has_target(const globals_t *vars)
+{
+    return vars->target != 0 || vars->image != NULL;
+}
+
 bool handler__set(globals_t * vars, char **argv, unsigned argc)
 {
     unsigned block, seconds = 1;
@@ -121,6 +135,12 @@ bool handler__set(globals_t * vars, char **argv, unsigned argc)
         return false;
     }
 
+    /* matches of an image have nowhere to be written to */
+    if (vars->target == 0) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+
     /* --- parse arguments into settings structs --- */
 
     settings = calloca(argc - 1, sizeof(struct setting));
@@ -316,7 +336,6 @@ bool handler__list(globals_t *vars, char **argv, unsigned argc)
 {
     unsigned long num = 0;
     size_t buf_len = 128; /* will be realloc'd later if necessary */
-    element_t *np = NULL;
     char *v = NULL;
     const char *bytearray_suffix = ", [bytearray]";
     const char *string_suffix = ", [string]";
@@ -342,9 +361,6 @@ bool handler__list(globals_t *vars, char **argv, unsigned argc)
         return false;
     }
 
-    if (vars->regions)
-        np = vars->regions->head;
-
     swath_t *reading_swath_index = vars->matches->swaths;
     size_t reading_iterator = 0;
 
@@ -401,6 +417,7 @@ bool handler__list(globals_t *vars, char **argv, unsigned argc)
                 ; /* cheat gcc */
                 value_t val = data_to_val(reading_swath_index, reading_iterator);
 
+                fix_endianness(&val, vars->options.reverse_endianness);
                 valtostr(&val, v, buf_len);
                 break;
             }
@@ -410,20 +427,12 @@ bool handler__list(globals_t *vars, char **argv, unsigned argc)
             unsigned int region_id = 99;
             unsigned long match_off = 0;
             const char *region_type = "??";
-            /* get region info belonging to the match -
-             * note: we assume the regions list and matches are sorted
-             */
-            while (np) {
-                region_t *region = np->data;
-                unsigned long region_start = (unsigned long)region->start;
-                if (address_ul < region_start + region->size &&
-                  address_ul >= region_start) {
-                    region_id = region->id;
-                    match_off = address_ul - region->load_addr;
-                    region_type = region_type_names[region->type];
-                    break;
-                }
-                np = np->next;
+            /* get region info belonging to the match */
+            const region_t *region = vars->regions ? rt_find(vars->regions, address_ul) : NULL;
+            if (region) {
+                region_id = region->id;
+                match_off = address_ul - region->load_addr;
+                region_type = region_type_names[region->type];
             }
             fprintf(pager, "[%2lu] "POINTER_FMT", %2u + "POINTER_FMT", %5s, %s\n",
                    num++, address_ul, region_id, match_off, region_type, v);
@@ -515,26 +524,90 @@ bool handler__reset(globals_t * vars, char **argv, unsigned argc)
 
     if (vars->matches) { free(vars->matches); vars->matches = NULL; vars->num_matches = 0; }
 
+    /* the chains found refer to the regions by id */
+    sm_ptrscan_destroy(vars->ptrscan);
+    vars->ptrscan = NULL;
+
     /* refresh list of regions */
-    l_destroy(vars->regions);
+    rt_destroy(vars->regions);
 
-    /* create a new linked list of regions */
-    if ((vars->regions = l_init()) == NULL) {
+    /* create a new table of regions */
+    if ((vars->regions = rt_init()) == NULL) {
         show_error("sorry, there was a problem allocating memory.\n");
         return false;
     }
 
-    /* read in maps if a pid is known */
-    if (vars->target && sm_readmaps(vars->target, vars->regions, vars->options.region_scan_level) != true) {
+    /* read in maps if a pid is known, an image has its own regions */
+    if (vars->image) {
+        if (!sm_image_regions(vars->image, vars->regions)) {
+            show_error("sorry, there was a problem reading the regions of the image.\n");
+            return false;
+        }
+    } else if (vars->target && sm_readmaps(vars->target, vars->regions, vars->options.region_scan_level) != true) {
         show_error("sorry, there was a problem getting a list of regions to search.\n");
         show_warn("the pid may be invalid, or you don't have permission.\n");
         vars->target = 0;
         return false;
     }
 
+    /* bind the reader to the (possibly new) target */
+    sm_reader_close(&vars->reader);
+    if (vars->image) {
+        sm_reader_open_image(&vars->reader, vars->image);
+    } else if (vars->target && sm_reader_open(&vars->reader, vars->target) != true) {
+        show_warn("the pid may be invalid, or you don't have permission.\n");
+        vars->target = 0;
+        return false;
+    }
+
     return true;
 }
 
+bool handler__refresh(globals_t * vars, char **argv, unsigned argc)
+{
+    address_range_t *removed;
+    size_t num_removed, i;
+    unsigned long num_new = 0;
+    bool ret = true;
+
+    USEPARAMS();
+
+    if (vars->target == 0) {
+        show_error("no target set, type `help pid`.\n");
+        return false;
+    }
+
+    if (!sm_refreshmaps(vars->target, vars->regions, &removed, &num_removed,
+                        vars->options.region_scan_level)) {
+        show_error("sorry, there was a problem getting a list of regions to search.\n");
+        ret = false;
+    }
+
+    /* drop the matches which are not mapped anymore */
+    for (i = 0; i < num_removed && vars->matches && vars->num_matches > 0; i++) {
+        vars->matches = matches__delete_in_address_range(vars->matches, &vars->num_matches,
+                                                         removed[i].start, removed[i].end);
+        if (vars->matches == NULL) {
+            show_error("memory allocation error while deleting matches\n");
+            vars->num_matches = 0;
+            ret = false;
+        }
+    }
+
+    for (i = 0; i < vars->regions->size; i++) {
+        if (vars->regions->regions[i]->flags.unscanned)
+            num_new++;
+    }
+
+    show_info("%lu address ranges gone, %lu new regions, %lu matches left.\n",
+              (unsigned long) num_removed, num_new, vars->num_matches);
+    if (num_new > 0 && vars->matches)
+        show_info("new regions are searched by the next scan for a value.\n");
+
+    free(removed);
+    return ret;
+}
+
 bool handler__pid(globals_t * vars, char **argv, unsigned argc)
 {
     char *resetargv[] = { "reset", NULL };
@@ -551,11 +624,23 @@ bool handler__pid(globals_t * vars, char **argv, unsigned argc)
         /* print the pid of the target program */
         show_info("target pid is %u.\n", vars->target);
         return true;
+    } else if (vars->image) {
+        show_info("scanning `%s`, saved from %d.\n", vars->image->path, vars->image->header.pid);
+        return true;
     } else {
         show_info("no target is currently set.\n");
         return false;
     }
 
+    /* what was frozen belongs to the previous target */
+    sm_freezer_destroy(vars->freezer);
+    vars->freezer = NULL;
+
+    /* a process is scanned from now on */
+    sm_reader_close(&vars->reader);
+    sm_image_close(vars->image);
+    vars->image = NULL;
+
     return handler__reset(vars, resetargv, 1);
 }
 
@@ -565,7 +650,7 @@ bool handler__snapshot(globals_t *vars, char **argv, unsigned argc)
     
 
     /* check that a pid has been specified */
-    if (vars->target == 0) {
+    if (!has_target(vars)) {
         show_error("no target set, type `help pid`.\n");
         return false;
     }
@@ -573,7 +658,7 @@ bool handler__snapshot(globals_t *vars, char **argv, unsigned argc)
     /* remove any existing matches */
     if (vars->matches) { free(vars->matches); vars->matches = NULL; vars->num_matches = 0; }
 
-    if (sm_searchregions(vars, MATCHANY, NULL) != true) {
+    if (sm_searchregions(vars, &vars->reader, MATCHANY, NULL) != true) {
         show_error("failed to save target address space.\n");
         return false;
     }
@@ -593,7 +678,7 @@ bool handler__dregion(globals_t *vars, char **argv, unsigned argc)
     }
 
     /* check that there is a process known */
-    if (vars->target == 0) {
+    if (!has_target(vars)) {
         show_error("no target specified, see `help pid`\n");
         return false;
     }
@@ -604,9 +689,7 @@ bool handler__dregion(globals_t *vars, char **argv, unsigned argc)
         return false;
     }
 
-    size_t last_region_id = ((region_t*)(vars->regions->tail->data))->id;
-
-    if (!parse_uintset(argv[1], &reg_set, last_region_id + 1)) {
+    if (!parse_uintset(argv[1], &reg_set, vars->regions->next_id)) {
         show_error("failed to parse the set, try `help dregion`.\n");
         return false;
     }
@@ -614,25 +697,10 @@ bool handler__dregion(globals_t *vars, char **argv, unsigned argc)
     /* loop for every reg_id in the set */
     for (size_t set_idx = 0; set_idx < reg_set.size; set_idx++) {
         size_t reg_id = reg_set.buf[set_idx];
-        
-        /* initialize list pointers */
-        element_t *np = vars->regions->head;
-        element_t *pp = NULL;
-        
-        /* find the correct region node */
-        while (np) {
-            region_t *r = np->data;
-            
-            /* compare the node id to the id the user specified */
-            if (r->id == reg_id)
-                break;
-            
-            pp = np; /* keep track of prev for l_remove() */
-            np = np->next;
-        }
+        region_t *reg_to_delete = rt_get(vars->regions, reg_id);
 
         /* check if a match was found */
-        if (np == NULL) {
+        if (reg_to_delete == NULL) {
             show_warn("no region matching %u, or already removed.\n", reg_id);
             continue;
         }
@@ -640,8 +708,6 @@ bool handler__dregion(globals_t *vars, char **argv, unsigned argc)
         /* check for any affected matches before removing it */
         if(vars->num_matches > 0)
         {
-            region_t *reg_to_delete = np->data;
-
             void *start_address = reg_to_delete->start;
             void *end_address = reg_to_delete->start + reg_to_delete->size;
             vars->matches = matches__delete_in_address_range(vars->matches, &vars->num_matches,
@@ -652,7 +718,7 @@ bool handler__dregion(globals_t *vars, char **argv, unsigned argc)
             }
         }
 
-        l_remove(vars->regions, pp, NULL);
+        rt_remove(vars->regions, reg_id);
     }
 
     return true;
@@ -660,11 +726,9 @@ bool handler__dregion(globals_t *vars, char **argv, unsigned argc)
 
 bool handler__lregions(globals_t * vars, char **argv, unsigned argc)
 {
-    element_t *np = vars->regions->head;
-
     USEPARAMS();
 
-    if (vars->target == 0) {
+    if (!has_target(vars)) {
         show_error("no target has been specified, see `help pid`.\n");
         return false;
     }
@@ -674,8 +738,8 @@ bool handler__lregions(globals_t * vars, char **argv, unsigned argc)
     }
     
     /* print a list of regions that have been searched */
-    while (np) {
-        region_t *region = np->data;
+    for (size_t i = 0; i < vars->regions->size; i++) {
+        region_t *region = vars->regions->regions[i];
 
         fprintf(stderr, "[%2u] "POINTER_FMT", %7lu bytes, %5s, "POINTER_FMT", %c%c%c, %s\n", 
                 region->id,
@@ -685,12 +749,36 @@ bool handler__lregions(globals_t * vars, char **argv, unsigned argc)
                 region->flags.write ? 'w' : '-',
                 region->flags.exec ? 'x' : '-',
                 region->filename[0] ? region->filename : "unassociated");
-        np = np->next;
     }
 
     return true;
 }
 
+/* map an operator command to a match type, `with_value` if a value was given */
+static bool parse_operator(const char *op, bool with_value, scan_match_type_t *m)
+{
+    if (strcmp(op, "=") == 0)
+        *m = with_value ? MATCHEQUALTO : MATCHNOTCHANGED;
+    else if (strcmp(op, "!=") == 0)
+        *m = with_value ? MATCHNOTEQUALTO : MATCHCHANGED;
+    else if (strcmp(op, "<") == 0)
+        *m = with_value ? MATCHLESSTHAN : MATCHDECREASED;
+    else if (strcmp(op, ">") == 0)
+        *m = with_value ? MATCHGREATERTHAN : MATCHINCREASED;
+    else if (strcmp(op, "+") == 0)
+        *m = with_value ? MATCHINCREASEDBY : MATCHINCREASED;
+    else if (strcmp(op, "-") == 0)
+        *m = with_value ? MATCHDECREASEDBY : MATCHDECREASED;
+    else
+        return false;
+    return true;
+}
+
+/* Cannot be used on first scan:
+ *   =, !=, <, >, +, + N, -, - N
+ * Can be used on first scan:
+ *   = N, != N, < N, > N
+ */
 /* handles every scan that starts with an operator */
 bool handler__operators(globals_t * vars, char **argv, unsigned argc)
 {
@@ -714,70 +802,14 @@ bool handler__operators(globals_t * vars, char **argv, unsigned argc)
         }
     }
 
-
-    if (strcmp(argv[0], "=") == 0)
-    {
-        m = (argc == 1) ? MATCHNOTCHANGED : MATCHEQUALTO;
-    }
-    else if (strcmp(argv[0], "!=") == 0)
-    {
-        m = (argc == 1) ? MATCHCHANGED : MATCHNOTEQUALTO;
-    }
-    else if (strcmp(argv[0], "<") == 0)
-    {
-        m = (argc == 1) ? MATCHDECREASED : MATCHLESSTHAN;
-    }
-    else if (strcmp(argv[0], ">") == 0)
-    {
-        m = (argc == 1) ? MATCHINCREASED : MATCHGREATERTHAN;
-    }
-    else if (strcmp(argv[0], "+") == 0)
-    {
-        m = (argc == 1) ? MATCHINCREASED : MATCHINCREASEDBY;
-    }
-    else if (strcmp(argv[0], "-") == 0)
-    {
-        m = (argc == 1) ? MATCHDECREASED : MATCHDECREASEDBY;
-    }
-    else
+    if (!parse_operator(argv[0], argc == 2, &m))
     {
         show_error("unrecognized operator seen at handler_operators: \"%s\".\n", argv[0]);
         return false;
     }
 
-    if (vars->matches) {
-        if (vars->num_matches == 0) {
-            show_error("there are currently no matches.\n");
-            return false;
-        }
-        if (sm_checkmatches(vars, m, &val) == false) {
-            show_error("failed to search target address space.\n");
-            return false;
-        }
-    } else {
-        /* Cannot be used on first scan:
-         *   =, !=, <, >, +, + N, -, - N
-         * Can be used on first scan:
-         *   = N, != N, < N, > N
-         */
-        if (m == MATCHNOTCHANGED  ||
-            m == MATCHCHANGED     ||
-            m == MATCHDECREASED   ||
-            m == MATCHINCREASED   ||
-            m == MATCHDECREASEDBY ||
-            m == MATCHINCREASEDBY )
-        {
-            show_error("cannot use that search without matches\n");
-            return false;
-        }
-        else
-        {
-            if (sm_searchregions(vars, m, &val) != true) {
-                show_error("failed to search target address space.\n");
-                return false;
-            }
-        }
-    }
+    if (!sm_scan(m, &val))
+        return false;
 
     if (vars->num_matches == 1) {
         show_info("match identified, use \"set\" to modify value.\n");
@@ -839,28 +871,13 @@ bool handler__string(globals_t * vars, char **argv, unsigned argc)
     val.flags = string_length;
  
     /* need a pid for the rest of this to work */
-    if (vars->target == 0) {
+    if (!has_target(vars)) {
         goto fail;
     }
 
     /* user has specified an exact value of the variable to find */
-    if (vars->matches) {
-        if (vars->num_matches == 0) {
-            show_error("there are currently no matches.\n");
-            return false;
-        }
-        /* already know some matches */
-        if (sm_checkmatches(vars, MATCHEQUALTO, &val) != true) {
-            show_error("failed to search target address space.\n");
-            goto fail;
-        }
-    } else {
-        /* initial search */
-        if (sm_searchregions(vars, MATCHEQUALTO, &val) != true) {
-            show_error("failed to search target address space.\n");
-            goto fail;
-        }
-    }
+    if (!sm_scan(MATCHEQUALTO, &val))
+        goto fail;
 
     /* check if we now know the only possible candidate */
     if (vars->num_matches == 1) {
@@ -887,13 +904,46 @@ static inline bool parse_uservalue_default(const char *str, uservalue_t *val)
     return ret;
 }
 
+/* parse `N` or a range `N..M` into `vals`, setting the match type */
+static bool parse_number_or_range(char *ustr, uservalue_t vals[2], scan_match_type_t *m)
+{
+    char *pos;
+
+    /* detect a range */
+    pos = strstr(ustr, "..");
+    if (pos) {
+        *pos = '\0';
+        if (!parse_uservalue_default(ustr, &vals[0]))
+            return false;
+        ustr = pos + 2;
+        if (!parse_uservalue_default(ustr, &vals[1]))
+            return false;
+
+        /* Check that the range is nonempty */
+        if (vals[0].float64_value > vals[1].float64_value) {
+            show_error("Empty range\n");
+            return false;
+        }
+
+        /* Store the bitwise AND of both flags in the first value,
+         * so that range scanroutines need only one flag testing. */
+        vals[0].flags &= vals[1].flags;
+        *m = MATCHRANGE;
+    }
+    else {
+        if (!parse_uservalue_default(ustr, &vals[0]))
+            return false;
+        *m = MATCHEQUALTO;
+    }
+    return true;
+}
+
 bool handler__default(globals_t * vars, char **argv, unsigned argc)
 {
     uservalue_t vals[2];
     uservalue_t *val = &vals[0];
     scan_match_type_t m = MATCHEQUALTO;
     char *ustr = argv[0];
-    char *pos;
     bool ret = false;
 
     zero_uservalue(val);
@@ -915,31 +965,8 @@ bool handler__default(globals_t * vars, char **argv, unsigned argc)
             show_error("unknown command\n");
             goto retl;
         }
-        /* detect a range */
-        pos = strstr(ustr, "..");
-        if (pos) {
-            *pos = '\0';
-            if (!parse_uservalue_default(ustr, &vals[0]))
-                goto retl;
-            ustr = pos + 2;
-            if (!parse_uservalue_default(ustr, &vals[1]))
-                goto retl;
-
-            /* Check that the range is nonempty */
-            if (vals[0].float64_value > vals[1].float64_value) {
-                show_error("Empty range\n");
-                goto retl;
-            }
-
-            /* Store the bitwise AND of both flags in the first value,
-             * so that range scanroutines need only one flag testing. */
-            vals[0].flags &= vals[1].flags;
-            m = MATCHRANGE;
-        }
-        else {
-            if (!parse_uservalue_default(ustr, val))
-                goto retl;
-        }
+        if (!parse_number_or_range(ustr, vals, &m))
+            goto retl;
         break;
     case BYTEARRAY:
         /* attempt to parse command as a bytearray */
@@ -959,28 +986,13 @@ bool handler__default(globals_t * vars, char **argv, unsigned argc)
     }
 
     /* need a pid for the rest of this to work */
-    if (vars->target == 0) {
+    if (!has_target(vars)) {
         goto retl;
     }
 
     /* user has specified an exact value of the variable to find */
-    if (vars->matches) {
-        if (vars->num_matches == 0) {
-            show_error("there are currently no matches.\n");
-            goto retl;
-        }
-        /* already know some matches */
-        if (sm_checkmatches(vars, m, val) != true) {
-            show_error("failed to search target address space.\n");
-            goto retl;
-        }
-    } else {
-        /* initial search */
-        if (sm_searchregions(vars, m, val) != true) {
-            show_error("failed to search target address space.\n");
-            goto retl;
-        }
-    }
+    if (!sm_scan(m, val))
+        goto retl;
 
     /* check if we now know the only possible candidate */
     if (vars->num_matches == 1) {
@@ -996,382 +1008,860 @@ retl:
     return ret;
 }
 
-bool handler__update(globals_t *vars, char **argv, unsigned argc)
+static void list_group(const sm_group_t *group)
 {
+    size_t i;
 
-    USEPARAMS();
-    if (vars->num_matches) {
-        if (sm_checkmatches(vars, MATCHUPDATE, NULL) == false) {
-            show_error("failed to scan target address space.\n");
-            return false;
-        }
-    } else {
-        show_error("cannot use that command without matches\n");
-        return false;
+    if (group == NULL || group->count == 0) {
+        show_info("the group is empty.\n");
+        return;
     }
 
-    return true;
-}
+    for (i = 0; i < group->count; i++) {
+        const globals_t *mvars = &group->members[i].vars;
 
-bool handler__exit(globals_t *vars, char **argv, unsigned argc)
-{
-    USEPARAMS();
+        const char *image = mvars->image ? mvars->image->path : NULL;
 
-    vars->exit = 1;
-    return true;
+        if (mvars->matches)
+            printf("[%2zu] %d%s%s, %lu regions, %lu matches\n", i, mvars->target,
+                   image ? " in " : "", image ? image : "",
+                   mvars->regions ? mvars->regions->size : 0, mvars->num_matches);
+        else
+            printf("[%2zu] %d%s%s, %lu regions, not scanned\n", i, mvars->target,
+                   image ? " in " : "", image ? image : "",
+                   mvars->regions ? mvars->regions->size : 0);
+    }
 }
 
-#define DOC_COLUMN  11           /* which column descriptions start on with the help command */
-
-bool handler__help(globals_t *vars, char **argv, unsigned argc)
+/* group scan <value> | group scan <op> [value] */
+static bool group_scan(globals_t *vars, char **argv, unsigned argc)
 {
-    bool ret = false;
-    list_t *commands = vars->commands;
-    element_t *np = NULL;
-    command_t *def = NULL;
-    FILE *pager;
-    assert(commands != NULL);
-    assert(argc >= 1);
-
-    np = commands->head;
+    uservalue_t vals[2];
+    scan_match_type_t m;
+    bool rescan = false;
+    size_t i;
 
-    pager = get_pager(stderr);
+    zero_uservalue(&vals[0]);
+    zero_uservalue(&vals[1]);
 
-    /* print version information for generic help */
-    if (argv[1] == NULL) {
-        vars->printversion(pager);
-        fprintf(pager, "\n");
+    if ((vars->options.scan_data_type == BYTEARRAY)
+       ||(vars->options.scan_data_type == STRING))
+    {
+        show_error("`group scan` supports numbers only.\n");
+        return false;
     }
 
-    /* traverse the commands list, printing out the relevant documentation */
-    while (np) {
-        command_t *command = np->data;
-
-        /* remember the default command */
-        if (command->command == NULL)
-            def = command;
+    if (argc == 1 && !parse_operator(argv[0], false, &m)) {
+        if (!parse_number_or_range(argv[0], vals, &m))
+            return false;
+    } else if (argc == 1 || argc == 2) {
+        if (!parse_operator(argv[0], argc == 2, &m)) {
+            show_error("unrecognized operator `%s`, see `help group`.\n", argv[0]);
+            return false;
+        }
+        if (argc == 2 && !parse_uservalue_number(argv[1], &vals[0])) {
+            show_error("bad value specified, see `help group`.\n");
+            return false;
+        }
+    } else {
+        show_error("expected a value or an operator, see `help group`.\n");
+        return false;
+    }
 
-        /* just `help` with no argument */
-        if (argv[1] == NULL) {
-            /* NULL shortdoc means don't print in the help listing */
-            if (command->shortdoc == NULL) {
-                np = np->next;
-                continue;
-            }
+    if (vars->group) {
+        for (i = 0; i < vars->group->count; i++)
+            rescan = rescan || vars->group->members[i].vars.matches;
+    }
+    if (!rescan && sm_needs_old_values(m)) {
+        show_error("cannot use that search without matches\n");
+        return false;
+    }
 
-            /* print out command name */
-            fprintf(pager, "%-*s%s\n", DOC_COLUMN, command->command ? command->command : "default", command->shortdoc);
+    return sm_group_scan(vars->group, vars, m, &vals[0]);
+}
 
-            /* detailed information requested about specific command */
-        } else if (command->command
-                   && strcasecmp(argv[1], command->command) == 0) {
-            fprintf(pager, "%s\n", command->longdoc ? command-> longdoc : "missing documentation");
-            ret = true;
-            goto retl;
-        }
+/* group common [max] */
+static bool group_common(globals_t *vars, char **argv, unsigned argc)
+{
+    sm_match_pos_t *common;
+    unsigned long max_to_print = 20;
+    size_t count, i;
 
-        np = np->next;
+    if (argc > 0 && (max_to_print = strtoul(argv[0], NULL, 0x00)) == 0) {
+        show_error("`%s` is not a valid positive integer.\n", argv[0]);
+        return false;
     }
 
-    if (argc > 1) {
-        show_error("unknown command `%s`\n", argv[1]);
-        ret = false;
-    } else if (def) {
-        fprintf(pager, "\n%s\n", def->longdoc ? def->longdoc : "");
-        ret = true;
+    if ((common = calloc(max_to_print, sizeof(sm_match_pos_t))) == NULL) {
+        show_error("memory allocation failed.\n");
+        return false;
     }
-    
-    ret = true;
 
-retl:
-    close_pager(pager);
+    if ((count = sm_group_intersect(vars->group, common, max_to_print)) == (size_t) -1) {
+        free(common);
+        return false;
+    }
 
-    return ret;
-}
+    for (i = 0; i < count && i < max_to_print; i++)
+        printf("[%2zu] %2u + "POINTER_FMT", %5s\n", i, common[i].region->id,
+               common[i].offset, region_type_names[common[i].region->type]);
+    if (count > max_to_print && !vars->options.backend)
+        printf("[...]\n");
+    fflush(stdout);
 
-bool handler__eof(globals_t * vars, char **argv, unsigned argc)
-{
-    show_user("exit\n");
-    return handler__exit(vars, argv, argc);
+    show_info("%zu positions match in all %zu processes.\n", count, vars->group->count);
+    free(common);
+    return true;
 }
 
-/* XXX: handle !ls style escapes */
-bool handler__shell(globals_t * vars, char **argv, unsigned argc)
+bool handler__group(globals_t *vars, char **argv, unsigned argc)
 {
-    size_t len = argc;
+    const char *cmd = (argc > 1) ? argv[1] : "list";
     unsigned i;
-    char *command;
-
-    USEPARAMS();
 
-    if (argc < 2) {
-        show_error("shell command requires an argument, see `help shell`.\n");
+    if (strcmp(cmd, "list") == 0) {
+        list_group(vars->group);
+        return true;
+    }
+
+    if (vars->group == NULL && (vars->group = sm_group_create()) == NULL)
         return false;
+
+    if (strcmp(cmd, "add") == 0) {
+        bool ret = true;
+
+        if (argc < 3) {
+            show_error("expected at least one pid, see `help group`.\n");
+            return false;
+        }
+        for (i = 2; i < argc; i++) {
+            char *end = NULL;
+            pid_t pid = (pid_t) strtoul(argv[i], &end, 0x00);
+
+            if (pid == 0 || *end != '\0') {
+                show_error("`%s` does not look like a valid pid.\n", argv[i]);
+                ret = false;
+                continue;
+            }
+            ret = sm_group_add(vars->group, vars, pid) && ret;
+        }
+        return ret;
+    } else if (strcmp(cmd, "core") == 0) {
+        bool ret = true;
+
+        if (argc < 3) {
+            show_error("expected at least one file name, see `help group`.\n");
+            return false;
+        }
+        for (i = 2; i < argc; i++)
+            ret = sm_group_add_image(vars->group, vars, argv[i]) && ret;
+        return ret;
+    } else if (strcmp(cmd, "name") == 0) {
+        size_t added;
+
+        if (argc != 3) {
+            show_error("expected an executable name, see `help group`.\n");
+            return false;
+        }
+        added = sm_group_add_by_name(vars->group, vars, argv[2]);
+        show_info("added %zu processes called `%s`.\n", added, argv[2]);
+        return added > 0;
+    } else if (strcmp(cmd, "remove") == 0) {
+        if (argc != 3) {
+            show_error("expected a pid, see `help group`.\n");
+            return false;
+        }
+        return sm_group_remove(vars->group, (pid_t) strtoul(argv[2], NULL, 0x00));
+    } else if (strcmp(cmd, "clear") == 0) {
+        sm_group_destroy(vars->group);
+        vars->group = NULL;
+        return true;
+    } else if (strcmp(cmd, "reset") == 0) {
+        return sm_group_reset(vars->group, vars);
+    } else if (strcmp(cmd, "snapshot") == 0) {
+        return sm_group_scan(vars->group, vars, MATCHANY, NULL);
+    } else if (strcmp(cmd, "scan") == 0) {
+        return group_scan(vars, argv + 2, argc - 2);
+    } else if (strcmp(cmd, "common") == 0) {
+        return group_common(vars, argv + 2, argc - 2);
     }
 
-    /* convert arg vector into single string, first calculate length */
-    for (i = 1; i < argc; i++)
-        len += strlen(argv[i]);
+    show_error("unknown group command `%s`, see `help group`.\n", cmd);
+    return false;
+}
 
-    /* allocate space */
-    command = calloca(len, 1);
+bool handler__struct(globals_t *vars, char **argv, unsigned argc)
+{
+    const char *text = vars->current_cmdline;
+    sm_layout_t layout;
 
-    /* concatenate strings */
-    for (i = 1; i < argc; i++) {
-        strcat(command, argv[i]);
-        strcat(command, " ");
+    USEPARAMS();
+
+    if (argc < 2) {
+        show_error("please describe the structure, see `help struct`.\n");
+        return false;
+    }
+    if (vars->options.scan_data_type == BYTEARRAY || vars->options.scan_data_type == STRING) {
+        show_error("scan_data_type is not a number, see `help option`.\n");
+        return false;
+    }
+    if (!has_target(vars)) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
     }
 
-    /* finally execute command */
-    if (system(command) == -1) {
-// command is allocated with alloca, do not free it
-//        free(command);
-        show_error("system() failed, command was not executed.\n");
+    /* the fields are everything after the command */
+    text += strspn(text, " \t");
+    text += strcspn(text, " \t");
+    if (!sm_layout_parse(text, vars->options.reverse_endianness, &layout))
+        return false;
+
+    if (vars->matches) {
+        if (vars->num_matches == 0) {
+            show_error("there are currently no matches.\n");
+            return false;
+        }
+        if (!sm_checklayout(vars, &vars->reader, &layout)) {
+            show_error("failed to search target address space.\n");
+            return false;
+        }
+    } else if (!sm_searchlayout(vars, &vars->reader, &layout)) {
+        show_error("failed to search target address space.\n");
         return false;
     }
 
-// command is allocated with alloca, do not free it
-//    free(command);
+    if (vars->num_matches == 1) {
+        show_info("match identified, use \"set\" to modify value.\n");
+        show_info("enter \"help\" for other commands.\n");
+    }
     return true;
 }
 
-bool handler__watch(globals_t * vars, char **argv, unsigned argc)
+bool handler__near(globals_t *vars, char **argv, unsigned argc)
 {
-    size_t id;
-    char *end = NULL, buf[128], timestamp[64];
-    time_t t;
-    match_location loc;
-    value_t val;
-    void *address;
-    scan_data_type_t data_type = vars->options.scan_data_type;
-    scan_routine_t valuecmp_routine;
+    sm_proximity_t near;
+    char *end;
+    int k;
 
-    if (argc != 2) {
-        show_error("was expecting one argument, see `help watch`.\n");
+    if (argc != 3 && argc != 4) {
+        show_error("expected two values and a window, see `help near`.\n");
         return false;
     }
-    if ((data_type == BYTEARRAY) || (data_type == STRING)) {
-        show_error("`watch` is not supported for bytearray or string.\n");
+    if (vars->options.scan_data_type == BYTEARRAY || vars->options.scan_data_type == STRING) {
+        show_error("scan_data_type is not a number, see `help option`.\n");
         return false;
     }
 
-    /* parse argument */
-    id = strtoul(argv[1], &end, 0x00);
+    memset(&near, 0, sizeof(near));
+    for (k = 0; k < 2; k++) {
+        zero_uservalue(&near.values[k][0]);
+        zero_uservalue(&near.values[k][1]);
+        if (!parse_number_or_range(argv[k + 1], near.values[k], &near.match_type[k]))
+            return false;
+    }
+    near.window = 64;
+    if (argc == 4) {
+        near.window = strtoul(argv[3], &end, 0x00);
+        if (*end != '\0' || near.window == 0 || near.window > SM_PROXIMITY_MAX_WINDOW) {
+            show_error("the window is from 1 to %d bytes.\n", SM_PROXIMITY_MAX_WINDOW);
+            return false;
+        }
+    }
 
-    /* check that strtoul() worked */
-    if (argv[1][0] == '\0' || *end != '\0') {
-        show_error("sorry, couldn't parse `%s`, try `help watch`\n",
-                argv[1]);
+    if (!has_target(vars)) {
+        show_error("no target has been specified, see `help pid`.\n");
         return false;
     }
-    
-    loc = matches__nth_match(vars->matches, id);
 
-    /* check that this is a valid match-id */
-    if (!loc.swath) {
-        show_error("you specified a non-existent match `%u`.\n", id);
-        show_info("use \"list\" to list matches, or \"help\" for other commands.\n");
+    if (vars->matches) {
+        if (vars->num_matches == 0) {
+            show_error("there are currently no matches.\n");
+            return false;
+        }
+        if (!sm_checknear(vars, &vars->reader, &near)) {
+            show_error("failed to search target address space.\n");
+            return false;
+        }
+    } else if (!sm_searchnear(vars, &vars->reader, &near)) {
+        show_error("failed to search target address space.\n");
         return false;
     }
-    
-    address = swath__remote_address_of_nth_element(loc.swath, loc.index);
-    
-    val = data_to_val(loc.swath, loc.index);
 
-    if (INTERRUPTABLE()) {
-        (void) sm_detach(vars->target);
-        ENDINTERRUPTABLE();
-        return true;
+    if (vars->num_matches == 1) {
+        show_info("match identified, use \"set\" to modify value.\n");
+        show_info("enter \"help\" for other commands.\n");
+    }
+    return true;
+}
+
+bool handler__update(globals_t *vars, char **argv, unsigned argc)
+{
+
+    USEPARAMS();
+    if (vars->num_matches) {
+        if (sm_checkmatches(vars, &vars->reader, MATCHUPDATE, NULL) == false) {
+            show_error("failed to scan target address space.\n");
+            return false;
+        }
+    } else {
+        show_error("cannot use that command without matches\n");
+        return false;
     }
 
-    /* every entry is timestamped */
-    t = time(NULL);
-    strftime(timestamp, sizeof(timestamp), "[%T]", localtime(&t));
+    return true;
+}
 
-    show_info("%s monitoring %10p for changes until interrupted...\n", timestamp, address);
+bool handler__exit(globals_t *vars, char **argv, unsigned argc)
+{
+    USEPARAMS();
 
-    valuecmp_routine = sm_get_scanroutine(ANYNUMBER, MATCHCHANGED, flags_empty, vars->options.reverse_endianness);
-    while (true) {
-        const mem64_t *memory_ptr;
-        size_t memlength;
+    vars->exit = 1;
+    return true;
+}
 
-        if (sm_attach(vars->target) == false)
-            return false;
+#define DOC_COLUMN  11           /* which column descriptions start on with the help command */
 
-        if (sm_peekdata(address, sizeof(uint64_t), &memory_ptr, &memlength) == false)
-            return false;
+bool handler__help(globals_t *vars, char **argv, unsigned argc)
+{
+    bool ret = false;
+    list_t *commands = vars->commands;
+    element_t *np = NULL;
+    command_t *def = NULL;
+    FILE *pager;
+    assert(commands != NULL);
+    assert(argc >= 1);
 
-        /* check if the new value is different */
-        match_flags tmpflags = flags_empty;
-        if ((*valuecmp_routine)(memory_ptr, memlength, &val, NULL, &tmpflags)) {
+    np = commands->head;
+
+    pager = get_pager(stderr);
+
+    /* print version information for generic help */
+    if (argv[1] == NULL) {
+        vars->printversion(pager);
+        fprintf(pager, "\n");
+    }
+
+    /* traverse the commands list, printing out the relevant documentation */
+    while (np) {
+        command_t *command = np->data;
 
-            memcpy(val.bytes, memory_ptr, memlength);
+        /* remember the default command */
+        if (command->command == NULL)
+            def = command;
 
-            valtostr(&val, buf, sizeof(buf));
+        /* just `help` with no argument */
+        if (argv[1] == NULL) {
+            /* NULL shortdoc means don't print in the help listing */
+            if (command->shortdoc == NULL) {
+                np = np->next;
+                continue;
+            }
 
-            /* fetch new timestamp */
-            t = time(NULL);
-            strftime(timestamp, sizeof(timestamp), "[%T]", localtime(&t));
+            /* print out command name */
+            fprintf(pager, "%-*s%s\n", DOC_COLUMN, command->command ? command->command : "default", command->shortdoc);
 
-            show_info("%s %10p -> %s\n", timestamp, address, buf);
+            /* detailed information requested about specific command */
+        } else if (command->command
+                   && strcasecmp(argv[1], command->command) == 0) {
+            fprintf(pager, "%s\n", command->longdoc ? command-> longdoc : "missing documentation");
+            ret = true;
+            goto retl;
         }
 
-        /* detach after valuecmp_routine, since it may read more data (e.g. bytearray) */
-        sm_detach(vars->target);
+        np = np->next;
+    }
 
-        (void) sleep(1);
+    if (argc > 1) {
+        show_error("unknown command `%s`\n", argv[1]);
+        ret = false;
+    } else if (def) {
+        fprintf(pager, "\n%s\n", def->longdoc ? def->longdoc : "");
+        ret = true;
     }
+    
+    ret = true;
+
+retl:
+    close_pager(pager);
+
+    return ret;
 }
 
-#include "licence.h"
+bool handler__eof(globals_t * vars, char **argv, unsigned argc)
+{
+    show_user("exit\n");
+    return handler__exit(vars, argv, argc);
+}
 
-bool handler__show(globals_t * vars, char **argv, unsigned argc)
+/* XXX: handle !ls style escapes */
+bool handler__shell(globals_t * vars, char **argv, unsigned argc)
 {
+    size_t len = argc;
+    unsigned i;
+    char *command;
+
     USEPARAMS();
-    
-    if (argv[1] == NULL) {
-        show_error("expecting an argument.\n");
+
+    if (argc < 2) {
+        show_error("shell command requires an argument, see `help shell`.\n");
         return false;
     }
-    
-    if (strcmp(argv[1], "copying") == 0)
-        show_user(SM_COPYING);
-    else if (strcmp(argv[1], "warranty") == 0)
-        show_user(SM_WARRANTY);
-    else if (strcmp(argv[1], "version") == 0)
-        vars->printversion(stderr);
-    else {
-        show_error("unrecognized show command `%s`\n", argv[1]);
+
+    /* convert arg vector into single string, first calculate length */
+    for (i = 1; i < argc; i++)
+        len += strlen(argv[i]);
+
+    /* allocate space */
+    command = calloca(len, 1);
+
+    /* concatenate strings */
+    for (i = 1; i < argc; i++) {
+        strcat(command, argv[i]);
+        strcat(command, " ");
+    }
+
+    /* finally execute command */
+    if (system(command) == -1) {
+// command is allocated with alloca, do not free it
+//        free(command);
+        show_error("system() failed, command was not executed.\n");
         return false;
     }
-    
+
+// command is allocated with alloca, do not free it
+//    free(command);
     return true;
 }
 
-bool handler__dump(globals_t * vars, char **argv, unsigned argc)
+/* add the matches of the set `ids` to `watch` */
+static bool watch_matches(globals_t *vars, sm_watch_t *watch, const char *ids)
 {
-    void *addr;
-    char *endptr;
-    char *buf = NULL;
-    int len;
-    bool dump_to_file = false;
-    FILE *dump_f = NULL;
+    struct set set;
+    swath_t *swath;
+    size_t n = 0, k = 0, i;
+    bool ret = true;
 
-    if (argc < 3 || argc > 4)
-    {
-        show_error("bad argument, see `help dump`.\n");
+    if ((vars->options.scan_data_type == BYTEARRAY) || (vars->options.scan_data_type == STRING)) {
+        show_error("`watch` is not supported for bytearray or string matches.\n");
         return false;
     }
-    
-    /* check address */
-    errno = 0;
-    addr = (void *)(strtoll(argv[1], &endptr, 16));
-    if ((errno != 0) || (*endptr != '\0'))
-    {
-        show_error("bad address, see `help dump`.\n");
+    if (vars->num_matches == 0) {
+        show_error("no matches are known.\n");
         return false;
     }
-
-    /* check length */
-    errno = 0;
-    len = strtoll(argv[2], &endptr, 0);
-    if ((errno != 0) || (*endptr != '\0'))
-    {
-        show_error("bad length, see `help dump`.\n");
+    if (!parse_uintset(ids, &set, vars->num_matches)) {
+        show_error("failed to parse the set, try `help watch`.\n");
         return false;
     }
 
-    /* check filename */
-    if (argc == 4)
-    {
-        if((dump_f = fopen(argv[3], "wb")) == NULL)
-        {
-            show_error("failed to open file\n");
-            return false;
-        }
-        dump_to_file = true;
-    }
+    /* the set is sorted, walk the matches once */
+    for (swath = vars->matches->swaths; swath->first_byte_in_child && k < set.size;
+         swath = swath__local_address_beyond_last_element(swath)) {
+        for (i = 0; i < swath->number_of_bytes && k < set.size; i++) {
+            match_flags flags = swath->data[i].flags;
+
+            if (flags == flags_empty)
+                continue;
+            if (set.buf[k] == n) {
+                if (!sm_watch_add(watch, swath__remote_address_of_nth_element(swath, i),
+                                  flags_width(flags), flags, (long) n)) {
+                    ret = false;
+                    goto out;
+                }
+                while (k < set.size && set.buf[k] == n)
+                    k++;
+            }
+            n++;
+        }
+    }
+
+out:
+    set_cleanup(&set);
+    return ret;
+}
+
+/* add a location given as `@address[:width]` to `watch` */
+static bool watch_address(sm_watch_t *watch, const char *arg)
+{
+    static const match_flags width_flags[] = {
+        0, flags_8b, flags_16b, 0, flags_32b, 0, 0, 0, flags_64b
+    };
+    char *end = NULL;
+    uintptr_t address = strtoul(arg + 1, &end, 0x10);
+    unsigned long width = 4;
+
+    if (arg[1] == '\0' || (*end != '\0' && *end != ':')) {
+        show_error("sorry, couldn't parse the address `%s`, try `help watch`\n", arg);
+        return false;
+    }
+    if (*end == ':') {
+        width = strtoul(end + 1, &end, 0);
+        if (*end != '\0' || width == 0 || width > 8 || width_flags[width] == 0) {
+            show_error("the width of `%s` must be 1, 2, 4 or 8.\n", arg);
+            return false;
+        }
+    }
+    return sm_watch_add(watch, address, width, width_flags[width], -1);
+}
+
+typedef struct {
+    size_t entry;
+    sm_watch_sample_t sample;
+} watch_event_t;
+
+static int compare_watch_events(const void *a, const void *b)
+{
+    const watch_event_t *x = a, *y = b;
+
+    return (x->sample.time_ns > y->sample.time_ns) - (x->sample.time_ns < y->sample.time_ns);
+}
+
+static void format_watch_value(const sm_watch_entry_t *entry, uint64_t bytes, char *buf, size_t n)
+{
+    value_t val;
+
+    memset(&val, 0, sizeof(val));
+    memcpy(val.bytes, &bytes, sizeof(val.bytes));
+    val.flags = entry->flags;
+    valtostr(&val, buf, n);
+}
+
+/* print the changes recorded since the last call, in the order they happened */
+static void print_watch_events(sm_watch_t *watch, watch_event_t *events,
+                               const struct timespec *started)
+{
+    size_t count = 0, i, n;
+
+    for (i = 0; i < watch->count; i++) {
+        sm_watch_sample_t samples[SM_WATCH_HISTORY];
+
+        n = sm_watch_drain(watch, i, samples, SM_WATCH_HISTORY);
+        for (size_t j = 0; j < n; j++) {
+            events[count].entry = i;
+            events[count++].sample = samples[j];
+        }
+    }
+    qsort(events, count, sizeof(watch_event_t), compare_watch_events);
+
+    for (i = 0; i < count; i++) {
+        const sm_watch_entry_t *entry = &watch->entries[events[i].entry];
+        uint64_t ns = started->tv_nsec + events[i].sample.time_ns;
+        time_t t = started->tv_sec + ns / 1000000000ULL;
+        char timestamp[64], id[32] = "", buf[128];
+
+        strftime(timestamp, sizeof(timestamp), "%T", localtime(&t));
+        if (entry->match_id >= 0)
+            snprintf(id, sizeof(id), " (%ld)", entry->match_id);
+        format_watch_value(entry, events[i].sample.value, buf, sizeof(buf));
+        show_info("[%s.%03u] %10p%s -> %s\n", timestamp, (unsigned) (ns % 1000000000ULL / 1000000),
+                  (void *) entry->address, id, buf);
+    }
+}
+
+static void print_watch_summary(const sm_watch_t *watch)
+{
+    double seconds = watch->elapsed_ns / 1e9;
+    unsigned long lost = 0, errors = 0;
+    size_t i;
+
+    for (i = 0; i < watch->count; i++) {
+        const sm_watch_entry_t *entry = &watch->entries[i];
+        char first[128], last[128], gaps[64] = "";
+
+        lost += entry->lost;
+        errors += entry->errors;
+        if (entry->samples == 0) {
+            show_info("%10p: could not be read.\n", (void *) entry->address);
+            continue;
+        }
+        format_watch_value(entry, entry->first, first, sizeof(first));
+        format_watch_value(entry, entry->last, last, sizeof(last));
+        if (entry->changes > 1)
+            snprintf(gaps, sizeof(gaps), ", %.3f to %.3f ms apart",
+                     entry->min_gap_ns / 1e6, entry->max_gap_ns / 1e6);
+        show_info("%10p: %lu changes (%.2f/s)%s, %s to %s\n", (void *) entry->address,
+                  entry->changes, seconds > 0 ? entry->changes / seconds : 0.0, gaps, first, last);
+    }
+
+    show_info("%lu rounds of %lu locations in %.3f s, %lu ticks missed (up to %.3f ms late).\n",
+              watch->rounds, (unsigned long) watch->count, seconds, watch->late_rounds,
+              watch->max_lateness_ns / 1e6);
+    if (lost > 0 || errors > 0)
+        show_info("%lu changes not recorded, %lu failed reads.\n", lost, errors);
+}
+
+bool handler__watch(globals_t * vars, char **argv, unsigned argc)
+{
+    double interval_ms = 1000;
+    char *last, *slash;
+    sm_watch_t *watch;
+    watch_event_t *events = NULL;
+    struct timespec started;
+    unsigned i;
+    bool ret = false;
+
+    if (argc < 2) {
+        show_error("expected an argument, see `help watch`.\n");
+        return false;
+    }
+    if (vars->target == 0) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+
+    /* the sample interval is a suffix of the last argument */
+    last = strdupa(argv[argc - 1]);
+    if ((slash = strchr(last, '/')) != NULL) {
+        char *end = NULL;
+
+        interval_ms = strtod(slash + 1, &end);
+        if (slash[1] == '\0' || *end != '\0' || !(interval_ms > 0)) {
+            show_error("bad sample interval `%s`, see `help watch`.\n", slash + 1);
+            return false;
+        }
+        *slash = '\0';
+    }
+
+    if ((watch = sm_watch_create(vars->target, (uint64_t) (interval_ms * 1e6))) == NULL)
+        return false;
+    if (watch->interval_ns == 0)
+        watch->interval_ns = 1;
+
+    for (i = 1; i < argc; i++) {
+        const char *arg = (i == argc - 1) ? last : argv[i];
+
+        if (!(arg[0] == '@' ? watch_address(watch, arg) : watch_matches(vars, watch, arg)))
+            goto out;
+    }
+    if (watch->count == 0) {
+        show_error("nothing to watch.\n");
+        goto out;
+    }
+
+    if ((events = malloc(watch->count * SM_WATCH_HISTORY * sizeof(watch_event_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto out;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &started);
+    if (!sm_watch_start(watch))
+        goto out;
+
+    show_info("monitoring %lu locations every %g ms for changes until interrupted...\n",
+              (unsigned long) watch->count, interval_ms);
+
+    vars->stop_flag = false;
+    INTERRUPTABLESCAN();
+    while (!vars->stop_flag && !sm_watch_failed(watch)) {
+        usleep(20000);
+        print_watch_events(watch, events, &started);
+    }
+    ENDINTERRUPTABLE();
+
+    sm_watch_stop(watch);
+    print_watch_events(watch, events, &started);
+    if (sm_watch_failed(watch))
+        show_error("the target is gone.\n");
+    print_watch_summary(watch);
+    ret = !sm_watch_failed(watch);
+
+out:
+    free(events);
+    sm_watch_destroy(watch);
+    return ret;
+}
+
+#include "licence.h"
+
+bool handler__show(globals_t * vars, char **argv, unsigned argc)
+{
+    USEPARAMS();
+    
+    if (argv[1] == NULL) {
+        show_error("expecting an argument.\n");
+        return false;
+    }
+    
+    if (strcmp(argv[1], "copying") == 0)
+        show_user(SM_COPYING);
+    else if (strcmp(argv[1], "warranty") == 0)
+        show_user(SM_WARRANTY);
+    else if (strcmp(argv[1], "version") == 0)
+        vars->printversion(stderr);
+    else {
+        show_error("unrecognized show command `%s`\n", argv[1]);
+        return false;
+    }
+    
+    return true;
+}
+
+/* save `len` bytes from `addr` to `path`, chunk by chunk */
+static bool dump_to_file(globals_t *vars, uintptr_t addr, size_t len, const char *path)
+{
+    address_range_t range = { addr, addr + len }, *holes = NULL;
+    size_t num_holes = 0, missing = 0, i;
+    off_t offset = 0;
+    bool ret;
+    int fd;
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+        show_error("failed to open file\n");
+        return false;
+    }
+
+    vars->stop_flag = false;
+    INTERRUPTABLESCAN();
+    ret = sm_dump_memory(vars, &range, &offset, 1, fd, &holes, &num_holes);
+    ENDINTERRUPTABLE();
+    if (close(fd) == -1)
+        ret = false;
+    if (!ret) {
+        show_error("write to file failed.\n");
+        free(holes);
+        return false;
+    }
+    if (vars->stop_flag) {
+        if (!vars->options.backend)
+            printf("\n");
+        show_error("interrupted, `%s` holds only the start of the dump.\n", path);
+        free(holes);
+        return false;
+    }
+    if (!vars->options.backend)
+        show_user("ok\n");
+
+    if (num_holes > 0) {
+        size_t holes_path_len = strlen(path) + sizeof(".holes");
+        char *holes_path = alloca(holes_path_len);
+        FILE *f;
+
+        /* the file reads zeros there, keep a note of where it should not */
+        snprintf(holes_path, holes_path_len, "%s.holes", path);
+        if ((f = fopen(holes_path, "w")) == NULL) {
+            show_error("failed to create `%s`: %s.\n", holes_path, strerror(errno));
+            ret = false;
+        } else {
+            for (i = 0; i < num_holes; i++)
+                fprintf(f, "%lx-%lx\n", (unsigned long) holes[i].start, (unsigned long) holes[i].end);
+            if (fclose(f) != 0) {
+                show_error("failed to write `%s`: %s.\n", holes_path, strerror(errno));
+                ret = false;
+            }
+        }
+        for (i = 0; i < num_holes; i++) {
+            show_info("could not read %10p-%10p.\n", (void *) holes[i].start, (void *) holes[i].end);
+            missing += holes[i].end - holes[i].start;
+        }
+        if (ret)
+            show_warn("%zu bytes could not be read, see `%s`.\n", missing, holes_path);
+        else
+            show_warn("%zu bytes could not be read.\n", missing);
+    }
+
+    free(holes);
+    return ret;
+}
+
+bool handler__dump(globals_t * vars, char **argv, unsigned argc)
+{
+    void *addr;
+    char *endptr;
+    char *buf = NULL;
+    unsigned long long size;
+    int len;
+
+    if (argc < 3 || argc > 4)
+    {
+        show_error("bad argument, see `help dump`.\n");
+        return false;
+    }
+    
+    /* check address */
+    errno = 0;
+    addr = (void *)(strtoll(argv[1], &endptr, 16));
+    if ((errno != 0) || (*endptr != '\0'))
+    {
+        show_error("bad address, see `help dump`.\n");
+        return false;
+    }
+
+    /* check length */
+    errno = 0;
+    size = strtoull(argv[2], &endptr, 0);
+    if ((errno != 0) || (*endptr != '\0') || (argc == 3 && size > INT_MAX))
+    {
+        show_error("bad length, see `help dump`.\n");
+        return false;
+    }
+    len = (int) size;
+
+    /* files are written as the memory is read */
+    if (argc == 4)
+        return dump_to_file(vars, (uintptr_t) addr, size, argv[3]);
 
     buf = malloc(len + sizeof(long));
     if (buf == NULL)
     {
-        if (dump_f)
-            fclose(dump_f);
         show_error("memory allocation failed.\n");
         return false;
     }
 
-    if (!sm_read_array(vars->target, addr, buf, len))
+    if (!sm_read_array(&vars->reader, addr, buf, len))
     {
-        if (dump_f)
-            fclose(dump_f);
         show_error("read memory failed.\n");
         free(buf);
         return false;
     }
 
-    if(dump_to_file)
+    if (vars->options.backend == 1)
     {
-        size_t s = fwrite(buf,1,len,dump_f);
-        fclose(dump_f);
-        if (s != len)
-        {
-            show_error("write to file failed.\n");
-            free(buf);
-            return false;
-        }  
+        /* dump raw memory to stdout, the front-end will handle it */
+        fwrite(buf, sizeof(char), len, stdout);
     }
     else
     {
-        if (vars->options.backend == 1)
-        {
-            /* dump raw memory to stdout, the front-end will handle it */
-            fwrite(buf, sizeof(char), len, stdout);
-        }
-        else
+        /* print it out nicely */
+        int i,j;
+        int buf_idx = 0;
+        for (i = 0; i + 16 < len; i += 16)
         {
-            /* print it out nicely */
-            int i,j;
-            int buf_idx = 0;
-            for (i = 0; i + 16 < len; i += 16)
+            printf("%p: ", addr+i);
+            for (j = 0; j < 16; ++j)
+            {
+                printf("%02X ", (unsigned char)(buf[buf_idx++]));
+            }
+            if(vars->options.dump_with_ascii == 1)
             {
-                printf("%p: ", addr+i);
                 for (j = 0; j < 16; ++j)
                 {
-                    printf("%02X ", (unsigned char)(buf[buf_idx++]));
-                }
-                if(vars->options.dump_with_ascii == 1)
-                {
-                    for (j = 0; j < 16; ++j)
-                    {
-                        char c = buf[i+j];
-                        printf("%c", isprint(c) ? c : '.');
-                    }
+                    char c = buf[i+j];
+                    printf("%c", isprint(c) ? c : '.');
                 }
-                printf("\n");
             }
-            if (i < len)
+            printf("\n");
+        }
+        if (i < len)
+        {
+            printf("%p: ", addr+i);
+            for (j = i; j < len; ++j)
+            {
+                printf("%02X ", (unsigned char)(buf[buf_idx++]));
+            }
+            if(vars->options.dump_with_ascii == 1)
             {
-                printf("%p: ", addr+i);
-                for (j = i; j < len; ++j)
+                while(j%16 !=0) // skip "empty" numbers
                 {
-                    printf("%02X ", (unsigned char)(buf[buf_idx++]));
+                    printf("   ");
+                    ++j;
                 }
-                if(vars->options.dump_with_ascii == 1)
+                for (j = 0; i+j < len; ++j)
                 {
-                    while(j%16 !=0) // skip "empty" numbers
-                    {
-                        printf("   ");
-                        ++j;
-                    }
-                    for (j = 0; i+j < len; ++j)
-                    {
-                        char c = buf[i+j];
-                        printf("%c", isprint(c) ? c : '.');
-                    }
+                    char c = buf[i+j];
+                    printf("%c", isprint(c) ? c : '.');
                 }
-                printf("\n");
             }
+            printf("\n");
         }
     }
 
@@ -1379,6 +1869,126 @@ bool handler__dump(globals_t * vars, char **argv, unsigned argc)
     return true;
 }
 
+/* readmany <address>:<length> [...] */
+bool handler__readmany(globals_t *vars, char **argv, unsigned argc)
+{
+    sm_read_span_t *spans;
+    uint8_t *buf = NULL;
+    size_t total = 0, offset = 0;
+    unsigned i;
+    bool ret = false;
+
+    if (argc < 2) {
+        show_error("expected <address>:<length> pairs, see `help readmany`.\n");
+        return false;
+    }
+    if (!has_target(vars)) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+    if ((spans = calloc(argc - 1, sizeof(sm_read_span_t))) == NULL) {
+        show_error("memory allocation failed.\n");
+        return false;
+    }
+
+    for (i = 1; i < argc; i++) {
+        char *colon = strchr(argv[i], ':');
+        char *end;
+
+        errno = 0;
+        spans[i - 1].address = strtoull(argv[i], &end, 16);
+        if (colon == NULL || end != colon || errno != 0) {
+            show_error("bad address in `%s`, see `help readmany`.\n", argv[i]);
+            goto retl;
+        }
+        spans[i - 1].length = strtoul(colon + 1, &end, 0);
+        if (colon[1] == '\0' || *end != '\0' || spans[i - 1].length > READMANY_MAX_LENGTH) {
+            show_error("bad length in `%s`, see `help readmany`.\n", argv[i]);
+            goto retl;
+        }
+        total += spans[i - 1].length;
+    }
+
+    if ((buf = malloc(total ? total : 1)) == NULL) {
+        show_error("memory allocation failed.\n");
+        goto retl;
+    }
+    if (!sm_readmany(&vars->reader, spans, argc - 1, buf)) {
+        show_error("read memory failed.\n");
+        goto retl;
+    }
+
+    if (vars->options.backend == 1) {
+        /* whether each span could be read, then all of them, for the front-end */
+        for (i = 0; i < argc - 1; i++)
+            fputc(spans[i].ok ? 1 : 0, stdout);
+        fwrite(buf, sizeof(char), total, stdout);
+    } else {
+        for (i = 0; i < argc - 1; i++) {
+            size_t j;
+
+            printf(POINTER_FMT ":", (unsigned long) spans[i].address);
+            if (!spans[i].ok)
+                printf(" unreadable");
+            for (j = 0; spans[i].ok && j < spans[i].length; j++)
+                printf(" %02X", buf[offset + j]);
+            printf("\n");
+            offset += spans[i].length;
+        }
+    }
+    ret = true;
+
+retl:
+    free(buf);
+    free(spans);
+    return ret;
+}
+
+bool handler__savecore(globals_t *vars, char **argv, unsigned argc)
+{
+    bool ret;
+
+    if (argc != 2) {
+        show_error("expected a file name, see `help savecore`.\n");
+        return false;
+    }
+    if (!has_target(vars)) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+
+    vars->stop_flag = false;
+    INTERRUPTABLESCAN();
+    ret = sm_savecore(vars, argv[1]);
+    ENDINTERRUPTABLE();
+    return ret;
+}
+
+bool handler__loadcore(globals_t *vars, char **argv, unsigned argc)
+{
+    char *resetargv[] = { "reset", NULL };
+    sm_image_t *image;
+
+    if (argc != 2) {
+        show_error("expected a file name, see `help loadcore`.\n");
+        return false;
+    }
+    if ((image = sm_image_open(argv[1])) == NULL)
+        return false;
+
+    /* nothing of the previous target is kept, it is not touched anymore */
+    sm_freezer_destroy(vars->freezer);
+    vars->freezer = NULL;
+    sm_reader_close(&vars->reader);
+    sm_image_close(vars->image);
+    vars->image = image;
+    vars->target = 0;
+
+    show_info("%u regions saved from %d, %lu holes.\n", image->header.num_regions,
+              image->header.pid, (unsigned long) image->header.num_holes);
+    return handler__reset(vars, resetargv, 1);
+}
+
 /* Returns (scan_data_type_t)(-1) on parse failure */
 static inline scan_data_type_t parse_scan_data_type(const char *str)
 {
@@ -1420,192 +2030,747 @@ static inline scan_data_type_t parse_scan_data_type(const char *str)
     return (scan_data_type_t)(-1);
 }
 
-/* write value_type address value */
-bool handler__write(globals_t * vars, char **argv, unsigned argc)
+/* write value_type address value */
+bool handler__write(globals_t * vars, char **argv, unsigned argc)
+{
+    int data_width = 0;
+    const char *fmt = NULL;
+    void *addr;
+    char *buf = NULL;
+    char *endptr;
+    int datatype; /* 0 for numbers, 1 for bytearray, 2 for string */
+    bool ret;
+    const char *string_parameter = NULL; /* used by string type */
+
+    if (argc < 4)
+    {
+        show_error("bad arguments, see `help write`.\n");
+        ret = false;
+        goto retl;
+    }
+    if (vars->target == 0)
+    {
+        show_error("no target has been specified, see `help pid`.\n");
+        ret = false;
+        goto retl;
+    }
+
+    scan_data_type_t st = parse_scan_data_type(argv[1]);
+
+    /* try int first */
+    if (st == INTEGER8)
+    {
+        data_width = 1;
+        datatype = 0;
+        fmt = "%"PRId8;
+    }
+    else if (st == INTEGER16)
+    {
+        data_width = 2;
+        datatype = 0;
+        fmt = "%"PRId16;
+    }
+    else if (st == INTEGER32)
+    {
+        data_width = 4;
+        datatype = 0;
+        fmt = "%"PRId32;
+    }
+    else if (st == INTEGER64)
+    {
+        data_width = 8;
+        datatype = 0;
+        fmt = "%"PRId64;
+    }
+    else if (st == FLOAT32)
+    {
+        data_width = 4;
+        datatype = 0;
+        fmt = "%f";
+    }
+    else if (st == FLOAT64)
+    {
+        data_width = 8;
+        datatype = 0;
+        fmt = "%lf";
+    }
+    else if (st == BYTEARRAY)
+    {
+        data_width = argc - 3;
+        datatype = 1;
+    }
+    else if (st == STRING)
+    {
+        /* locate the string parameter, say locate the beginning of the 4th parameter (2 characters after the end of the 3rd paramter)*/
+        int i;
+        string_parameter = vars->current_cmdline;
+        for(i = 0; i < 3; ++i)
+        {
+            while(isspace(*string_parameter))
+                ++ string_parameter;
+            while(!isspace(*string_parameter))
+                ++ string_parameter;
+        }
+        ++ string_parameter;
+        data_width = strlen(string_parameter);
+        datatype = 2;
+    }
+    /* may support more types here */
+    else
+    {
+        show_error("bad data_type, see `help write`.\n");
+        ret = false;
+        goto retl;
+    }
+
+    /* check argc again */
+    if ((datatype == 0) && (argc != 4))
+    {
+        show_error("bad arguments, see `help write`.\n");
+        ret = false;
+        goto retl;
+    }
+
+    /* check address */
+    errno = 0;
+    addr = (void *)strtoll(argv[2], &endptr, 16);
+    if ((errno != 0) || (*endptr != '\0'))
+    {
+        show_error("bad address, see `help write`.\n");
+        ret = false;
+        goto retl;
+    }
+
+    buf = malloc(data_width + 8); /* allocate a little bit more, just in case */
+    if (buf == NULL)
+    {
+        show_error("memory allocation failed.\n");
+        ret = false;
+        goto retl;
+    }
+
+    /* load value into buffer */
+    switch(datatype)
+    {
+    case 0: // numbers
+        if(sscanf(argv[3], fmt, buf) < 1) /* should be OK even for max uint64 */
+        {
+            show_error("bad value, see `help write`.\n");
+            ret = false;
+            goto retl;
+        }
+        if (1 < data_width && vars->options.reverse_endianness) {
+            swap_bytes_var(buf, data_width);
+        }
+        break;
+    case 1: // bytearray
+        ; /* cheat gcc */
+        /* call parse_uservalue_bytearray */
+        uservalue_t val_buf;
+        if(!parse_uservalue_bytearray(argv+3, argc-3, &val_buf))
+        {
+            show_error("bad byte array specified.\n");
+            free_uservalue(&val_buf);
+            ret = false;
+            goto retl;
+        }
+        int i;
+
+        {
+            // if wildcard is provided in the bytearray, we need the original data.
+            bool wildcard_used = false;
+            for(i = 0; i < data_width; ++i)
+            {
+                if(val_buf.wildcard_value[i] == WILDCARD)
+                {
+                    wildcard_used = true;
+                    break;
+                }
+            }
+            if (wildcard_used)
+            {
+                if(!sm_read_array(&vars->reader, addr, buf, data_width))
+                {
+                    show_error("read memory failed.\n");
+                    free_uservalue(&val_buf);
+                    ret = false;
+                    goto retl;
+                }
+            }
+        }
+
+        for(i = 0; i < data_width; ++i)
+        {
+            if(val_buf.wildcard_value[i] == FIXED)
+            {
+                buf[i] = val_buf.bytearray_value[i];
+            }
+        }
+        free_uservalue(&val_buf);
+        break;
+    case 2: //string
+        strncpy(buf, string_parameter, data_width);
+        break;
+    default:
+        assert(false);
+    }
+
+    /* write into memory */
+    ret = sm_write_array(vars->target, addr, buf, data_width);
+
+retl:
+    if(buf)
+        free(buf);
+    return ret;
+}
+
+/* the flags of a number of type `st`, 0 if it is not a single number */
+static match_flags number_type_flags(scan_data_type_t st)
+{
+    switch (st) {
+    case INTEGER8:  return flags_i8b;
+    case INTEGER16: return flags_i16b;
+    case INTEGER32: return flags_i32b;
+    case INTEGER64: return flags_i64b;
+    case FLOAT32:   return flag_f32b;
+    case FLOAT64:   return flag_f64b;
+    default:        return flags_empty;
+    }
+}
+
+static bool freeze_value(globals_t *vars, uintptr_t address, value_t *v, uint64_t interval_ns)
+{
+    char buf[128];
+    long id;
+
+    valtostr(v, buf, sizeof(buf));
+    fix_endianness(v, vars->options.reverse_endianness);
+    if ((id = sm_freezer_add(vars->freezer, address, v->bytes, flags_width(v->flags),
+                             v->flags, interval_ns)) == -1) {
+        show_error("failed to freeze %10p.\n", (void *) address);
+        return false;
+    }
+    show_info("[%2ld] freezing %10p at %s\n", id, (void *) address, buf);
+    return true;
+}
+
+/* freeze add <match-id set>=<n>[/interval] | <type> <address> <n>[/interval] */
+static bool freeze_add(globals_t *vars, char **argv, unsigned argc)
+{
+    double interval_ms = 100;
+    uint64_t interval_ns;
+    char *value, *slash;
+    uservalue_t userval;
+
+    if (argc == 1 && strchr(argv[0], '=') != NULL) {
+        value = strchr(argv[0], '=') + 1;
+    } else if (argc == 3) {
+        value = argv[2];
+    } else {
+        show_error("bad arguments, see `help freeze`.\n");
+        return false;
+    }
+
+    value = strdupa(value);
+    if ((slash = strchr(value, '/')) != NULL) {
+        char *end = NULL;
+
+        interval_ms = strtod(slash + 1, &end);
+        if (slash[1] == '\0' || *end != '\0' || !(interval_ms > 0)) {
+            show_error("bad interval `%s`, see `help freeze`.\n", slash + 1);
+            return false;
+        }
+        *slash = '\0';
+    }
+    if ((interval_ns = (uint64_t) (interval_ms * 1e6)) == 0)
+        interval_ns = 1;
+
+    if (!parse_uservalue_number(value, &userval)) {
+        show_error("bad number `%s` provided\n", value);
+        return false;
+    }
+
+    if (argc == 3) {
+        match_flags flags = number_type_flags(parse_scan_data_type(argv[0]));
+        char *end = NULL;
+        uintptr_t address;
+        value_t v;
+
+        if (flags == flags_empty) {
+            show_error("bad value_type `%s`, only numbers can be frozen.\n", argv[0]);
+            return false;
+        }
+        errno = 0;
+        address = strtoull(argv[1], &end, 0x10);
+        if (errno != 0 || argv[1][0] == '\0' || *end != '\0') {
+            show_error("bad address `%s`, see `help freeze`.\n", argv[1]);
+            return false;
+        }
+        if ((v.flags = flags & userval.flags) == flags_empty) {
+            show_error("`%s` is not a valid %s.\n", value, argv[0]);
+            return false;
+        }
+        uservalue2value(&v, &userval);
+        return freeze_value(vars, address, &v, interval_ns);
+    } else {
+        struct set match_set;
+        bool ret = true;
+
+        if ((vars->options.scan_data_type == BYTEARRAY) || (vars->options.scan_data_type == STRING)) {
+            show_error("`freeze` is not supported for bytearray or string matches.\n");
+            return false;
+        }
+        if (vars->num_matches == 0) {
+            show_error("no matches are known.\n");
+            return false;
+        }
+        if (!parse_uintset(strndupa(argv[0], strchr(argv[0], '=') - argv[0]), &match_set,
+                           vars->num_matches)) {
+            show_error("failed to parse the set, try `help freeze`.\n");
+            return false;
+        }
+
+        foreach_set_fw(i, &match_set) {
+            match_location loc = matches__nth_match(vars->matches, match_set.buf[i]);
+            value_t v;
+
+            if (loc.swath == NULL) {
+                show_error("BUG: freeze: id <%zu> match failure\n", match_set.buf[i]);
+                ret = false;
+                break;
+            }
+            v = data_to_val(loc.swath, loc.index);
+            if ((v.flags &= userval.flags) == flags_empty) {
+                show_error("`%s` does not fit match %zu.\n", value, match_set.buf[i]);
+                ret = false;
+                continue;
+            }
+            uservalue2value(&v, &userval);
+            ret = freeze_value(vars, (uintptr_t) swath__remote_address_of_nth_element(loc.swath,
+                               loc.index), &v, interval_ns) && ret;
+        }
+        set_cleanup(&match_set);
+        return ret;
+    }
+}
+
+static bool freeze_list(globals_t *vars)
+{
+    sm_freeze_entry_t *entries;
+    size_t count, i;
+
+    if (vars->freezer == NULL || (count = sm_freezer_list(vars->freezer, &entries)) == 0) {
+        show_info("nothing is frozen.\n");
+        return true;
+    }
+
+    for (i = 0; i < count; i++) {
+        char buf[128];
+        value_t v;
+
+        memset(&v, 0, sizeof(v));
+        memcpy(v.bytes, entries[i].data, entries[i].width);
+        v.flags = entries[i].flags;
+        fix_endianness(&v, vars->options.reverse_endianness);
+        valtostr(&v, buf, sizeof(buf));
+        show_user("[%2lu] %10p, %s, every %g ms, %lu writes, %lu failed\n", entries[i].id,
+                  (void *) entries[i].address, buf, entries[i].interval_ns / 1e6,
+                  entries[i].writes, entries[i].errors);
+    }
+    if (sm_freezer_failed(vars->freezer))
+        show_warn("the target is gone, nothing is written anymore.\n");
+
+    free(entries);
+    return true;
+}
+
+bool handler__freeze(globals_t *vars, char **argv, unsigned argc)
+{
+    const char *cmd = (argc > 1) ? argv[1] : "list";
+
+    if (strcmp(cmd, "list") == 0) {
+        return freeze_list(vars);
+    } else if (strcmp(cmd, "clear") == 0) {
+        sm_freezer_destroy(vars->freezer);
+        vars->freezer = NULL;
+        return true;
+    } else if (strcmp(cmd, "remove") == 0) {
+        struct set id_set;
+        bool ret = true;
+
+        if (argc != 3) {
+            show_error("expected a set of freeze-ids, see `help freeze`.\n");
+            return false;
+        }
+        if (vars->freezer == NULL || vars->freezer->next_id == 0) {
+            show_error("nothing is frozen.\n");
+            return false;
+        }
+        if (!parse_uintset(argv[2], &id_set, vars->freezer->next_id)) {
+            show_error("failed to parse the set, try `help freeze`.\n");
+            return false;
+        }
+        foreach_set_fw(i, &id_set) {
+            if (!sm_freezer_remove(vars->freezer, id_set.buf[i])) {
+                show_error("%zu is not frozen.\n", id_set.buf[i]);
+                ret = false;
+            }
+        }
+        set_cleanup(&id_set);
+        return ret;
+    } else if (strcmp(cmd, "add") == 0) {
+        if (vars->target == 0) {
+            show_error("no target has been specified, see `help pid`.\n");
+            return false;
+        }
+        if (vars->freezer == NULL && (vars->freezer = sm_freezer_create(vars->target)) == NULL)
+            return false;
+        return freeze_add(vars, argv + 2, argc - 2);
+    }
+
+    show_error("unknown freeze command `%s`, see `help freeze`.\n", cmd);
+    return false;
+}
+
+/* record query <file> <n|?> [n|? ...] */
+static bool record_query(char **argv, unsigned argc)
+{
+    uservalue_t sequence[SM_RECORD_MAX_SEQUENCE];
+    sm_record_hit_t *hits;
+    ssize_t count, i;
+    unsigned j;
+
+    if (argc < 2 || argc - 1 > SM_RECORD_MAX_SEQUENCE) {
+        show_error("expected a recording and up to %d values, see `help record`.\n",
+                   SM_RECORD_MAX_SEQUENCE);
+        return false;
+    }
+    for (j = 1; j < argc; j++) {
+        zero_uservalue(&sequence[j - 1]);
+        if (strcmp(argv[j], "?") != 0 && !parse_uservalue_number(argv[j], &sequence[j - 1])) {
+            show_error("bad number `%s` provided\n", argv[j]);
+            return false;
+        }
+    }
+
+    if ((count = sm_record_query(argv[0], sequence, argc - 1, &hits)) < 0)
+        return false;
+
+    for (i = 0; i < count; i++) {
+        char buf[128];
+
+        valtostr(&hits[i].value, buf, sizeof(buf));
+        show_user("%10p, generation %lu, %s\n", (void *) hits[i].address, hits[i].generation, buf);
+    }
+    show_info("%zd addresses went through the sequence.\n", count);
+
+    free(hits);
+    return true;
+}
+
+bool handler__record(globals_t *vars, char **argv, unsigned argc)
+{
+    const char *cmd = (argc > 1) ? argv[1] : "status";
+
+    if (strcmp(cmd, "status") == 0) {
+        if (vars->recorder == NULL) {
+            show_info("not recording.\n");
+        } else {
+            show_info("recording to `%s`, %lu scans, %llu matches in %llu bytes.\n",
+                      vars->recorder->path, vars->recorder->generations,
+                      vars->recorder->matches, vars->recorder->size);
+        }
+        return true;
+    } else if (strcmp(cmd, "start") == 0) {
+        if (argc != 3) {
+            show_error("expected a file name, see `help record`.\n");
+            return false;
+        }
+        sm_recorder_close(vars->recorder);
+        vars->recorder = sm_recorder_open(argv[2]);
+        return vars->recorder != NULL;
+    } else if (strcmp(cmd, "stop") == 0) {
+        sm_recorder_close(vars->recorder);
+        vars->recorder = NULL;
+        return true;
+    } else if (strcmp(cmd, "query") == 0) {
+        return record_query(argv + 2, argc - 2);
+    }
+
+    show_error("unknown record command `%s`, see `help record`.\n", cmd);
+    return false;
+}
+
+/* the most chains a pointer scan keeps */
+#define PTRSCAN_MAX_CHAINS 100000
+
+static void list_ptrchains(const globals_t *vars, unsigned long max_to_print)
+{
+    const sm_ptrscan_t *ptrscan = vars->ptrscan;
+    char chain[256];
+    size_t i;
+
+    if (ptrscan == NULL || ptrscan->num_chains == 0) {
+        show_info("no pointer chains are known.\n");
+        return;
+    }
+
+    for (i = 0; i < ptrscan->num_chains && i < max_to_print; i++) {
+        sm_ptrchain_format(ptrscan->regions ? ptrscan->regions : vars->regions,
+                           &ptrscan->chains[i], chain, sizeof(chain));
+        printf("[%2zu] %s\n", i, chain);
+    }
+    if (ptrscan->num_chains > max_to_print && !vars->options.backend)
+        printf("[...]\n");
+    fflush(stdout);
+}
+
+/* the address of a match, or `@address` */
+static bool parse_location(globals_t *vars, const char *arg, uintptr_t *address)
+{
+    char *end = NULL;
+    unsigned long id;
+    match_location loc;
+
+    if (arg[0] == '@') {
+        *address = strtoul(arg + 1, &end, 0x10);
+        if (arg[1] == '\0' || *end != '\0') {
+            show_error("sorry, couldn't parse the address `%s`.\n", arg);
+            return false;
+        }
+        return true;
+    }
+
+    id = strtoul(arg, &end, 0x00);
+    if (arg[0] == '\0' || *end != '\0') {
+        show_error("`%s` is neither a match id nor an @address.\n", arg);
+        return false;
+    }
+    if (id >= vars->num_matches) {
+        show_error("there is no match %lu, see `list`.\n", id);
+        return false;
+    }
+    loc = matches__nth_match(vars->matches, id);
+    if (loc.swath == NULL) {
+        show_error("there is no match %lu, see `list`.\n", id);
+        return false;
+    }
+    *address = swath__remote_address_of_nth_element(loc.swath, loc.index);
+    return true;
+}
+
+/* the chains of the session become `chains`, found in `map` of `regions` */
+static bool set_ptrchains(globals_t *vars, sm_ptrmap_t *map, region_table_t *regions,
+                          uintptr_t target, sm_ptrchain_t *chains, size_t count)
 {
-    int data_width = 0;
-    const char *fmt = NULL;
-    void *addr;
-    char *buf = NULL;
-    char *endptr;
-    int datatype; /* 0 for numbers, 1 for bytearray, 2 for string */
-    bool ret;
-    const char *string_parameter = NULL; /* used by string type */
+    sm_ptrscan_t *ptrscan;
 
-    if (argc < 4)
-    {
-        show_error("bad arguments, see `help write`.\n");
-        ret = false;
-        goto retl;
+    if ((ptrscan = calloc(1, sizeof(sm_ptrscan_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        sm_ptrmap_destroy(map);
+        rt_destroy(regions);
+        free(chains);
+        return false;
     }
+    ptrscan->map = map;
+    ptrscan->regions = regions;
+    ptrscan->target = target;
+    ptrscan->chains = chains;
+    ptrscan->num_chains = count;
+    sm_ptrscan_destroy(vars->ptrscan);
+    vars->ptrscan = ptrscan;
+    return true;
+}
 
-    scan_data_type_t st = parse_scan_data_type(argv[1]);
+/* Search for the chains to the address of argv[0], with the depth and
+ * offset of argv[1] and argv[2], in the map file `path` or, without it,
+ * in a map of the target. */
+static bool ptrscan_search(globals_t *vars, const char *path, char **argv, unsigned argc)
+{
+    unsigned long depth = 3, max_offset = 0x1000;
+    region_table_t *regions = NULL;
+    sm_ptrmap_t *map = NULL;
+    sm_ptrchain_t *chains = NULL;
+    ssize_t count = -1;
+    uintptr_t target;
+    char *end = NULL;
 
-    /* try int first */
-    if (st == INTEGER8)
-    {
-        data_width = 1;
-        datatype = 0;
-        fmt = "%"PRId8;
-    }
-    else if (st == INTEGER16)
-    {
-        data_width = 2;
-        datatype = 0;
-        fmt = "%"PRId16;
-    }
-    else if (st == INTEGER32)
-    {
-        data_width = 4;
-        datatype = 0;
-        fmt = "%"PRId32;
-    }
-    else if (st == INTEGER64)
-    {
-        data_width = 8;
-        datatype = 0;
-        fmt = "%"PRId64;
+    if (argc > 3) {
+        show_error("too many arguments, see `help ptrscan`.\n");
+        return false;
     }
-    else if (st == FLOAT32)
-    {
-        data_width = 4;
-        datatype = 0;
-        fmt = "%f";
+    if (path == NULL && !has_target(vars)) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
     }
-    else if (st == FLOAT64)
-    {
-        data_width = 8;
-        datatype = 0;
-        fmt = "%lf";
+    if (!parse_location(vars, argv[0], &target))
+        return false;
+    if (argc > 1) {
+        depth = strtoul(argv[1], &end, 0x00);
+        if (*end != '\0' || depth == 0 || depth > SM_PTR_MAX_DEPTH) {
+            show_error("the depth must be 1 to %d.\n", SM_PTR_MAX_DEPTH);
+            return false;
+        }
     }
-    else if (st == BYTEARRAY)
-    {
-        data_width = argc - 3;
-        datatype = 1;
+    if (argc > 2) {
+        max_offset = strtoul(argv[2], &end, 0x00);
+        if (*end != '\0') {
+            show_error("bad offset `%s`, see `help ptrscan`.\n", argv[2]);
+            return false;
+        }
     }
-    else if (st == STRING)
-    {
-        /* locate the string parameter, say locate the beginning of the 4th parameter (2 characters after the end of the 3rd paramter)*/
-        int i;
-        string_parameter = vars->current_cmdline;
-        for(i = 0; i < 3; ++i)
-        {
-            while(isspace(*string_parameter))
-                ++ string_parameter;
-            while(!isspace(*string_parameter))
-                ++ string_parameter;
+
+    if (path) {
+        if ((regions = rt_init()) == NULL) {
+            show_error("sorry, there was a memory allocation error.\n");
+            return false;
+        }
+        if ((map = sm_ptrmap_load(path, regions)) == NULL) {
+            rt_destroy(regions);
+            return false;
         }
-        ++ string_parameter;
-        data_width = strlen(string_parameter);
-        datatype = 2;
     }
-    /* may support more types here */
-    else
-    {
-        show_error("bad data_type, see `help write`.\n");
-        ret = false;
-        goto retl;
+
+    vars->stop_flag = false;
+    INTERRUPTABLESCAN();
+    if (map != NULL || (map = sm_ptrmap_build(vars)) != NULL) {
+        show_info("%zu pointers in %zu regions, searching...\n", map->count,
+                  (regions ? regions : vars->regions)->size);
+        count = sm_ptrscan(map, regions ? regions : vars->regions, target, depth, max_offset,
+                           PTRSCAN_MAX_CHAINS, &vars->stop_flag, &chains);
     }
+    ENDINTERRUPTABLE();
 
-    /* check argc again */
-    if ((datatype == 0) && (argc != 4))
-    {
-        show_error("bad arguments, see `help write`.\n");
-        ret = false;
-        goto retl;
+    if (count < 0) {
+        sm_ptrmap_destroy(map);
+        rt_destroy(regions);
+        return false;
     }
+    if (!set_ptrchains(vars, map, regions, target, chains, count))
+        return false;
 
-    /* check address */
-    errno = 0;
-    addr = (void *)strtoll(argv[2], &endptr, 16);
-    if ((errno != 0) || (*endptr != '\0'))
-    {
-        show_error("bad address, see `help write`.\n");
-        ret = false;
-        goto retl;
+    if (vars->stop_flag)
+        show_warn("interrupted, there may be more chains.\n");
+    else if (count == PTRSCAN_MAX_CHAINS)
+        show_warn("stopped at %d chains, try a smaller depth or offset.\n", PTRSCAN_MAX_CHAINS);
+    show_info("%zd chains lead to %lx.\n", count, (unsigned long) target);
+    list_ptrchains(vars, 20);
+    return true;
+}
+
+/* keep the chains of the session which lead to the value of argv[0] */
+static bool ptrscan_check(globals_t *vars, char **argv, unsigned argc)
+{
+    sm_ptrscan_t *ptrscan = vars->ptrscan;
+    uservalue_t value;
+    char chain[256];
+    size_t before, n = 0, i;
+    ssize_t count;
+
+    if (argc != 1) {
+        show_error("`check` needs the value the chains lead to, see `help ptrscan`.\n");
+        return false;
+    }
+    if (!has_target(vars)) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+    if (ptrscan == NULL || ptrscan->num_chains == 0) {
+        show_error("no pointer chains are known, see `help ptrscan`.\n");
+        return false;
     }
+    if (!parse_uservalue_number(argv[0], &value)) {
+        show_error("bad value `%s`, see `help ptrscan`.\n", argv[0]);
+        return false;
+    }
+    before = ptrscan->num_chains;
 
-    buf = malloc(data_width + 8); /* allocate a little bit more, just in case */
-    if (buf == NULL)
-    {
-        show_error("memory allocation failed.\n");
-        ret = false;
-        goto retl;
+    /* chains found in a map file start from the modules of the target now */
+    if (ptrscan->regions) {
+        for (i = 0; i < ptrscan->num_chains; i++) {
+            sm_ptrchain_format(ptrscan->regions, &ptrscan->chains[i], chain, sizeof(chain));
+            if (sm_ptrchain_parse(vars->regions, chain, &ptrscan->chains[n]))
+                n++;
+        }
+        sm_ptrmap_destroy(ptrscan->map);
+        rt_destroy(ptrscan->regions);
+        ptrscan->map = NULL;
+        ptrscan->regions = NULL;
+        ptrscan->num_chains = n;
     }
 
-    /* load value into buffer */
-    switch(datatype)
-    {
-    case 0: // numbers
-        if(sscanf(argv[3], fmt, buf) < 1) /* should be OK even for max uint64 */
-        {
-            show_error("bad value, see `help write`.\n");
-            ret = false;
-            goto retl;
+    if ((count = sm_ptrchains_check(vars, ptrscan->chains, ptrscan->num_chains, &value)) < 0)
+        return false;
+    ptrscan->num_chains = count;
+    show_info("%zd of %zu chains lead to %s.\n", count, before, argv[0]);
+    list_ptrchains(vars, 20);
+    return true;
+}
+
+bool handler__ptrscan(globals_t *vars, char **argv, unsigned argc)
+{
+    const char *cmd = (argc > 1) ? argv[1] : "list";
+    const sm_ptrscan_t *ptrscan = vars->ptrscan;
+    char *end = NULL;
+
+    if (strcmp(cmd, "list") == 0) {
+        unsigned long max_to_print = 20;
+
+        if (argc > 2 && (max_to_print = strtoul(argv[2], &end, 0x00)) == 0) {
+            show_error("`%s` is not a valid positive integer.\n", argv[2]);
+            return false;
         }
-        if (1 < data_width && vars->options.reverse_endianness) {
-            swap_bytes_var(buf, data_width);
+        list_ptrchains(vars, max_to_print);
+        return true;
+    } else if (strcmp(cmd, "check") == 0) {
+        return ptrscan_check(vars, argv + 2, argc - 2);
+    } else if (strcmp(cmd, "map") == 0) {
+        if (argc < 4) {
+            show_error("`map` needs a file and an @address, see `help ptrscan`.\n");
+            return false;
         }
-        break;
-    case 1: // bytearray
-        ; /* cheat gcc */
-        /* call parse_uservalue_bytearray */
-        uservalue_t val_buf;
-        if(!parse_uservalue_bytearray(argv+3, argc-3, &val_buf))
-        {
-            show_error("bad byte array specified.\n");
-            free_uservalue(&val_buf);
-            ret = false;
-            goto retl;
+        return ptrscan_search(vars, argv[2], argv + 3, argc - 3);
+    } else if (strcmp(cmd, "save") == 0 || strcmp(cmd, "load") == 0 ||
+               strcmp(cmd, "savemap") == 0) {
+        if (argc != 3) {
+            show_error("`%s` needs a file, see `help ptrscan`.\n", cmd);
+            return false;
         }
-        int i;
+    } else {
+        return ptrscan_search(vars, NULL, argv + 1, argc - 1);
+    }
 
-        {
-            // if wildcard is provided in the bytearray, we need the original data.
-            bool wildcard_used = false;
-            for(i = 0; i < data_width; ++i)
-            {
-                if(val_buf.wildcard_value[i] == WILDCARD)
-                {
-                    wildcard_used = true;
-                    break;
-                }
-            }
-            if (wildcard_used)
-            {
-                if(!sm_read_array(vars->target, addr, buf, data_width))
-                {
-                    show_error("read memory failed.\n");
-                    free_uservalue(&val_buf);
-                    ret = false;
-                    goto retl;
-                }
-            }
-        }
+    if (strcmp(cmd, "load") == 0) {
+        sm_ptrchain_t *chains;
+        ssize_t count;
 
-        for(i = 0; i < data_width; ++i)
-        {
-            if(val_buf.wildcard_value[i] == FIXED)
-            {
-                buf[i] = val_buf.bytearray_value[i];
-            }
+        if (!has_target(vars)) {
+            show_error("no target has been specified, see `help pid`.\n");
+            return false;
         }
-        free_uservalue(&val_buf);
-        break;
-    case 2: //string
-        strncpy(buf, string_parameter, data_width);
-        break;
-    default:
-        assert(false);
+        if ((count = sm_ptrchains_load(vars->regions, argv[2], &chains)) < 0 ||
+            !set_ptrchains(vars, NULL, NULL, 0, chains, count))
+            return false;
+        show_info("loaded %zd chains.\n", count);
+        return true;
+    } else if (strcmp(cmd, "save") == 0) {
+        if (ptrscan == NULL || ptrscan->num_chains == 0) {
+            show_error("no pointer chains are known, see `help ptrscan`.\n");
+            return false;
+        }
+        return sm_ptrchains_save(ptrscan->regions ? ptrscan->regions : vars->regions,
+                                 ptrscan->chains, ptrscan->num_chains, argv[2]);
     }
 
-    /* write into memory */
-    ret = sm_write_array(vars->target, addr, buf, data_width);
-
-retl:
-    if(buf)
-        free(buf);
-    return ret;
+    /* savemap */
+    if (ptrscan == NULL || ptrscan->map == NULL) {
+        show_error("there is no map of pointers, search for chains first.\n");
+        return false;
+    }
+    if (!sm_ptrmap_save(ptrscan->map, ptrscan->regions ? ptrscan->regions : vars->regions, argv[2]))
+        return false;
+    show_info("saved %zu pointers to `%s`.\n", ptrscan->map->count, argv[2]);
+    return true;
 }
 
 bool handler__option(globals_t * vars, char **argv, unsigned argc)
@@ -1664,6 +2829,71 @@ bool handler__option(globals_t * vars, char **argv, unsigned argc)
             return false;
         }
     }
+    else if (strcasecmp(argv[1], "stop_all_threads") == 0)
+    {
+        if (strcmp(argv[2], "0") == 0) {vars->options.stop_all_threads = 0; }
+        else if (strcmp(argv[2], "1") == 0) {vars->options.stop_all_threads = 1; }
+        else
+        {
+            show_error("bad value for stop_all_threads, see `help option`.\n");
+            return false;
+        }
+    }
+    else if (strcasecmp(argv[1], "stop_copy") == 0)
+    {
+        if (strcmp(argv[2], "0") == 0) {vars->options.stop_copy = 0; }
+        else if (strcmp(argv[2], "1") == 0) {vars->options.stop_copy = 1; }
+        else
+        {
+            show_error("bad value for stop_copy, see `help option`.\n");
+            return false;
+        }
+    }
+    else if (strcasecmp(argv[1], "min_rss") == 0)
+    {
+        char *end;
+        unsigned long kb = strtoul(argv[2], &end, 0);
+
+        if (*argv[2] == '\0' || *argv[2] == '-' || *end != '\0')
+        {
+            show_error("bad value for min_rss, see `help option`.\n");
+            return false;
+        }
+        vars->options.min_rss = kb * 1024;
+    }
+    else if (strcasecmp(argv[1], "early_stop") == 0)
+    {
+        char *end;
+        unsigned long count = strtoul(argv[2], &end, 0);
+
+        if (*argv[2] == '\0' || *argv[2] == '-' || *end != '\0')
+        {
+            show_error("bad value for early_stop, see `help option`.\n");
+            return false;
+        }
+        vars->options.early_stop = count;
+    }
+    else if (strcasecmp(argv[1], "skip_clean_files") == 0)
+    {
+        if (strcmp(argv[2], "0") == 0) {vars->options.skip_clean_files = 0; }
+        else if (strcmp(argv[2], "1") == 0) {vars->options.skip_clean_files = 1; }
+        else
+        {
+            show_error("bad value for skip_clean_files, see `help option`.\n");
+            return false;
+        }
+    }
+    else if (strcasecmp(argv[1], "scan_order") == 0)
+    {
+        if (strcmp(argv[2], "0") == 0) {vars->options.scan_order = SCAN_ORDER_ADDRESS; }
+        else if (strcmp(argv[2], "1") == 0) {vars->options.scan_order = SCAN_ORDER_DENSITY; }
+        else if (strcmp(argv[2], "2") == 0) {vars->options.scan_order = SCAN_ORDER_PRIORITY; }
+        else
+        {
+            show_error("bad value for scan_order, see `help option`.\n");
+            return false;
+        }
+    }
     else
     {
         show_error("unknown option specified, see `help option`.\n");
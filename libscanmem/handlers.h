@@ -66,7 +66,8 @@
                "the set data-type.\n" \
                "To set a value continually, for example to prevent a counter from decreasing,\n" \
                "suffix the command with '/', followed by the number of seconds to wait between\n" \
-               "sets. Interrupt scanmem with ^C to stop the setting.\n\n" \
+               "sets. Interrupt scanmem with ^C to stop the setting. `freeze` does the same\n" \
+               "in the background, leaving the prompt free.\n\n" \
                "Note that this command cannot work for bytearray or string.\n\n" \
                SET_FORMAT_DOC \
                "Examples:\n" \
@@ -121,14 +122,130 @@ bool handler__delete(globals_t *vars, char **argv, unsigned argc);
 
 bool handler__reset(globals_t *vars, char **argv, unsigned argc);
 
+#define REFRESH_SHRTDOC "reread regions, keeping the matches"
+#define REFRESH_LONGDOC "usage: refresh\n" \
+                "Reread regions from the relevant maps file, like `reset`, but only forget\n" \
+                "what is not mapped anymore. Regions still mapped the same way keep their\n" \
+                "id and their matches, the matches within address ranges which are gone\n" \
+                "are deleted. Regions mapped since the last scan are new, they get new ids\n" \
+                "and the next scan for a value (like `42` or `> 42`) searches them and\n" \
+                "adds their matches to the others.\n"
+
+bool handler__refresh(globals_t *vars, char **argv, unsigned argc);
+
 #define PID_SHRTDOC "print current pid, or attach to a new process"
 #define PID_LONGDOC "usage: pid [pid]\n" \
                 "If `pid` is specified, reset current session and then attach to new\n" \
                 "process `pid`. If `pid` is not specified, print information about\n" \
-                "current process."
+                "current process, or the image scanned instead, see `loadcore`."
 
 bool handler__pid(globals_t *vars, char **argv, unsigned argc);
 
+#define FREEZE_COMPLETE "list,add,remove,clear"
+#define FREEZE_SHRTDOC "keep values in place in the background"
+#define FREEZE_LONGDOC "usage: freeze [list]\n" \
+                "       freeze add <match-id set>=<n>[/interval]\n" \
+                "       freeze add <value_type> <address> <n>[/interval]\n" \
+                "       freeze remove <freeze-id set> | freeze clear\n" \
+                "Write numbers to the target over and over, for example to keep a counter from\n" \
+                "decreasing. A thread does the writing while the prompt stays usable, all the\n" \
+                "values due at the same time being written together.\n\n" \
+                "`add` freezes the matches in <match-id set> at `n`, or `n` at <address>,\n" \
+                "taken as hexadecimal, as a <value_type> like those of `write`; only numbers\n" \
+                "can be frozen. The value is written every `interval` milliseconds, 100 by\n" \
+                "default. Every frozen value gets a freeze-id, shown by `list` along with how\n" \
+                "often it was written. `remove` stops writing the values in <freeze-id set>,\n" \
+                "`clear` all of them. Changing the target with `pid` clears them as well.\n\n" \
+                "Examples:\n" \
+                "\tfreeze add 0,3=100 - keep matches 0 and 3 at 100\n" \
+                "\tfreeze add i32 60103e 9999/10 - write 9999 to 60103e every 10 ms\n" \
+                "\tfreeze remove 1\n"
+
+bool handler__freeze(globals_t *vars, char **argv, unsigned argc);
+
+#define RECORD_COMPLETE "status,start,stop,query"
+#define RECORD_SHRTDOC "record the matches of every scan to a file"
+#define RECORD_LONGDOC "usage: record [status] | record start <file> | record stop\n" \
+                "       record query <file> <n|?> [n|? ...]\n" \
+                "`start` creates <file> and, until `stop`, appends the addresses and values\n" \
+                "of all matches to it after every scan, so that how they changed from one scan\n" \
+                "to the next can be looked at later. Snapshots and scans for a bytearray or a\n" \
+                "string are left out.\n\n" \
+                "`query` reads a recording, which needs neither a target nor the recording\n" \
+                "to be finished, and prints the addresses which took the values given one\n" \
+                "after the other, in consecutive scans where they changed; a value kept by\n" \
+                "the scans that follow counts once, and `?` stands for any value.\n\n" \
+                "Example:\n" \
+                "\trecord start /tmp/hp.rec\n" \
+                "\t(scan for `-` a few times as a value goes down)\n" \
+                "\trecord query /tmp/hp.rec 100 95 90\n"
+
+bool handler__record(globals_t *vars, char **argv, unsigned argc);
+
+#define PTRSCAN_COMPLETE "list,save,load,check,savemap,map"
+#define PTRSCAN_SHRTDOC "find chains of pointers leading to an address"
+#define PTRSCAN_LONGDOC "usage: ptrscan [list [max]]\n" \
+                "       ptrscan <match-id | @address> [depth] [max_offset]\n" \
+                "       ptrscan save <file> | ptrscan load <file> | ptrscan check <value>\n" \
+                "       ptrscan savemap <file> | ptrscan map <file> <@address> [depth] [max_offset]\n" \
+                "Find how the program gets to a match, or to <address>: the chains of up to\n" \
+                "[depth] pointers (default 3, at most 8) starting from a variable of the\n" \
+                "executable or a library, with up to [max_offset] (default 0x1000) added to\n" \
+                "or taken from each pointer. Unlike the address, these chains stay the same\n" \
+                "each time the program runs. Every aligned word of the regions is read, with\n" \
+                "the target stopped, then the chains are searched by a thread per processor;\n" \
+                "interrupt with ^C to stop early.\n\n" \
+                "A chain is printed as `module+offset -> +o1 -> +o2`: the pointer at\n" \
+                "<offset> from the load address of <module> is read, o1 added, the pointer\n" \
+                "there read, and o2 added to get to the address. `list` prints up to [max]\n" \
+                "(default 20) chains of the last scan, the shortest first.\n\n" \
+                "`save` writes the chains to <file>, one per line, and `load` reads them back\n" \
+                "for the modules of the target, also after it was started again. `check`\n" \
+                "follows every chain, with the target stopped once and the pointers of all\n" \
+                "chains read together, and keeps those which lead to <value>, of the\n" \
+                "scan_data_type. Checking the chains each time the program runs leaves those\n" \
+                "which always work, without searching again.\n\n" \
+                "`savemap` writes the pointers read by the last scan to <file>, each as an\n" \
+                "offset from the load address of its region, and `map` searches such a file\n" \
+                "for the chains to <address> as it was then, which needs no target.\n\n" \
+                "Example:\n" \
+                "\tptrscan 0\n" \
+                "\tptrscan @5632d59ab020 4 0x800\n" \
+                "\tptrscan save /tmp/hp.chains\n" \
+                "\t(start the program again, find the value and attach to it)\n" \
+                "\tptrscan load /tmp/hp.chains\n" \
+                "\tptrscan check 100\n"
+
+bool handler__ptrscan(globals_t *vars, char **argv, unsigned argc);
+
+#define GROUP_COMPLETE "list,add,name,core,remove,clear,reset,snapshot,scan,common"
+#define GROUP_SHRTDOC "scan several processes at once"
+#define GROUP_LONGDOC "usage: group [list]\n" \
+                "       group add <pid> [pid...] | group name <executable>\n" \
+                "       group core <filename> [filename...]\n" \
+                "       group remove <pid> | group clear | group reset\n" \
+                "       group snapshot | group scan <value> | group scan <op> [value]\n" \
+                "       group common [max]\n" \
+                "Manage a group of processes, usually instances of the same program, which\n" \
+                "are scanned together. Every process of the group has its own regions and\n" \
+                "matches, separate from the session of `pid`.\n\n" \
+                "`add` adds processes by pid, `name` adds every process whose executable is\n" \
+                "called <executable>. `core` adds images saved by `savecore`, known by the pid\n" \
+                "they were saved from. `reset` drops all matches and reads the regions again.\n" \
+                "`snapshot` and `scan` work like the commands of the same name, each process\n" \
+                "being scanned by a thread of its own; <value> may be a number or a range\n" \
+                "and <op> one of `=`, `!=`, `<`, `>`, `+` and `-`. Only numbers are supported.\n\n" \
+                "`common` keeps the matches whose position (region id + offset, as printed\n" \
+                "by `list`) is matched in every process of the group, and prints up to [max]\n" \
+                "of these positions (default 20).\n\n" \
+                "Example:\n" \
+                "\tgroup name server\n" \
+                "\tgroup scan 100\n" \
+                "\tgroup scan <\n" \
+                "\tgroup common\n"
+
+bool handler__group(globals_t *vars, char **argv, unsigned argc);
+
 #define SNAPSHOT_SHRTDOC "take a snapshot of the current process state"
 #define SNAPSHOT_LONGDOC "usage: snapshot\n" \
                 "Take a snapshot of the entire process in its current state. This is useful\n" \
@@ -261,6 +378,33 @@ bool handler__default(globals_t *vars, char **argv, unsigned argc);
 
 bool handler__string(globals_t *vars, char **argv, unsigned argc);
 
+#define STRUCT_SHRTDOC "match several fields of a structure at once"
+#define STRUCT_LONGDOC "usage: struct <type>@<offset> <comparison> [, ...]\n" \
+                "Search for a structure of which several fields are known, in one pass.\n" \
+                "Each field is a type among i8, i16, i32, i64, f32 and f64, its offset from\n" \
+                "the start of the structure, then one of `= n`, `!= n`, `> n`, `< n`,\n" \
+                "`in n..m` or `any`. Every place where all the fields match is a match, at\n" \
+                "the address of the first field given, with its type: `list` shows it and\n" \
+                "the other scans narrow it down as usual. The most selective field is\n" \
+                "checked first and the others only where it matches. With matches already\n" \
+                "known, only those still starting a matching structure are kept.\n" \
+                "Example:\n" \
+                "\tstruct i64@0 = 55, i64@8 in -100..100, f64@16 any\n"
+
+bool handler__struct(globals_t *vars, char **argv, unsigned argc);
+
+#define NEAR_SHRTDOC "match two values found close to each other"
+#define NEAR_LONGDOC "usage: near <a> <b> [window]\n" \
+                "Search for places holding <a> with <b> at most [window] bytes before or\n" \
+                "after, 64 by default and up to 4096, in one pass. Both values are numbers\n" \
+                "or ranges such as 1..10 of the current scan_data_type, and both places of\n" \
+                "each pair found are matches. With matches already known, only those still\n" \
+                "holding one value with the other near them are kept.\n" \
+                "Example:\n" \
+                "\tnear 100 1..5 32\n"
+
+bool handler__near(globals_t *vars, char **argv, unsigned argc);
+
 #define UPDATE_SHRTDOC "update match values without culling list"
 #define UPDATE_LONGDOC "usage: update\n" \
                 "Scans the current process, getting the current values of all matches.\n" \
@@ -284,12 +428,21 @@ bool handler__eof(globals_t *vars, char **argv, unsigned argc);
 bool handler__shell(globals_t *vars, char **argv, unsigned argc);
 
 #define WATCH_SHRTDOC "monitor the value of a memory location as it changes"
-#define WATCH_LONGDOC "usage: watch [match-id]\n" \
-                "Monitors the match `match-id`, by testing its value every second. When the\n" \
-                "value changes, its new value is printed along with an timestamp. Interrupt\n" \
-                "with ^C to stop monitoring.\n" \
+#define WATCH_LONGDOC "usage: watch <match-id set | @address[:width]> [...][/interval]\n" \
+                "Monitors matches and memory locations, by reading all of them every\n" \
+                "`interval` milliseconds (1000 by default, fractions like 0.5 work too).\n" \
+                "Locations are given as a set of match-ids, or as a hexadecimal address\n" \
+                "with `@` in front, optionally followed by the number of bytes to read (1,\n" \
+                "2, 4 or 8, 4 by default). The target keeps running, its memory is read\n" \
+                "with as few system calls as possible from a thread of its own.\n" \
+                "Every change is printed along with a timestamp. Interrupt with ^C to stop\n" \
+                "monitoring, the number of changes of every location and how far apart\n" \
+                "they were is printed then.\n" \
                 "Examples:\n" \
-                "\twatch 12 - watch match 12 for any changes.\n"
+                "\twatch 12 - watch match 12 for any changes, every second.\n" \
+                "\twatch ..300/5 - watch matches 0 through 300 every 5 ms.\n" \
+                "\twatch 3,7 @7ffd12345678:8/0.5 - watch two matches and 8 bytes at an\n" \
+                "\t                               address every 500 microseconds.\n"
 
 bool handler__watch(globals_t *vars, char **argv, unsigned argc);
 
@@ -306,10 +459,47 @@ bool handler__show(globals_t *vars, char **argv, unsigned argc);
 #define DUMP_LONGDOC "usage: dump <address> <length> [<filename>]\n" \
                 "\n" \
                 "If <filename> is given, save the region of memory to the file \n" \
-                "Otherwise display it in a human-readable format.\n"
+                "Otherwise display it in a human-readable format.\n" \
+                "Files are written as the memory is read, a megabyte at a time, so any\n" \
+                "length works; interrupt with ^C to stop early. Where the memory cannot be\n" \
+                "read the file has zeros, and these ranges are listed in <filename>.holes.\n"
     
 bool handler__dump(globals_t *vars, char **argv, unsigned argc);
 
+/* the longest span `readmany` takes */
+#define READMANY_MAX_LENGTH (1 << 20)
+
+#define READMANY_SHRTDOC "read many small areas of memory at once"
+#define READMANY_LONGDOC "usage: readmany <address>:<length> [<address>:<length> ...]\n" \
+                "Read every area, the addresses in hex, with the target stopped once and\n" \
+                "areas close to each other read together, which is much cheaper than as\n" \
+                "many `dump` commands. Each area is shown on a line, or as unreadable.\n" \
+                "As a backend, the output is one byte per area, 1 if it could be read,\n" \
+                "then the bytes of all the areas one after the other, zeros if unreadable.\n" \
+                "Example:\n" \
+                "\treadmany 7ffd1c40:4 7ffd1c48:8 601040:2\n"
+
+bool handler__readmany(globals_t *vars, char **argv, unsigned argc);
+
+#define SAVECORE_SHRTDOC "save the regions of the target to an image"
+#define SAVECORE_LONGDOC "usage: savecore <filename>\n" \
+                "Save the contents of every region known, see `lregions`, to <filename>,\n" \
+                "with the target stopped once. The image also keeps the list of regions,\n" \
+                "so that it can be scanned like the target was, see `loadcore`. Pages of\n" \
+                "zeros take no room, what cannot be read is left out and noted as such.\n"
+
+bool handler__savecore(globals_t *vars, char **argv, unsigned argc);
+
+#define LOADCORE_SHRTDOC "scan an image saved by `savecore`"
+#define LOADCORE_LONGDOC "usage: loadcore <filename>\n" \
+                "Reset the session and scan the image <filename> instead of a process, with\n" \
+                "the regions it was saved with. What only reads memory works on an image,\n" \
+                "like scans, `update`, `dump` and `savecore`; `set`, `write`, `refresh`,\n" \
+                "`watch` and `freeze` need a process. `pid` goes back to one. To scan\n" \
+                "several images at once, see `group core`.\n"
+
+bool handler__loadcore(globals_t *vars, char **argv, unsigned argc);
+
 #define VALUE_TYPES "int8,int16,int32,int64,float32,float64,bytearray,string"
 #define WRITE_COMPLETE VALUE_TYPES
 #define WRITE_SHRTDOC "change the value of a specific memory location"
@@ -331,7 +521,8 @@ bool handler__dump(globals_t *vars, char **argv, unsigned argc);
 bool handler__write(globals_t *vars, char **argv, unsigned argc);
 
 #define OPTION_COMPLETE "scan_data_type{number,int,float," VALUE_TYPES \
-    "},region_scan_level{1,2,3},dump_with_ascii{0,1},endianness{0,1,2}"
+    "},region_scan_level{1,2,3},dump_with_ascii{0,1},endianness{0,1,2}," \
+    "stop_all_threads{0,1},stop_copy{0,1}"
 #define OPTION_SHRTDOC "set runtime options of scanmem, see `help option`"
 #define OPTION_LONGDOC "usage: option <option_name> <option_value>\n" \
                  "\n" \
@@ -373,6 +564,51 @@ bool handler__write(globals_t *vars, char **argv, unsigned argc);
                  "\t1:\tlittle endian\n" \
                  "\t2:\tbig endian\n" \
                  "\n" \
+                 "stop_all_threads\twhether to stop every thread of the target while\n" \
+                 "\t\t\taccessing it, not only the main thread (Linux only)\n" \
+                 "\t\t\tDefault:0\n" \
+                 "\n" \
+                 "\tpossible values:\n" \
+                 "\t0:\tstop the main thread only\n" \
+                 "\t1:\tstop all threads, reporting the time spent stopping them\n" \
+                 "\n" \
+                 "stop_copy\twhether the first scan (and `snapshot`) should copy all\n" \
+                 "\t\t\tregions while the target is stopped, resume it and scan\n" \
+                 "\t\t\tthe copy; needs as much memory as the regions\n" \
+                 "\t\t\tDefault:0\n" \
+                 "\n" \
+                 "\tpossible values:\n" \
+                 "\t0:\tkeep the target stopped during the whole scan\n" \
+                 "\t1:\tstop, copy and resume, reporting the pause time\n" \
+                 "\n" \
+                 "min_rss\t\tskip regions with less resident memory (in KiB) in first\n" \
+                 "\t\t\tscans, as read from /proc/pid/smaps\n" \
+                 "\t\t\tDefault:0 (scan all regions)\n" \
+                 "\n" \
+                 "skip_clean_files\twhether first scans should skip file-backed regions\n" \
+                 "\t\t\twithout modified pages, which only hold the file content\n" \
+                 "\t\t\tDefault:0\n" \
+                 "\n" \
+                 "\tpossible values:\n" \
+                 "\t0:\tscan them\n" \
+                 "\t1:\tskip them\n" \
+                 "\n" \
+                 "scan_order\tthe order in which first scans search the regions\n" \
+                 "\t\t\tDefault:0\n" \
+                 "\n" \
+                 "\tpossible values:\n" \
+                 "\t0:\tby address\n" \
+                 "\t1:\tthe most resident regions (relative to their size) first,\n" \
+                 "\t\tso that an interrupted scan has covered the used memory\n" \
+                 "\t2:\theap, data and bss of the executable, stack, then the\n" \
+                 "\t\trest, printing the matches of every region as it is done\n" \
+                 "\n" \
+                 "early_stop\tstop first scans after a region once they have found\n" \
+                 "\t\t\tbetween 1 and this many matches; the matches found so\n" \
+                 "\t\t\tfar can be listed and narrowed down as usual, and the\n" \
+                 "\t\t\tnext scan for a value searches the other regions too\n" \
+                 "\t\t\tDefault:0 (disabled)\n" \
+                 "\n" \
                  "Example:\n" \
                  "\toption scan_data_type int32\n"
 
@@ -0,0 +1,286 @@
+/*
+    Matching several values at known offsets from each other.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "endianness.h"
+#include "layout.h"
+#include "show_message.h"
+
+static const struct {
+    const char *name;
+    scan_data_type_t type;
+    size_t width;
+    match_flags flags;
+} field_types[] = {
+    { "i8",  INTEGER8,  1, flags_i8b },
+    { "i16", INTEGER16, 2, flags_i16b },
+    { "i32", INTEGER32, 4, flags_i32b },
+    { "i64", INTEGER64, 8, flags_i64b },
+    { "f32", FLOAT32,   4, flag_f32b },
+    { "f64", FLOAT64,   8, flag_f64b },
+};
+
+static const struct {
+    const char *name;
+    scan_match_type_t match;
+} field_matches[] = {
+    { "=",   MATCHEQUALTO },
+    { "==",  MATCHEQUALTO },
+    { "!=",  MATCHNOTEQUALTO },
+    { ">",   MATCHGREATERTHAN },
+    { "<",   MATCHLESSTHAN },
+    { "in",  MATCHRANGE },
+    { "any", MATCHANY },
+};
+
+static bool parse_value(const char *text, scan_data_type_t type, match_flags flags, uservalue_t *value)
+{
+    bool ok;
+
+    zero_uservalue(value);
+    if (type == FLOAT32 || type == FLOAT64)
+        ok = parse_uservalue_float(text, value);
+    else
+        ok = parse_uservalue_int(text, value);
+    if (!ok) {
+        show_error("unable to parse number `%s`\n", text);
+        return false;
+    }
+    value->flags &= flags;
+    if (value->flags == flags_empty) {
+        show_error("`%s` does not fit in the field.\n", text);
+        return false;
+    }
+    return true;
+}
+
+/* how few places a field is likely to match, from 0 for any */
+static unsigned selectivity(const sm_layout_field_t *field)
+{
+    switch (field->match) {
+    case MATCHEQUALTO:
+        /* memory is full of zeros */
+        if (field->value[0].uint64_value == 0 && field->value[0].float64_value == 0)
+            return 20;
+        return 100 + field->width;
+    case MATCHRANGE:
+        return 50 + field->width;
+    case MATCHGREATERTHAN:
+    case MATCHLESSTHAN:
+        return 30;
+    case MATCHNOTEQUALTO:
+        return 10;
+    default:
+        return 0;
+    }
+}
+
+/* `type@offset op value`, with spaces around the operator */
+static bool parse_field(char *text, bool reverse_endianness, sm_layout_field_t *field)
+{
+    char *type, *at, *op, *value, *end;
+    match_flags flags;
+    size_t i;
+
+    memset(field, 0, sizeof(sm_layout_field_t));
+    type = strtok_r(text, " \t", &end);
+    op = strtok_r(NULL, " \t", &end);
+    value = strtok_r(NULL, " \t", &end);
+    if (type == NULL || op == NULL || strtok_r(NULL, " \t", &end) != NULL ||
+        (at = strchr(type, '@')) == NULL) {
+        show_error("`%s` is not a field, see `help struct`.\n", text);
+        return false;
+    }
+    *at++ = '\0';
+
+    for (i = 0; i < sizeof(field_types) / sizeof(field_types[0]); i++) {
+        if (strcmp(type, field_types[i].name) == 0)
+            break;
+    }
+    if (i == sizeof(field_types) / sizeof(field_types[0])) {
+        show_error("unknown type `%s`, see `help struct`.\n", type);
+        return false;
+    }
+    field->type = field_types[i].type;
+    field->width = field_types[i].width;
+    flags = field_types[i].flags;
+
+    field->offset = strtoul(at, &end, 0x00);
+    if (at[0] == '\0' || *end != '\0' || field->offset + field->width > SM_LAYOUT_MAX_SIZE) {
+        show_error("bad offset `%s`, fields end within %d bytes.\n", at, SM_LAYOUT_MAX_SIZE);
+        return false;
+    }
+
+    for (i = 0; i < sizeof(field_matches) / sizeof(field_matches[0]); i++) {
+        if (strcmp(op, field_matches[i].name) == 0)
+            break;
+    }
+    if (i == sizeof(field_matches) / sizeof(field_matches[0])) {
+        show_error("unknown comparison `%s`, see `help struct`.\n", op);
+        return false;
+    }
+    field->match = field_matches[i].match;
+
+    if (field->match == MATCHANY) {
+        if (value != NULL) {
+            show_error("`any` takes no value.\n");
+            return false;
+        }
+        field->value[0].flags = flags;
+    } else if (value == NULL) {
+        show_error("`%s` needs a value.\n", op);
+        return false;
+    } else if (field->match == MATCHRANGE) {
+        char *dots = strstr(value, "..");
+
+        if (dots == NULL) {
+            show_error("`%s` is not a range such as 1..10.\n", value);
+            return false;
+        }
+        *dots = '\0';
+        if (!parse_value(value, field->type, flags, &field->value[0]) ||
+            !parse_value(dots + 2, field->type, flags, &field->value[1]))
+            return false;
+        if (field->value[0].float64_value > field->value[1].float64_value) {
+            show_error("Empty range\n");
+            return false;
+        }
+        field->value[0].flags &= field->value[1].flags;
+    } else if (!parse_value(value, field->type, flags, &field->value[0])) {
+        return false;
+    }
+
+    field->routine = sm_get_scanroutine(field->type, field->match, field->value[0].flags,
+                                        reverse_endianness);
+    if (field->routine == NULL) {
+        show_error("unsupported comparison for `%s`.\n", type);
+        return false;
+    }
+    return true;
+}
+
+/* the bytes an integer field equal to its value has */
+static size_t anchor_bytes(const sm_layout_field_t *field, bool reverse_endianness, uint8_t *bytes)
+{
+    const uservalue_t *v = &field->value[0];
+    uint64_t u;
+
+    if (field->match != MATCHEQUALTO || field->type == FLOAT32 || field->type == FLOAT64)
+        return 0;
+
+    /* the signed and unsigned values share their bits, if both fit */
+    switch (field->width) {
+    case 1: u = (v->flags & flag_s8b) ? (uint8_t) v->int8_value : v->uint8_value; break;
+    case 2: u = (v->flags & flag_s16b) ? (uint16_t) v->int16_value : v->uint16_value; break;
+    case 4: u = (v->flags & flag_s32b) ? (uint32_t) v->int32_value : v->uint32_value; break;
+    default: u = (v->flags & flag_s64b) ? (uint64_t) v->int64_value : v->uint64_value; break;
+    }
+    if (reverse_endianness)
+        u = swap_bytes64(u) >> (64 - 8 * field->width);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    u <<= 64 - 8 * field->width;
+#endif
+    memcpy(bytes, &u, field->width);
+    return field->width;
+}
+
+bool sm_layout_parse(const char *text, bool reverse_endianness, sm_layout_t *layout)
+{
+    char *copy, *field, *end;
+    size_t i, j;
+    bool ok = true;
+
+    memset(layout, 0, sizeof(sm_layout_t));
+    if ((copy = strdup(text)) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return false;
+    }
+
+    for (field = strtok_r(copy, ",", &end); field && ok; field = strtok_r(NULL, ",", &end)) {
+        sm_layout_field_t *f = &layout->fields[layout->num_fields];
+
+        if (layout->num_fields == SM_LAYOUT_MAX_FIELDS) {
+            show_error("a structure can have up to %d fields.\n", SM_LAYOUT_MAX_FIELDS);
+            ok = false;
+        } else if ((ok = parse_field(field, reverse_endianness, f))) {
+            if (f->offset + f->width > layout->size)
+                layout->size = f->offset + f->width;
+            layout->num_fields++;
+        }
+    }
+    free(copy);
+    if (!ok)
+        return false;
+    if (layout->num_fields == 0) {
+        show_error("no fields were given, see `help struct`.\n");
+        return false;
+    }
+
+    /* the most selective first, otherwise as declared */
+    for (i = 0; i < layout->num_fields; i++) {
+        for (j = i; j > 0 && selectivity(&layout->fields[layout->order[j - 1]]) <
+                             selectivity(&layout->fields[i]); j--)
+            layout->order[j] = layout->order[j - 1];
+        layout->order[j] = i;
+    }
+    layout->anchor_length = anchor_bytes(&layout->fields[layout->order[0]], reverse_endianness,
+                                         layout->anchor_bytes);
+    return true;
+}
+
+size_t sm_layout_find(const sm_layout_t *layout, const uint8_t *buf, size_t count, size_t from)
+{
+    size_t offset = layout->fields[layout->order[0]].offset;
+    const uint8_t *found;
+
+    if (layout->anchor_length == 0 || from >= count)
+        return from;
+    found = memmem(buf + from + offset, count - from - 1 + layout->anchor_length,
+                   layout->anchor_bytes, layout->anchor_length);
+    return found ? (size_t) (found - buf) - offset : count;
+}
+
+unsigned sm_layout_match(const sm_layout_t *layout, const uint8_t *buf, uint16_t *flags)
+{
+    unsigned first = 0;
+    size_t i;
+
+    for (i = 0; i < layout->num_fields; i++) {
+        size_t k = layout->order[i];
+        const sm_layout_field_t *f = &layout->fields[k];
+        uint16_t saveflags = flags_empty;
+        unsigned length;
+
+        length = f->routine((const mem64_t *) (buf + f->offset), layout->size - f->offset, NULL,
+                            f->value, &saveflags);
+        if (length == 0)
+            return 0;
+        if (k == 0) {
+            first = length;
+            *flags = saveflags;
+        }
+    }
+    return first;
+}
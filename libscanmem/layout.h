@@ -0,0 +1,74 @@
+/*
+    Matching several values at known offsets from each other.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scanroutines.h"
+#include "value.h"
+
+#define SM_LAYOUT_MAX_FIELDS 16
+/* the largest structure, from its start to the end of the last field */
+#define SM_LAYOUT_MAX_SIZE 4096
+
+typedef struct {
+    size_t offset;                  /* from the start of the structure */
+    size_t width;
+    scan_data_type_t type;          /* INTEGER8 to FLOAT64 */
+    scan_match_type_t match;        /* MATCHANY, or a comparison with `value` */
+    uservalue_t value[2];           /* the second one ends a range */
+    scan_routine_t routine;
+} sm_layout_field_t;
+
+/*
+ * A structure, as fields matched at their offset from where it starts. The
+ * fields are checked the most selective first, so that most places are
+ * ruled out by one comparison; when that anchor is an integer equal to a
+ * value, its bytes are searched for directly instead.
+ */
+typedef struct sm_layout {
+    sm_layout_field_t fields[SM_LAYOUT_MAX_FIELDS];    /* as declared */
+    size_t num_fields;
+    size_t size;
+    size_t order[SM_LAYOUT_MAX_FIELDS];     /* the fields, the anchor first */
+    uint8_t anchor_bytes[sizeof(uint64_t)];
+    size_t anchor_length;                   /* 0 if the anchor has no bytes to look for */
+} sm_layout_t;
+
+/*
+ * Read a layout such as `i64@0 = 55, i64@8 in -100..100, f64@16 any`:
+ * fields separated by commas, each a type among i8, i16, i32, i64, f32 and
+ * f64, `@` its offset, then `= v`, `!= v`, `> v`, `< v`, `in a..b` or `any`.
+ */
+bool sm_layout_parse(const char *text, bool reverse_endianness, sm_layout_t *layout);
+
+/* the first place from `from` on, below `count`, where a structure could
+ * start in `buf` as far as the anchor tells, or `count` if there is none */
+size_t sm_layout_find(const sm_layout_t *layout, const uint8_t *buf, size_t count, size_t from);
+
+/* Whether the structure starting at `buf`, of layout->size bytes, matches.
+ * Returns the width the first field matched with, its flags in `flags`, or
+ * 0 if it does not match. */
+unsigned sm_layout_match(const sm_layout_t *layout, const uint8_t *buf, uint16_t *flags);
+
+#endif /* LAYOUT_H */
@@ -47,6 +47,7 @@
 #include "common.h"
 #include "scanmem.h"
 #include "commands.h"
+#include "daemon.h"
 #include "show_message.h"
 
 #include "menu.h"
@@ -80,6 +81,7 @@ static const char help_text[] =
 "\n"
 "-p, --pid=pid\t\tset the target process pid\n"
 "-c, --command\t\trun given commands (separated by `;`)\n"
+"-D, --daemon=socket\tserve the session on a unix socket, see daemon.h\n"
 "-h, --help\t\tprint this message\n"
 "-v, --version\t\tprint version information\n"
 "\n"
@@ -162,7 +164,8 @@ static inline int mkpath(const char *file_path, mode_t mode)
     return 0;
 }
 
-static void parse_parameters(int argc, char **argv, char **initial_commands, bool *exit_on_error)
+static void parse_parameters(int argc, char **argv, char **initial_commands, bool *exit_on_error,
+                             char **daemon_path)
 {
     struct option longopts[] = {
         {"pid",     1, NULL, 'p'},      /* target pid */
@@ -171,6 +174,7 @@ static void parse_parameters(int argc, char **argv, char **initial_commands, boo
         {"help",    0, NULL, 'h'},      /* print help summary */
         {"debug",   0, NULL, 'd'},      /* enable debug mode */
         {"errexit", 0, NULL, 'e'},      /* exit on initial command failure */
+        {"daemon",  1, NULL, 'D'},      /* serve the session on a socket */
         {NULL, 0, NULL, 0},
     };
     char *end;
@@ -180,7 +184,7 @@ static void parse_parameters(int argc, char **argv, char **initial_commands, boo
 
     /* process command line */
     while (!done) {
-        switch (getopt_long(argc, argv, "vhdep:c:", longopts, &optindex)) {
+        switch (getopt_long(argc, argv, "vhdep:c:D:", longopts, &optindex)) {
             case 'p':
                 vars->target = (pid_t) strtoul(optarg, &end, 0);
 
@@ -205,6 +209,9 @@ static void parse_parameters(int argc, char **argv, char **initial_commands, boo
             case 'e':
                 *exit_on_error = true;
                 break;
+            case 'D':
+                *daemon_path = optarg;
+                break;
             case -1:
                 done = true;
                 break;
@@ -229,7 +236,8 @@ int main(int argc, char **argv)
 {
     char *initial_commands = NULL;
     bool exit_on_error = false;
-    parse_parameters(argc, argv, &initial_commands, &exit_on_error);
+    char *daemon_path = NULL;
+    parse_parameters(argc, argv, &initial_commands, &exit_on_error, &daemon_path);
 
     int ret = EXIT_SUCCESS;
     globals_t *vars = &sm_globals;
@@ -270,7 +278,10 @@ int main(int argc, char **argv)
             }
 
             if (sm_execcommand(vars, line) == false) {
-                if (exit_on_error) goto end;
+                if (exit_on_error) {
+                    ret = EXIT_FAILURE;
+                    goto end;
+                }
                 show_user_quick_help(vars->target);
             }
 
@@ -281,6 +292,13 @@ int main(int argc, char **argv)
     if (vars->exit)
         goto end;
 
+    /* serve the session instead of reading commands */
+    if (daemon_path) {
+        if (!sm_daemon_run(daemon_path))
+            ret = EXIT_FAILURE;
+        goto end;
+    }
+
     /* Start of interactive mode: recover history from history file */
     const unsigned int hist_max_size = 1000;
     char *sm_config_dir = get_config_dir();
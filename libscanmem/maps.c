@@ -1,5 +1,5 @@
 /*
-    Reading the data from /proc/pid/maps into a regions list.
+    Reading the data from /proc/pid/maps into a region table.
 
     Copyright (C) 2006,2007,2009 Tavis Ormandy <taviso@sdf.lonestar.org>
     Copyright (C) 2009           Eli Dupree <elidupree@charter.net>
@@ -31,31 +31,185 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
-#include <alloca.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
-#include "list.h"
 #include "maps.h"
-#include "getline.h"
 #include "show_message.h"
 
 const char *region_type_names[] = REGION_TYPE_NAMES;
 
-bool sm_readmaps(pid_t target, list_t *regions, region_scan_level_t region_scan_level)
+/* regions are carved out of blocks, which are only freed with their table */
+#define REGION_BLOCK_SIZE (64<<10)
+
+struct region_block {
+    struct region_block *next;
+    size_t used;
+    size_t size;
+    unsigned long data[];
+};
+
+region_table_t *rt_init(void)
 {
-    FILE *maps;
-    char name[128], *line = NULL;
-    char exelink[128];
-    size_t len = 0;
-    unsigned int code_regions = 0, exe_regions = 0;
-    unsigned long prev_end = 0, load_addr = 0, exe_load = 0;
-    bool is_exe = false;
+    return calloc(1, sizeof(region_table_t));
+}
+
+void rt_destroy(region_table_t *table)
+{
+    if (table == NULL)
+        return;
+    while (table->blocks) {
+        struct region_block *block = table->blocks;
+        table->blocks = block->next;
+        free(block);
+    }
+    free(table->regions);
+    free(table->ids);
+    free(table);
+}
+
+region_t *rt_alloc(region_table_t *table, size_t filename_len)
+{
+    struct region_block *block = table->blocks;
+    /* keep every region aligned */
+    size_t size = (sizeof(region_t) + filename_len + sizeof(unsigned long) - 1) &
+                  ~(sizeof(unsigned long) - 1);
+    region_t *region;
+
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = REGION_BLOCK_SIZE - sizeof(struct region_block);
+
+        if (size > block_size)
+            block_size = size;
+        if ((block = malloc(sizeof(struct region_block) + block_size)) == NULL) {
+            show_error("failed to allocate memory for region.\n");
+            return NULL;
+        }
+        block->used = 0;
+        block->size = block_size;
+        block->next = table->blocks;
+        table->blocks = block;
+    }
+
+    region = (region_t *) ((char *) block->data + block->used);
+    block->used += size;
+    memset(region, 0, size);
+    return region;
+}
+
+/* make room for `size` regions and for the ids below `ids` */
+static bool rt_reserve(region_table_t *table, size_t size, unsigned ids)
+{
+    if (size > table->capacity) {
+        size_t capacity = table->capacity ? table->capacity : 64;
+        region_t **regions;
+
+        while (capacity < size)
+            capacity *= 2;
+        if ((regions = realloc(table->regions, capacity * sizeof(region_t *))) == NULL)
+            return false;
+        table->regions = regions;
+        table->capacity = capacity;
+    }
+    if (ids > table->ids_capacity) {
+        unsigned capacity = table->ids_capacity ? table->ids_capacity : 64;
+        region_t **by_id;
+
+        while (capacity < ids)
+            capacity *= 2;
+        if ((by_id = realloc(table->ids, capacity * sizeof(region_t *))) == NULL)
+            return false;
+        memset(by_id + table->ids_capacity, 0,
+               (capacity - table->ids_capacity) * sizeof(region_t *));
+        table->ids = by_id;
+        table->ids_capacity = capacity;
+    }
+    return true;
+}
+
+bool rt_append(region_table_t *table, region_t *region)
+{
+    if (table->size > 0) {
+        const region_t *last = table->regions[table->size - 1];
+
+        if (region->start < last->start + last->size) {
+            show_error("region at %#lx is not above the others.\n", (unsigned long) region->start);
+            return false;
+        }
+    }
+    if (region->id < table->next_id && table->ids[region->id] != NULL) {
+        show_error("region id %u is already used.\n", region->id);
+        return false;
+    }
+    if (!rt_reserve(table, table->size + 1, region->id + 1)) {
+        show_error("failed to save region.\n");
+        return false;
+    }
+
+    table->regions[table->size++] = region;
+    table->ids[region->id] = region;
+    if (region->id >= table->next_id)
+        table->next_id = region->id + 1;
+    return true;
+}
+
+/* index of the first region ending above `address` */
+static size_t rt_lower_bound(const region_table_t *table, uintptr_t address)
+{
+    size_t lo = 0, hi = table->size;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const region_t *r = table->regions[mid];
+
+        if (r->start + r->size <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+region_t *rt_find(const region_table_t *table, uintptr_t address)
+{
+    size_t i = rt_lower_bound(table, address);
+
+    if (i < table->size && table->regions[i]->start <= address)
+        return table->regions[i];
+    return NULL;
+}
+
+region_t *rt_get(const region_table_t *table, unsigned id)
+{
+    return (id < table->next_id) ? table->ids[id] : NULL;
+}
+
+bool rt_remove(region_table_t *table, unsigned id)
+{
+    region_t *r = rt_get(table, id);
+    size_t i;
+
+    if (r == NULL)
+        return false;
+
+    i = rt_lower_bound(table, r->start);
+    memmove(&table->regions[i], &table->regions[i + 1],
+            (table->size - i - 1) * sizeof(region_t *));
+    table->size--;
+    table->ids[id] = NULL;
+    return true;
+}
 
 #define MAX_LINKBUF_SIZE 256
-    char linkbuf[MAX_LINKBUF_SIZE], *exename = linkbuf;
+
+bool sm_readmaps(pid_t target, region_table_t *regions, region_scan_level_t region_scan_level)
+{
+    char name[128];
+    char exelink[128];
+    char exename[MAX_LINKBUF_SIZE];
     int linkbuf_size;
-    char binname[MAX_LINKBUF_SIZE];
 
     /* check if target is valid */
     if (target == 0)
@@ -64,14 +218,6 @@ bool sm_readmaps(pid_t target, list_t *regions, region_scan_level_t region_scan_
     /* construct the maps filename */
     snprintf(name, sizeof(name), "/proc/%u/maps", target);
 
-    /* attempt to open the maps file */
-    if ((maps = fopen(name, "r")) == NULL) {
-        show_error("failed to open maps file %s.\n", name);
-        return false;
-    }
-
-    show_info("maps file located at %s opened.\n", name);
-
     /* get executable name */
     snprintf(exelink, sizeof(exelink), "/proc/%u/exe", target);
     linkbuf_size = readlink(exelink, exename, MAX_LINKBUF_SIZE - 1);
@@ -84,185 +230,582 @@ bool sm_readmaps(pid_t target, list_t *regions, region_scan_level_t region_scan_
         exename[0] = 0;
     }
 
-    /* read every line of the maps file */
-    while (getline(&line, &len, maps) != -1) {
+    return sm_parsemaps(name, exename, regions, region_scan_level);
+}
+
+/* Read a whole file into a NUL-terminated buffer. The size of files in
+ * /proc is unknown up front, so read until the end. */
+static char *read_file(const char *path, size_t *size)
+{
+    size_t capacity = 64<<10, len = 0;
+    char *buf = NULL;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return NULL;
+
+    for ( ; ; ) {
+        ssize_t nread;
+
+        if (buf == NULL || capacity - len < 2) {
+            char *grown;
+
+            if (buf != NULL)
+                capacity *= 2;
+            if ((grown = realloc(buf, capacity)) == NULL)
+                goto error;
+            buf = grown;
+        }
+        nread = read(fd, buf + len, capacity - len - 1);
+        if (nread == -1 && errno == EINTR)
+            continue;
+        if (nread == -1)
+            goto error;
+        if (nread == 0)
+            break;
+        len += nread;
+    }
+
+    close(fd);
+    buf[len] = '\0';
+    *size = len;
+    return buf;
+
+error:
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+/* parse a hexadecimal number at `*pos` and move past it */
+static inline bool parse_hex(char **pos, unsigned long *value)
+{
+    const char *p = *pos;
+    unsigned long v = 0;
+
+    for ( ; ; p++) {
+        unsigned digit;
+
+        if (*p >= '0' && *p <= '9')
+            digit = *p - '0';
+        else if (*p >= 'a' && *p <= 'f')
+            digit = *p - 'a' + 10;
+        else if (*p >= 'A' && *p <= 'F')
+            digit = *p - 'A' + 10;
+        else
+            break;
+        v = (v << 4) | digit;
+    }
+    if (p == *pos)
+        return false;
+    *value = v;
+    *pos = (char *) p;
+    return true;
+}
+
+/* parse a decimal number at `*pos` and move past it */
+static inline bool parse_dec(char **pos, unsigned long *value)
+{
+    const char *p = *pos;
+    unsigned long v = 0;
+
+    for ( ; *p >= '0' && *p <= '9'; p++)
+        v = v * 10 + (*p - '0');
+    if (p == *pos)
+        return false;
+    *value = v;
+    *pos = (char *) p;
+    return true;
+}
+
+static inline char *skip_blanks(char *pos)
+{
+    while (*pos == ' ' || *pos == '\t')
+        pos++;
+    return pos;
+}
+
+/*
+ * The maps file is read at once and parsed in place, one line at a time:
+ *
+ *   start-end perms offset major:minor inode   pathname
+ *
+ * Everything after the permissions is optional, the pathname is the rest of
+ * the line and may contain blanks.
+ */
+bool sm_parsemaps(const char *path, const char *exename, region_table_t *regions,
+                  region_scan_level_t region_scan_level)
+{
+    char *buf, *line, *next, *limit;
+    size_t size;
+    unsigned int code_regions = 0, exe_regions = 0;
+    unsigned long prev_end = 0, load_addr = 0, exe_load = 0;
+    bool is_exe = false;
+    char binname[MAX_LINKBUF_SIZE];
+
+    /* attempt to read the maps file */
+    if ((buf = read_file(path, &size)) == NULL) {
+        show_error("failed to open maps file %s.\n", path);
+        return false;
+    }
+
+    show_info("maps file located at %s opened.\n", path);
+
+    /* parse every line of the maps file */
+    for (line = buf, limit = buf + size; line < limit; line = next) {
         unsigned long start, end;
         region_t *map = NULL;
-        char read, write, exec, cow, *filename;
-        int offset, dev_major, dev_minor, inode;
+        char read, write, exec, cow, *filename = "", *pos;
+        unsigned long offset = 0, inode = 0, dev;
         region_type_t type = REGION_TYPE_MISC;
 
-        /* slight overallocation */
-        if ((filename = alloca(len)) == NULL) {
-            show_error("failed to allocate %lu bytes for filename.\n", (unsigned long)len);
-            goto error;
+        if ((next = memchr(line, '\n', limit - line)) != NULL)
+            *next++ = '\0';
+        else
+            next = limit;
+
+        /* the address range and the permissions are required */
+        pos = line;
+        if (!parse_hex(&pos, &start) || *pos++ != '-' || !parse_hex(&pos, &end) ||
+            *pos++ != ' ' || strnlen(pos, 4) < 4)
+            continue;
+        read = pos[0];
+        write = pos[1];
+        exec = pos[2];
+        cow = pos[3];
+        pos = skip_blanks(pos + 4);
+
+        if (parse_hex(&pos, &offset)) {
+            pos = skip_blanks(pos);
+            if (parse_hex(&pos, &dev) && *pos++ == ':' && parse_hex(&pos, &dev)) {
+                pos = skip_blanks(pos);
+                if (parse_dec(&pos, &inode))
+                    filename = skip_blanks(pos);
+            }
         }
 
-        /* initialise to zero */
-        memset(filename, '\0', len);
-
-        /* parse each line */
-        if (sscanf(line, "%lx-%lx %c%c%c%c %x %x:%x %u %[^\n]", &start, &end, &read,
-                &write, &exec, &cow, &offset, &dev_major, &dev_minor, &inode, filename) >= 6) {
-            /*
-             * get the load address for regions of the same ELF file
-             *
-             * When the ELF loader loads an executable or a library into
-             * memory, there is one region per ELF segment created:
-             * .text (r-x), .rodata (r--), .data (rw-) and .bss (rw-). The
-             * 'x' permission of .text is used to detect the load address
-             * (region start) and the end of the ELF file in memory. All
-             * these regions have the same filename. The only exception
-             * is the .bss region. Its filename is empty and it is
-             * consecutive with the .data region. But the regions .bss and
-             * .rodata may not be present with some ELF files. This is why
-             * we can't rely on other regions to be consecutive in memory.
-             * There should never be more than these four regions.
-             * The data regions use their variables relative to the load
-             * address. So determining it makes sense as we can get the
-             * variable address used within the ELF file with it.
-             * But for the executable there is the special case that there
-             * is a gap between .text and .rodata. Other regions might be
-             * loaded via mmap() to it. So we have to count the number of
-             * regions belonging to the exe separately to handle that.
-             * References:
-             * http://en.wikipedia.org/wiki/Executable_and_Linkable_Format
-             * http://wiki.osdev.org/ELF
-             * http://lwn.net/Articles/531148/
-             */
-
-            /* detect further regions of the same ELF file and its end */
-            if (code_regions > 0) {
-                if (exec == 'x' || (strncmp(filename, binname,
-                  MAX_LINKBUF_SIZE) != 0 && (filename[0] != '\0' ||
-                  start != prev_end)) || code_regions >= 4) {
-                    code_regions = 0;
-                    is_exe = false;
-                    /* exe with .text and without .data is impossible */
-                    if (exe_regions > 1)
-                        exe_regions = 0;
-                } else {
-                    code_regions++;
-                    if (is_exe)
-                        exe_regions++;
-                }
+        /*
+         * get the load address for regions of the same ELF file
+         *
+         * When the ELF loader loads an executable or a library into
+         * memory, there is one region per ELF segment created:
+         * .text (r-x), .rodata (r--), .data (rw-) and .bss (rw-). The
+         * 'x' permission of .text is used to detect the load address
+         * (region start) and the end of the ELF file in memory. All
+         * these regions have the same filename. The only exception
+         * is the .bss region. Its filename is empty and it is
+         * consecutive with the .data region. But the regions .bss and
+         * .rodata may not be present with some ELF files. This is why
+         * we can't rely on other regions to be consecutive in memory.
+         * There should never be more than these four regions.
+         * The data regions use their variables relative to the load
+         * address. So determining it makes sense as we can get the
+         * variable address used within the ELF file with it.
+         * But for the executable there is the special case that there
+         * is a gap between .text and .rodata. Other regions might be
+         * loaded via mmap() to it. So we have to count the number of
+         * regions belonging to the exe separately to handle that.
+         * References:
+         * http://en.wikipedia.org/wiki/Executable_and_Linkable_Format
+         * http://wiki.osdev.org/ELF
+         * http://lwn.net/Articles/531148/
+         */
+
+        /* detect further regions of the same ELF file and its end */
+        if (code_regions > 0) {
+            if (exec == 'x' || (strncmp(filename, binname,
+              MAX_LINKBUF_SIZE) != 0 && (filename[0] != '\0' ||
+              start != prev_end)) || code_regions >= 4) {
+                code_regions = 0;
+                is_exe = false;
+                /* exe with .text and without .data is impossible */
+                if (exe_regions > 1)
+                    exe_regions = 0;
+            } else {
+                code_regions++;
+                if (is_exe)
+                    exe_regions++;
             }
-            if (code_regions == 0) {
-                /* detect the first region belonging to an ELF file */
-                if (exec == 'x' && filename[0] != '\0') {
-                    code_regions++;
-                    if (strncmp(filename, exename, MAX_LINKBUF_SIZE) == 0) {
-                        exe_regions = 1;
-                        exe_load = start;
-                        is_exe = true;
-                    }
-                    strncpy(binname, filename, MAX_LINKBUF_SIZE);
-                    binname[MAX_LINKBUF_SIZE - 1] = '\0';  /* just to be sure */
-                /* detect the second region of the exe after skipping regions */
-                } else if (exe_regions == 1 && filename[0] != '\0' &&
-                  strncmp(filename, exename, MAX_LINKBUF_SIZE) == 0) {
-                    code_regions = ++exe_regions;
-                    load_addr = exe_load;
+        }
+        if (code_regions == 0) {
+            /* detect the first region belonging to an ELF file */
+            if (exec == 'x' && filename[0] != '\0') {
+                code_regions++;
+                if (strncmp(filename, exename, MAX_LINKBUF_SIZE) == 0) {
+                    exe_regions = 1;
+                    exe_load = start;
                     is_exe = true;
-                    strncpy(binname, filename, MAX_LINKBUF_SIZE);
-                    binname[MAX_LINKBUF_SIZE - 1] = '\0';  /* just to be sure */
                 }
-                if (exe_regions < 2)
-                    load_addr = start;
+                strncpy(binname, filename, MAX_LINKBUF_SIZE);
+                binname[MAX_LINKBUF_SIZE - 1] = '\0';  /* just to be sure */
+            /* detect the second region of the exe after skipping regions */
+            } else if (exe_regions == 1 && filename[0] != '\0' &&
+              strncmp(filename, exename, MAX_LINKBUF_SIZE) == 0) {
+                code_regions = ++exe_regions;
+                load_addr = exe_load;
+                is_exe = true;
+                strncpy(binname, filename, MAX_LINKBUF_SIZE);
+                binname[MAX_LINKBUF_SIZE - 1] = '\0';  /* just to be sure */
             }
-            prev_end = end;
-
-            /* must have permissions to read and write, and be non-zero size */
-            if ((write == 'w') && (read == 'r') && ((end - start) > 0)) {
-                bool useful = false;
-
-                /* determine region type */
-                if (is_exe)
-                    type = REGION_TYPE_EXE;
-                else if (code_regions > 0)
-                    type = REGION_TYPE_CODE;
-                else if (!strcmp(filename, "[heap]"))
-                    type = REGION_TYPE_HEAP;
-                else if (!strcmp(filename, "[stack]"))
-                    type = REGION_TYPE_STACK;
-
-                /* determine if this region is useful */
-                switch (region_scan_level)
-                {
-                    case REGION_ALL:
+            if (exe_regions < 2)
+                load_addr = start;
+        }
+        prev_end = end;
+
+        /* must have permissions to read and write, and be non-zero size */
+        if ((write == 'w') && (read == 'r') && ((end - start) > 0)) {
+            bool useful = false;
+
+            /* determine region type */
+            if (is_exe)
+                type = REGION_TYPE_EXE;
+            else if (code_regions > 0)
+                type = REGION_TYPE_CODE;
+            else if (!strcmp(filename, "[heap]"))
+                type = REGION_TYPE_HEAP;
+            else if (!strcmp(filename, "[stack]"))
+                type = REGION_TYPE_STACK;
+
+            /* determine if this region is useful */
+            switch (region_scan_level)
+            {
+                case REGION_ALL:
+                    useful = true;
+                    break;
+                case REGION_HEAP_STACK_EXECUTABLE_BSS:
+                    if (filename[0] == '\0')
+                    {
                         useful = true;
                         break;
-                    case REGION_HEAP_STACK_EXECUTABLE_BSS:
-                        if (filename[0] == '\0')
-                        {
-                            useful = true;
-                            break;
-                        }
-                        /* fall through */
-                    case REGION_HEAP_STACK_EXECUTABLE:
-                        if (type == REGION_TYPE_HEAP || type == REGION_TYPE_STACK)
-                        {
-                            useful = true;
-                            break;
-                        }
-                        /* test if the region is mapped to the executable */
-                        if (type == REGION_TYPE_EXE ||
-                          strncmp(filename, exename, MAX_LINKBUF_SIZE) == 0)
-                            useful = true;
-                    break;
-                }
+                    }
+                    /* fall through */
+                case REGION_HEAP_STACK_EXECUTABLE:
+                    if (type == REGION_TYPE_HEAP || type == REGION_TYPE_STACK)
+                    {
+                        useful = true;
+                        break;
+                    }
+                    /* test if the region is mapped to the executable */
+                    if (type == REGION_TYPE_EXE ||
+                      strncmp(filename, exename, MAX_LINKBUF_SIZE) == 0)
+                        useful = true;
+                break;
+            }
+
+            if (!useful)
+                continue;
+
+            /* allocate a new region structure */
+            if ((map = rt_alloc(regions, strlen(filename))) == NULL)
+                goto error;
+
+            /* initialize this region */
+            map->flags.read = true;
+            map->flags.write = true;
+            map->start = start;
+            map->size = (unsigned long) (end - start);
+            map->type = type;
+            map->load_addr = load_addr;
+            map->offset = offset;
+            map->inode = inode;
+
+            /* setup other permissions */
+            map->flags.exec = (exec == 'x');
+            map->flags.shared = (cow == 's');
+            map->flags.private = (cow == 'p');
+
+            /* save pathname, concatenated with the structure */
+            strcpy(map->filename, filename);
+
+            /* add a unique identifier */
+            map->id = regions->next_id;
+            
+            /* okay, add this guy to our table */
+            if (!rt_append(regions, map))
+                goto error;
+        }
+    }
+
+    show_info("%lu suitable regions found.\n", (unsigned long) regions->size);
+    
+    /* release memory allocated */
+    free(buf);
 
-                if (!useful)
-                    continue;
+    return true;
 
-                /* allocate a new region structure */
-                if ((map = calloc(1, sizeof(region_t) + strlen(filename))) == NULL) {
-                    show_error("failed to allocate memory for region.\n");
-                    goto error;
-                }
+error:
+    free(buf);
+
+    return false;
+}
+
+/* residency of a mapping in the smaps file */
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+    unsigned long rss;
+    unsigned long anonymous;
+    unsigned long dirty;
+} residency_t;
+
+/* add the residency of a mapping to the regions within it, in proportion to
+ * how much of it they cover */
+static void add_residency(region_table_t *regions, const residency_t *res)
+{
+    size_t i;
+
+    for (i = rt_lower_bound(regions, res->start);
+         i < regions->size && regions->regions[i]->start < res->end; i++) {
+        region_t *r = regions->regions[i];
+        uintptr_t from = (r->start > res->start) ? r->start : res->start;
+        uintptr_t to = (r->start + r->size < res->end) ? r->start + r->size : res->end;
+        double share = (double) (to - from) / (res->end - res->start);
+
+        r->rss += share * res->rss;
+        r->anonymous += share * res->anonymous;
+        r->dirty += share * res->dirty;
+    }
+}
+
+/*
+ * The smaps file has a block per mapping: the line of the maps file,
+ * followed by lines like
+ *
+ *   Rss:                 132 kB
+ *
+ * Only the totals are in smaps_rollup, so the whole file is needed.
+ */
+bool sm_readsmaps(pid_t target, region_table_t *regions)
+{
+    char name[128], *buf, *line, *next, *limit;
+    residency_t res = { 0, 0, 0, 0, 0 };
+    size_t size, i;
 
-                /* initialize this region */
-                map->flags.read = true;
-                map->flags.write = true;
-                map->start = (void *) start;
-                map->size = (unsigned long) (end - start);
-                map->type = type;
-                map->load_addr = load_addr;
-
-                /* setup other permissions */
-                map->flags.exec = (exec == 'x');
-                map->flags.shared = (cow == 's');
-                map->flags.private = (cow == 'p');
-
-                /* save pathname */
-                if (strlen(filename) != 0) {
-                    /* the pathname is concatenated with the structure */
-                    strcpy(map->filename, filename);
+    snprintf(name, sizeof(name), "/proc/%u/smaps", target);
+    if ((buf = read_file(name, &size)) == NULL) {
+        show_error("failed to read %s.\n", name);
+        return false;
+    }
+
+    for (i = 0; i < regions->size; i++) {
+        regions->regions[i]->rss = 0;
+        regions->regions[i]->anonymous = 0;
+        regions->regions[i]->dirty = 0;
+    }
+
+    for (line = buf, limit = buf + size; line < limit; line = next) {
+        unsigned long start, end, kb;
+        char *pos = line, *colon;
+
+        if ((next = memchr(line, '\n', limit - line)) != NULL)
+            *next++ = '\0';
+        else
+            next = limit;
+
+        /* the start of the next mapping */
+        if (parse_hex(&pos, &start) && *pos++ == '-' && parse_hex(&pos, &end)) {
+            if (res.end > res.start)
+                add_residency(regions, &res);
+            res = (residency_t) { start, end, 0, 0, 0 };
+            continue;
+        }
+
+        if ((colon = strchr(line, ':')) == NULL)
+            continue;
+        pos = skip_blanks(colon + 1);
+        if (!parse_dec(&pos, &kb))
+            continue;
+        *colon = '\0';
+
+        if (strcmp(line, "Rss") == 0)
+            res.rss = kb * 1024;
+        else if (strcmp(line, "Anonymous") == 0)
+            res.anonymous = kb * 1024;
+        else if (strcmp(line, "Shared_Dirty") == 0 || strcmp(line, "Private_Dirty") == 0)
+            res.dirty += kb * 1024;
+    }
+    if (res.end > res.start)
+        add_residency(regions, &res);
+
+    free(buf);
+    return true;
+}
+
+/* check if `fresh` maps the same thing as `old` did, at the same addresses */
+static bool same_mapping(const region_t *old, const region_t *fresh)
+{
+    if (old->inode != fresh->inode || strcmp(old->filename, fresh->filename) != 0)
+        return false;
+    /* anonymous regions have no meaningful offset */
+    if (old->inode == 0)
+        return true;
+    return old->offset - fresh->offset == (unsigned long) (old->start - fresh->start);
+}
+
+/* append the part [start, end) of `fresh` to `regions` as a new region */
+static bool add_piece(region_table_t *regions, const region_t *fresh, uintptr_t start, uintptr_t end)
+{
+    region_t *map;
+
+    if ((map = rt_alloc(regions, strlen(fresh->filename))) == NULL)
+        return false;
+    memcpy(map, fresh, sizeof(region_t) + strlen(fresh->filename));
+    map->start = start;
+    map->size = end - start;
+    if (map->inode != 0)
+        map->offset += start - fresh->start;
+    map->flags.unscanned = true;
+    map->id = regions->next_id;
+
+    return rt_append(regions, map);
+}
+
+/*
+ * Bring `regions` up to date with the maps file, without losing what is
+ * known about the regions which did not change.
+ *
+ * The regions still mapped the same way are kept with their id, clipped to
+ * the part which is still mapped. The address ranges which are gone are
+ * returned in `removed`, sorted, so that the matches within them can be
+ * dropped; the caller frees it. Anything mapped in addition (new regions as
+ * well as grown ones) becomes a new region with a new id, flagged as
+ * `unscanned`.
+ */
+bool sm_refreshmaps(pid_t target, region_table_t *regions, address_range_t **removed,
+                    size_t *num_removed, region_scan_level_t region_scan_level)
+{
+    region_table_t *fresh;
+    bool ret;
+
+    *removed = NULL;
+    *num_removed = 0;
+
+    if ((fresh = rt_init()) == NULL) {
+        show_error("sorry, there was a problem allocating memory.\n");
+        return false;
+    }
+    if (!sm_readmaps(target, fresh, region_scan_level)) {
+        rt_destroy(fresh);
+        return false;
+    }
+
+    ret = sm_mergemaps(regions, fresh, removed, num_removed);
+    rt_destroy(fresh);
+    return ret;
+}
+
+bool sm_mergemaps(region_table_t *regions, const region_table_t *fresh,
+                  address_range_t **removed, size_t *num_removed)
+{
+    region_table_t *merged = NULL, old;
+    address_range_t *gone = NULL;
+    size_t i = 0, k, n = 0;
+    /* where the part of regions[i] not gone through yet starts */
+    uintptr_t from = regions->size ? regions->regions[0]->start : 0;
+    bool id_taken = false;      /* whether a piece of regions[i] kept its id */
+    bool ret = true;
+
+    *removed = NULL;
+    *num_removed = 0;
+
+    /*
+     * An old region overlaps a run of new ones. Each piece of it within a
+     * new region mapping the same thing is kept, the first one with the id
+     * of the old region; the rest of it is gone. A new region adds a piece
+     * in front of every kept piece within it and one behind them. The kept
+     * pieces are copied to the new table, so that the memory of the old
+     * regions is given back.
+     */
+    if ((merged = rt_init()) == NULL ||
+        !rt_reserve(merged, 2 * (regions->size + fresh->size),
+                    regions->next_id + regions->size + 2 * fresh->size) ||
+        (gone = malloc((2 * (regions->size + fresh->size) + 1) *
+                       sizeof(address_range_t))) == NULL) {
+        show_error("sorry, there was a problem allocating memory.\n");
+        rt_destroy(merged);
+        return false;
+    }
+    /* ids of removed regions are not given out again */
+    merged->next_id = regions->next_id;
+
+    /* both tables are sorted by address, walk along the new one */
+    for (k = 0; k < fresh->size; k++) {
+        const region_t *f = fresh->regions[k];
+        uintptr_t pos = f->start, f_end = f->start + f->size;
+
+        while (i < regions->size && from < f_end) {
+            const region_t *o = regions->regions[i];
+            uintptr_t o_end = o->start + o->size;
+            uintptr_t lo = from > f->start ? from : f->start;
+            uintptr_t hi = o_end < f_end ? o_end : f_end;
+            region_t *kept = NULL;
+
+            /* not mapped anymore up to this new region */
+            if (from < f->start)
+                gone[n++] = (address_range_t) { from, hi > f->start ? f->start : o_end };
+
+            if (lo < hi && !same_mapping(o, f)) {
+                /* replaced by something else */
+                gone[n++] = (address_range_t) { lo, hi };
+            } else if (lo < hi) {
+                if ((kept = rt_alloc(merged, strlen(o->filename))) == NULL) {
+                    gone[n++] = (address_range_t) { lo, hi };
+                    ret = false;
+                } else {
+                    memcpy(kept, o, sizeof(region_t) + strlen(o->filename));
+                    if (kept->inode != 0)
+                        kept->offset += lo - o->start;
+                    kept->start = lo;
+                    kept->size = hi - lo;
+                    /* the further pieces of a split region are regions of their own */
+                    if (id_taken)
+                        kept->id = merged->next_id;
                 }
+            }
 
-                /* add a unique identifier */
-                map->id = regions->size;
-                
-                /* okay, add this guy to our list */
-                if (l_append(regions, regions->tail, map) == -1) {
-                    show_error("failed to save region.\n");
-                    goto error;
+            if (kept) {
+                /* what is mapped in front of it is new */
+                if (kept->start > pos && !add_piece(merged, f, pos, kept->start))
+                    ret = false;
+
+                if (rt_append(merged, kept)) {
+                    id_taken = true;
+                    pos = hi;
+                } else {
+                    gone[n++] = (address_range_t) { lo, hi };
+                    ret = false;
                 }
             }
+
+            if (o_end > f_end) {
+                /* the rest of it is up to the next new regions */
+                from = f_end;
+            } else if (++i < regions->size) {
+                from = regions->regions[i]->start;
+                id_taken = false;
+            }
         }
+
+        if (pos < f_end && !add_piece(merged, f, pos, f_end))
+            ret = false;
     }
 
-    show_info("%d suitable regions found.\n", regions->size);
-    
-    /* release memory allocated */
-    free(line);
-    fclose(maps);
+    /* whatever is left is behind the last mapped region */
+    for (; i < regions->size; i++) {
+        const region_t *o = regions->regions[i];
 
-    return true;
+        gone[n++] = (address_range_t) { from, o->start + o->size };
+        if (i + 1 < regions->size)
+            from = regions->regions[i + 1]->start;
+    }
 
-error:
-    free(line);
-    fclose(maps);
+    /* the kept regions were copied, drop the old ones */
+    old = *regions;
+    *regions = *merged;
+    *merged = old;
+    rt_destroy(merged);
 
-    return false;
+    *removed = gone;
+    *num_removed = n;
+    return ret;
 }
@@ -1,5 +1,5 @@
 /*
-    Reading the data from /proc/pid/maps into a regions list.
+    Reading the data from /proc/pid/maps into a region table.
 
     Copyright (C) 2006,2007,2009 Tavis Ormandy <taviso@sdf.lonestar.org>
     Copyright (C) 2009           Eli Dupree <elidupree@charter.net>
@@ -26,11 +26,10 @@
 #define MAPS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/types.h>
 
-#include "list.h"
-
 /* determine which regions we need */
 typedef enum {
     REGION_ALL,                            /* each of them */
@@ -61,11 +60,63 @@ typedef struct {
         unsigned exec:1;
         unsigned shared:1;
         unsigned private:1;
+        unsigned unscanned:1;   /* added by sm_refreshmaps() or left by a
+                                   stopped scan, not searched yet */
     } flags;
+    unsigned long offset;       /* offset into the mapped file */
+    unsigned long inode;        /* inode of the mapped file, 0 if anonymous */
+    unsigned long rss;          /* resident bytes, see sm_readsmaps() */
+    unsigned long anonymous;    /* resident anonymous bytes */
+    unsigned long dirty;        /* resident dirty bytes, shared or private */
     unsigned id;                /* unique identifier */
     char filename[1];           /* associated file, must be last */
 } region_t;
 
-bool sm_readmaps(pid_t target, list_t *regions, region_scan_level_t region_scan_level);
+struct region_block;
+
+/* The regions of a target. They are kept sorted by address in one array,
+ * so that the region containing an address is found by binary search, and
+ * indexed by id. The table owns its regions: they are allocated from it with
+ * rt_alloc() and only freed all at once by rt_destroy(). */
+typedef struct {
+    region_t **regions;         /* sorted by start address, not overlapping */
+    size_t size;
+    size_t capacity;
+    region_t **ids;             /* regions by id, NULL for removed ids */
+    unsigned next_id;           /* lowest id never used */
+    unsigned ids_capacity;
+    struct region_block *blocks;    /* memory of the regions */
+} region_table_t;
+
+/* the addresses from `start` up to, not including, `end` */
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+} address_range_t;
+
+region_table_t *rt_init(void);
+void rt_destroy(region_table_t *table);
+/* a zeroed region with room for a filename of `filename_len` characters */
+region_t *rt_alloc(region_table_t *table, size_t filename_len);
+/* `region` must lie above every region in the table, its id must be unused */
+bool rt_append(region_table_t *table, region_t *region);
+/* the region containing `address`, or NULL */
+region_t *rt_find(const region_table_t *table, uintptr_t address);
+region_t *rt_get(const region_table_t *table, unsigned id);
+/* remove the region with this id */
+bool rt_remove(region_table_t *table, unsigned id);
+
+bool sm_readmaps(pid_t target, region_table_t *regions, region_scan_level_t region_scan_level);
+/* read the maps file at `path`, of a process running the executable `exename` */
+bool sm_parsemaps(const char *path, const char *exename, region_table_t *regions,
+                  region_scan_level_t region_scan_level);
+/* update the residency of `regions` from the smaps file of `target` */
+bool sm_readsmaps(pid_t target, region_table_t *regions);
+bool sm_refreshmaps(pid_t target, region_table_t *regions, address_range_t **removed,
+                    size_t *num_removed, region_scan_level_t region_scan_level);
+/* the part of sm_refreshmaps() after reading the maps file: bring `regions`
+ * up to date with `fresh`, which is left as it is */
+bool sm_mergemaps(region_table_t *regions, const region_table_t *fresh,
+                  address_range_t **removed, size_t *num_removed);
 
 #endif /* MAPS_H */
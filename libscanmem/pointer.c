@@ -0,0 +1,939 @@
+/*
+    Finding chains of pointers leading to an address.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "common.h"
+#include "pointer.h"
+#include "scanroutines.h"
+#include "show_message.h"
+
+/* the chunks the regions are read in */
+#define PTRMAP_CHUNK_SIZE (1 << 20)
+#define MAX_PTRSCAN_WORKERS 16
+/* the records written to a map file at a time */
+#define PTRMAP_RECORDS_PER_WRITE 4096
+
+#ifndef IOV_MAX
+# define IOV_MAX 1024
+#endif
+
+static bool ptrmap_append(sm_ptrmap_t *map, size_t *capacity, uintptr_t address, uintptr_t value)
+{
+    if (map->count == *capacity) {
+        size_t n = *capacity ? *capacity * 2 : 4096;
+        sm_ptrmap_entry_t *entries;
+
+        if ((entries = realloc(map->entries, n * sizeof(sm_ptrmap_entry_t))) == NULL)
+            return false;
+        map->entries = entries;
+        *capacity = n;
+    }
+    map->entries[map->count].address = address;
+    map->entries[map->count].value = value;
+    map->count++;
+    return true;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const sm_ptrmap_entry_t *x = a, *y = b;
+
+    if (x->value != y->value)
+        return (x->value > y->value) ? 1 : -1;
+    return (x->address > y->address) - (x->address < y->address);
+}
+
+sm_ptrmap_t *sm_ptrmap_build(globals_t *vars)
+{
+    const region_table_t *regions = vars->regions;
+    sm_reader_t *reader = &vars->reader;
+    uintptr_t page_size = sysconf(_SC_PAGESIZE), low, high;
+    const region_t *last = NULL;
+    sm_ptrmap_t *map;
+    size_t capacity = 0, i;
+    uint8_t *buf;
+    bool ok = true;
+
+    if (regions->size == 0) {
+        show_error("no regions are known.\n");
+        return NULL;
+    }
+    low = regions->regions[0]->start;
+    high = regions->regions[regions->size - 1]->start + regions->regions[regions->size - 1]->size;
+
+    map = calloc(1, sizeof(sm_ptrmap_t));
+    buf = malloc(PTRMAP_CHUNK_SIZE);
+    if (map == NULL || buf == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto fail;
+    }
+
+    if (reader->image == NULL && sm_attach(reader->pid) == false)
+        goto fail;
+    sm_reader_invalidate(reader);
+
+    for (i = 0; i < regions->size && ok && !vars->stop_flag; i++) {
+        const region_t *r = regions->regions[i];
+        uintptr_t pos = r->start, end = r->start + r->size;
+
+        while (pos < end && ok && !vars->stop_flag) {
+            size_t chunk = MIN(end - pos, PTRMAP_CHUNK_SIZE);
+            size_t nread = sm_reader_read(reader, buf, pos, chunk), k;
+
+            for (k = 0; k + sizeof(uintptr_t) <= nread; k += sizeof(uintptr_t)) {
+                uintptr_t value;
+
+                memcpy(&value, buf + k, sizeof(value));
+                if (value < low || value >= high)
+                    continue;
+                /* pointers tend to point where the previous one did */
+                if (last == NULL || value < last->start || value >= last->start + last->size) {
+                    const region_t *found = rt_find(regions, value);
+
+                    if (found == NULL)
+                        continue;
+                    last = found;
+                }
+                if (!ptrmap_append(map, &capacity, pos + k, value)) {
+                    show_error("sorry, there was a memory allocation error.\n");
+                    ok = false;
+                    break;
+                }
+            }
+
+            /* go on after the page which could not be read */
+            pos = (nread < chunk) ? ((pos + nread) | (page_size - 1)) + 1 : pos + chunk;
+        }
+    }
+
+    if (reader->image == NULL)
+        sm_detach(reader->pid);
+    if (!ok || vars->stop_flag)
+        goto fail;
+
+    qsort(map->entries, map->count, sizeof(sm_ptrmap_entry_t), compare_entries);
+    free(buf);
+    return map;
+
+fail:
+    free(buf);
+    sm_ptrmap_destroy(map);
+    return NULL;
+}
+
+void sm_ptrmap_destroy(sm_ptrmap_t *map)
+{
+    if (map == NULL)
+        return;
+    free(map->entries);
+    free(map);
+}
+
+/* the region of `address`, trying the one of the previous address first */
+static const region_t *find_region(const region_table_t *regions, const region_t **last,
+                                   uintptr_t address)
+{
+    if (*last == NULL || address < (*last)->start || address >= (*last)->start + (*last)->size)
+        *last = rt_find(regions, address);
+    return *last;
+}
+
+bool sm_ptrmap_save(const sm_ptrmap_t *map, const region_table_t *regions, const char *path)
+{
+    sm_ptrmap_header_t header;
+    sm_ptrmap_record_t *records = NULL;
+    const region_t *last_address = NULL, *last_value = NULL;
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint64_t name_offset = 0, end;
+    FILE *file;
+    size_t i, n = 0;
+
+    if ((file = fopen(path, "wb")) == NULL) {
+        show_error("failed to create `%s`: %s.\n", path, strerror(errno));
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SM_PTRMAP_MAGIC, sizeof(header.magic));
+    header.num_regions = regions->size;
+    header.num_entries = map->count;
+    header.names_offset = sizeof(header) + regions->size * sizeof(sm_ptrmap_region_t);
+    for (i = 0; i < regions->size; i++)
+        header.names_size += strlen(regions->regions[i]->filename) + 1;
+    end = header.names_offset + header.names_size;
+    header.entries_offset = (end + page_size - 1) / page_size * page_size;
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        goto fail;
+    for (i = 0; i < regions->size; i++) {
+        const region_t *r = regions->regions[i];
+        sm_ptrmap_region_t m;
+
+        memset(&m, 0, sizeof(m));
+        m.start = r->start;
+        m.size = r->size;
+        m.load_addr = r->load_addr;
+        m.name_offset = name_offset;
+        m.name_length = strlen(r->filename);
+        m.id = r->id;
+        m.type = r->type;
+        name_offset += m.name_length + 1;
+        if (fwrite(&m, sizeof(m), 1, file) != 1)
+            goto fail;
+    }
+    for (i = 0; i < regions->size; i++) {
+        if (fwrite(regions->regions[i]->filename, strlen(regions->regions[i]->filename) + 1, 1,
+                   file) != 1)
+            goto fail;
+    }
+    for ( ; end < header.entries_offset; end++) {
+        if (fputc(0, file) == EOF)
+            goto fail;
+    }
+
+    if ((records = calloc(PTRMAP_RECORDS_PER_WRITE, sizeof(sm_ptrmap_record_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto out;
+    }
+    for (i = 0; i < map->count; i++) {
+        const sm_ptrmap_entry_t *e = &map->entries[i];
+        const region_t *a = find_region(regions, &last_address, e->address);
+        const region_t *v = find_region(regions, &last_value, e->value);
+
+        if (a == NULL || v == NULL) {
+            show_error("the pointer at %lx is not in a known region.\n", (unsigned long) e->address);
+            goto out;
+        }
+        records[n].address_offset = e->address - a->load_addr;
+        records[n].value_offset = e->value - v->load_addr;
+        records[n].address_region = a->id;
+        records[n].value_region = v->id;
+        if (++n == PTRMAP_RECORDS_PER_WRITE || i + 1 == map->count) {
+            if (fwrite(records, sizeof(sm_ptrmap_record_t), n, file) != n)
+                goto fail;
+            n = 0;
+        }
+    }
+
+    free(records);
+    if (fclose(file) != 0) {
+        show_error("failed to write `%s`: %s.\n", path, strerror(errno));
+        unlink(path);
+        return false;
+    }
+    return true;
+
+fail:
+    show_error("failed to write `%s`: %s.\n", path, strerror(errno));
+out:
+    free(records);
+    fclose(file);
+    unlink(path);
+    return false;
+}
+
+sm_ptrmap_t *sm_ptrmap_load(const char *path, region_table_t *regions)
+{
+    const sm_ptrmap_header_t *h;
+    const sm_ptrmap_region_t *m;
+    const sm_ptrmap_record_t *records;
+    const char *names;
+    sm_ptrmap_t *map = NULL;
+    struct stat st;
+    uint64_t size;
+    void *data;
+    size_t i;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        show_error("failed to open `%s`: %s.\n", path, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(*h) ||
+        (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        show_error("`%s` is not a map file, see `help ptrscan`.\n", path);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    h = data;
+    size = st.st_size;
+    if (memcmp(h->magic, SM_PTRMAP_MAGIC, sizeof(h->magic)) != 0) {
+        show_error("`%s` is not a map file, see `help ptrscan`.\n", path);
+        goto out;
+    }
+
+    /* everything the header points to has to be in the file */
+    if (h->num_regions > (size - sizeof(*h)) / sizeof(sm_ptrmap_region_t) ||
+        h->names_offset > size || h->names_size > size - h->names_offset ||
+        h->entries_offset > size ||
+        h->num_entries > (size - h->entries_offset) / sizeof(sm_ptrmap_record_t) ||
+        h->entries_offset % sizeof(uint64_t) != 0)
+        goto corrupt;
+    m = (const sm_ptrmap_region_t *) (h + 1);
+    names = (const char *) data + h->names_offset;
+    records = (const sm_ptrmap_record_t *) ((const char *) data + h->entries_offset);
+
+    for (i = 0; i < h->num_regions; i++) {
+        region_t *r;
+
+        if (m[i].name_offset > h->names_size || m[i].name_length > h->names_size - m[i].name_offset ||
+            m[i].start + m[i].size < m[i].start || m[i].type > REGION_TYPE_STACK)
+            goto corrupt;
+        if ((r = rt_alloc(regions, m[i].name_length)) == NULL)
+            goto nomem;
+        r->start = m[i].start;
+        r->size = m[i].size;
+        r->load_addr = m[i].load_addr;
+        r->type = m[i].type;
+        r->id = m[i].id;
+        memcpy(r->filename, names + m[i].name_offset, m[i].name_length);
+        r->filename[m[i].name_length] = '\0';
+        if (!rt_append(regions, r))
+            goto corrupt;
+    }
+
+    if ((map = calloc(1, sizeof(sm_ptrmap_t))) == NULL ||
+        (h->num_entries && (map->entries = malloc(h->num_entries * sizeof(sm_ptrmap_entry_t))) == NULL))
+        goto nomem;
+
+    /* back to the addresses the map was saved with, which keeps it sorted */
+    for (i = 0; i < h->num_entries; i++) {
+        const region_t *a = rt_get(regions, records[i].address_region);
+        const region_t *v = rt_get(regions, records[i].value_region);
+        sm_ptrmap_entry_t *e = &map->entries[i];
+
+        if (a == NULL || v == NULL)
+            goto corrupt;
+        e->address = a->load_addr + records[i].address_offset;
+        e->value = v->load_addr + records[i].value_offset;
+        if (i > 0 && e->value < e[-1].value)
+            goto corrupt;
+    }
+    map->count = h->num_entries;
+    munmap(data, st.st_size);
+    return map;
+
+corrupt:
+    show_error("`%s` is damaged.\n", path);
+    goto out;
+nomem:
+    show_error("sorry, there was a memory allocation error.\n");
+out:
+    sm_ptrmap_destroy(map);
+    munmap(data, st.st_size);
+    return NULL;
+}
+
+/* the first pointer to `value` or above */
+static size_t ptrmap_lower_bound(const sm_ptrmap_t *map, uintptr_t value)
+{
+    size_t lo = 0, hi = map->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (map->entries[mid].value < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+typedef struct {
+    const sm_ptrmap_t *map;
+    const region_table_t *regions;
+    uintptr_t target;
+    unsigned depth;
+    unsigned long max_offset;
+    size_t max_chains;
+    const volatile bool *stop_flag;
+    size_t first, last;         /* the pointers near the target */
+    size_t next;                /* the next of these to follow, taken atomically */
+    pthread_mutex_t lock;       /* guards what follows */
+    sm_ptrchain_t *chains;
+    size_t num_chains;
+    size_t capacity;
+    bool full;                  /* set once `max_chains` are found */
+    bool failed;
+} ptrscan_job_t;
+
+/* an address from which nothing was found, following up to `depth` pointers */
+typedef struct {
+    uintptr_t address;
+    unsigned depth;
+} memo_slot_t;
+
+typedef struct {
+    ptrscan_job_t *job;
+    long offsets[SM_PTR_MAX_DEPTH];    /* from the target backwards */
+    memo_slot_t *memo;                 /* open addressing, a power of two */
+    size_t memo_size;
+    size_t memo_used;
+} ptrscan_worker_t;
+
+static inline bool stopped(ptrscan_job_t *job)
+{
+    return *job->stop_flag || __atomic_load_n(&job->full, __ATOMIC_ACQUIRE);
+}
+
+static inline bool is_static(const region_t *r)
+{
+    return r->type == REGION_TYPE_EXE || r->type == REGION_TYPE_CODE;
+}
+
+/* the pointers within `max_offset` of `target` */
+static void pointers_near(const ptrscan_job_t *job, uintptr_t target, size_t *first, size_t *last)
+{
+    uintptr_t lo = (target > job->max_offset) ? target - job->max_offset : 0;
+    uintptr_t hi = (target + job->max_offset < target) ? UINTPTR_MAX : target + job->max_offset;
+
+    *first = ptrmap_lower_bound(job->map, lo);
+    *last = (hi == UINTPTR_MAX) ? job->map->count : ptrmap_lower_bound(job->map, hi + 1);
+}
+
+static inline size_t memo_slot(const ptrscan_worker_t *w, uintptr_t address)
+{
+    return (size_t) (((uint64_t) address * 0x9e3779b97f4a7c15ULL) >> 32) & (w->memo_size - 1);
+}
+
+static bool memo_failed(const ptrscan_worker_t *w, uintptr_t address, unsigned depth)
+{
+    size_t i;
+
+    if (w->memo == NULL)
+        return false;
+    for (i = memo_slot(w, address); w->memo[i].address != 0; i = (i + 1) & (w->memo_size - 1)) {
+        if (w->memo[i].address == address)
+            return w->memo[i].depth >= depth;
+    }
+    return false;
+}
+
+/* remember that nothing leads to `address` in `depth` pointers, nor in less */
+static void memo_add(ptrscan_worker_t *w, uintptr_t address, unsigned depth)
+{
+    size_t i;
+
+    if (w->memo_used * 2 >= w->memo_size) {
+        size_t size = w->memo_size ? w->memo_size * 2 : 4096, j;
+        memo_slot_t *old = w->memo, *memo;
+
+        /* without it the search is only slower */
+        if ((memo = calloc(size, sizeof(memo_slot_t))) == NULL)
+            return;
+        w->memo = memo;
+        w->memo_size = size;
+        for (j = 0; old && j < size / 2; j++) {
+            if (old[j].address == 0)
+                continue;
+            for (i = memo_slot(w, old[j].address); memo[i].address != 0; i = (i + 1) & (size - 1))
+                ;
+            memo[i] = old[j];
+        }
+        free(old);
+    }
+
+    for (i = memo_slot(w, address); w->memo[i].address != 0; i = (i + 1) & (w->memo_size - 1)) {
+        if (w->memo[i].address == address) {
+            if (depth > w->memo[i].depth)
+                w->memo[i].depth = depth;
+            return;
+        }
+    }
+    w->memo[i].address = address;
+    w->memo[i].depth = depth;
+    w->memo_used++;
+}
+
+static size_t add_chain(ptrscan_worker_t *w, uintptr_t base, const region_t *region, unsigned depth)
+{
+    ptrscan_job_t *job = w->job;
+    sm_ptrchain_t *chain;
+    unsigned i;
+    size_t ret = 0;
+
+    pthread_mutex_lock(&job->lock);
+    if (job->full)
+        goto out;
+    if (job->num_chains == job->capacity) {
+        size_t capacity = job->capacity ? job->capacity * 2 : 256;
+        sm_ptrchain_t *chains;
+
+        if ((chains = realloc(job->chains, capacity * sizeof(sm_ptrchain_t))) == NULL) {
+            job->failed = true;
+            __atomic_store_n(&job->full, true, __ATOMIC_RELEASE);
+            goto out;
+        }
+        job->chains = chains;
+        job->capacity = capacity;
+    }
+
+    chain = &job->chains[job->num_chains++];
+    memset(chain, 0, sizeof(sm_ptrchain_t));
+    chain->base = base;
+    chain->region_id = region->id;
+    chain->depth = depth;
+    for (i = 0; i < depth; i++)
+        chain->offsets[i] = w->offsets[depth - 1 - i];
+    if (job->num_chains == job->max_chains)
+        __atomic_store_n(&job->full, true, __ATOMIC_RELEASE);
+    ret = 1;
+
+out:
+    pthread_mutex_unlock(&job->lock);
+    return ret;
+}
+
+static size_t search(ptrscan_worker_t *w, uintptr_t target, unsigned level);
+
+/* the chains ending with the pointer `entry` to near `target`, which is
+ * `level` pointers away from the address looked for */
+static size_t follow(ptrscan_worker_t *w, const sm_ptrmap_entry_t *entry, uintptr_t target,
+                     unsigned level)
+{
+    ptrscan_job_t *job = w->job;
+    const region_t *r = rt_find(job->regions, entry->address);
+
+    w->offsets[level] = (long) (target - entry->value);
+    if (r && is_static(r))
+        return add_chain(w, entry->address, r, level + 1);
+    if (level + 1 < job->depth)
+        return search(w, entry->address, level + 1);
+    return 0;
+}
+
+static size_t search(ptrscan_worker_t *w, uintptr_t target, unsigned level)
+{
+    ptrscan_job_t *job = w->job;
+    unsigned left = job->depth - level;
+    size_t found = 0, i, last;
+
+    if (memo_failed(w, target, left))
+        return 0;
+
+    pointers_near(job, target, &i, &last);
+    for ( ; i < last && !stopped(job); i++)
+        found += follow(w, &job->map->entries[i], target, level);
+
+    if (found == 0 && !stopped(job))
+        memo_add(w, target, left);
+    return found;
+}
+
+static void *ptrscan_worker(void *arg)
+{
+    ptrscan_worker_t *w = arg;
+    ptrscan_job_t *job = w->job;
+    size_t i;
+
+    /* the pointers to the target are handed out one at a time */
+    while (!stopped(job) &&
+           (i = job->first + __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->last)
+        follow(w, &job->map->entries[i], job->target, 0);
+    return NULL;
+}
+
+/* the shortest chains first, then by where they start */
+static int compare_chains(const void *a, const void *b)
+{
+    const sm_ptrchain_t *x = a, *y = b;
+    unsigned i;
+
+    if (x->depth != y->depth)
+        return (x->depth > y->depth) ? 1 : -1;
+    if (x->base != y->base)
+        return (x->base > y->base) ? 1 : -1;
+    for (i = 0; i < x->depth; i++) {
+        if (x->offsets[i] != y->offsets[i])
+            return (x->offsets[i] > y->offsets[i]) ? 1 : -1;
+    }
+    return 0;
+}
+
+ssize_t sm_ptrscan(const sm_ptrmap_t *map, const region_table_t *regions, uintptr_t target,
+                   unsigned depth, unsigned long max_offset, size_t max_chains,
+                   const volatile bool *stop_flag, sm_ptrchain_t **chains)
+{
+    ptrscan_job_t job;
+    ptrscan_worker_t workers[MAX_PTRSCAN_WORKERS];
+    pthread_t threads[MAX_PTRSCAN_WORKERS];
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t num_workers = MIN((size_t) (ncpus > 0 ? ncpus : 1), MAX_PTRSCAN_WORKERS);
+    size_t started, i;
+
+    *chains = NULL;
+    if (depth == 0 || depth > SM_PTR_MAX_DEPTH) {
+        show_error("chains can be 1 to %d pointers long.\n", SM_PTR_MAX_DEPTH);
+        return -1;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.map = map;
+    job.regions = regions;
+    job.target = target;
+    job.depth = depth;
+    job.max_offset = max_offset;
+    job.max_chains = max_chains;
+    job.stop_flag = stop_flag;
+    pointers_near(&job, target, &job.first, &job.last);
+    pthread_mutex_init(&job.lock, NULL);
+
+    memset(workers, 0, sizeof(workers));
+    num_workers = MIN(num_workers, job.last - job.first);
+    if (num_workers == 0)
+        num_workers = 1;
+    for (i = 0; i < num_workers; i++)
+        workers[i].job = &job;
+
+    /* this thread is the first worker */
+    for (started = 1; started < num_workers; started++) {
+        if (pthread_create(&threads[started], NULL, ptrscan_worker, &workers[started]) != 0)
+            break;
+    }
+    ptrscan_worker(&workers[0]);
+    while (--started > 0)
+        pthread_join(threads[started], NULL);
+
+    for (i = 0; i < num_workers; i++)
+        free(workers[i].memo);
+    pthread_mutex_destroy(&job.lock);
+
+    if (job.failed) {
+        show_error("sorry, there was a memory allocation error.\n");
+        free(job.chains);
+        return -1;
+    }
+
+    qsort(job.chains, job.num_chains, sizeof(sm_ptrchain_t), compare_chains);
+    *chains = job.chains;
+    return (ssize_t) job.num_chains;
+}
+
+void sm_ptrscan_destroy(sm_ptrscan_t *ptrscan)
+{
+    if (ptrscan == NULL)
+        return;
+    sm_ptrmap_destroy(ptrscan->map);
+    rt_destroy(ptrscan->regions);
+    free(ptrscan->chains);
+    free(ptrscan);
+}
+
+const char *sm_ptr_module(const region_table_t *regions, const region_t *region)
+{
+    const char *name = region->filename;
+    size_t i;
+
+    /* the .bss of a module has no file name, the other regions do */
+    for (i = 0; name[0] == '\0' && i < regions->size; i++) {
+        const region_t *r = regions->regions[i];
+
+        if (r->load_addr == region->load_addr && r->filename[0] != '\0')
+            name = r->filename;
+    }
+    if (name[0] == '\0')
+        return "?";
+    return strrchr(name, '/') ? strrchr(name, '/') + 1 : name;
+}
+
+int sm_ptrchain_format(const region_table_t *regions, const sm_ptrchain_t *chain,
+                       char *buf, size_t size)
+{
+    const region_t *region = rt_get(regions, chain->region_id);
+    int len, n;
+    unsigned i;
+
+    if (region == NULL)
+        len = snprintf(buf, size, "%lx", (unsigned long) chain->base);
+    else
+        len = snprintf(buf, size, "%s+%lx", sm_ptr_module(regions, region),
+                       (unsigned long) (chain->base - region->load_addr));
+
+    for (i = 0; i < chain->depth && len >= 0; i++) {
+        long o = chain->offsets[i];
+
+        n = snprintf(buf + MIN((size_t) len, size), size - MIN((size_t) len, size),
+                     " -> %c%lx", o < 0 ? '-' : '+', (unsigned long) (o < 0 ? -o : o));
+        len = (n < 0) ? n : len + n;
+    }
+    return len;
+}
+
+bool sm_ptrchain_parse(const region_table_t *regions, const char *text, sm_ptrchain_t *chain)
+{
+    const char *arrow = strstr(text, " -> "), *plus;
+    size_t len = arrow ? (size_t) (arrow - text) : strcspn(text, " \t\r\n");
+    const region_t *region = NULL;
+    unsigned long offset;
+    char *end;
+    size_t i;
+
+    memset(chain, 0, sizeof(sm_ptrchain_t));
+
+    /* `module+offset`, the module name can have a `+` in it */
+    for (plus = text + len; plus > text && plus[-1] != '+'; plus--)
+        ;
+    if (plus == text || !isxdigit((unsigned char) *plus))
+        return false;
+    offset = strtoul(plus, &end, 0x10);
+    if (end != text + len)
+        return false;
+    for (i = 0; i < regions->size && region == NULL; i++) {
+        const region_t *r = regions->regions[i];
+        const char *module;
+        uintptr_t base = r->load_addr + offset;
+
+        if (!is_static(r) || base < r->start || base >= r->start + r->size)
+            continue;
+        module = sm_ptr_module(regions, r);
+        if (strlen(module) == (size_t) (plus - 1 - text) && strncmp(module, text, plus - 1 - text) == 0)
+            region = r;
+    }
+    if (region == NULL)
+        return false;
+    chain->base = region->load_addr + offset;
+    chain->region_id = region->id;
+
+    /* ` -> +o1 -> -o2` */
+    for (text += len; strncmp(text, " -> ", 4) == 0; text = end) {
+        char sign = text[4];
+
+        if (chain->depth == SM_PTR_MAX_DEPTH || (sign != '+' && sign != '-') ||
+            !isxdigit((unsigned char) text[5]))
+            return false;
+        offset = strtoul(text + 5, &end, 0x10);
+        chain->offsets[chain->depth++] = (sign == '-') ? -(long) offset : (long) offset;
+    }
+    return chain->depth > 0 && text[strspn(text, " \t\r\n")] == '\0';
+}
+
+bool sm_ptrchains_save(const region_table_t *regions, const sm_ptrchain_t *chains, size_t count,
+                       const char *path)
+{
+    char chain[256];
+    FILE *file;
+    size_t i;
+
+    if ((file = fopen(path, "w")) == NULL) {
+        show_error("failed to create `%s`: %s.\n", path, strerror(errno));
+        return false;
+    }
+    for (i = 0; i < count; i++) {
+        sm_ptrchain_format(regions, &chains[i], chain, sizeof(chain));
+        fprintf(file, "%s\n", chain);
+    }
+    if (ferror(file)) {
+        show_error("failed to write `%s`.\n", path);
+        fclose(file);
+        return false;
+    }
+    if (fclose(file) != 0) {
+        show_error("failed to write `%s`: %s.\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+ssize_t sm_ptrchains_load(const region_table_t *regions, const char *path, sm_ptrchain_t **chains)
+{
+    size_t count = 0, capacity = 0, skipped = 0;
+    char line[256];
+    FILE *file;
+
+    *chains = NULL;
+    if ((file = fopen(path, "r")) == NULL) {
+        show_error("failed to open `%s`: %s.\n", path, strerror(errno));
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (line[strspn(line, " \t\r\n")] == '\0' || line[0] == '#')
+            continue;
+        if (count == capacity) {
+            size_t n = capacity ? capacity * 2 : 256;
+            sm_ptrchain_t *grown;
+
+            if ((grown = realloc(*chains, n * sizeof(sm_ptrchain_t))) == NULL) {
+                show_error("sorry, there was a memory allocation error.\n");
+                fclose(file);
+                free(*chains);
+                *chains = NULL;
+                return -1;
+            }
+            *chains = grown;
+            capacity = n;
+        }
+        if (sm_ptrchain_parse(regions, line, &(*chains)[count]))
+            count++;
+        else
+            skipped++;
+    }
+    fclose(file);
+
+    if (skipped)
+        show_warn("left out %zu lines of `%s` which are not chains from a module of the target.\n",
+                  skipped, path);
+    return (ssize_t) count;
+}
+
+/* Read the words at `addresses` in as few system calls as possible, with
+ * how many bytes of each could be read in `sizes`. What cannot be read in
+ * a batch is read on its own, which is also how an image is read. */
+static void read_words(sm_reader_t *reader, const uintptr_t *addresses, uint64_t *words,
+                       size_t *sizes, size_t count)
+{
+    struct iovec local[IOV_MAX], remote[IOV_MAX];
+    size_t done = 0;
+
+    while (done < count) {
+        size_t n = MIN(count - done, IOV_MAX), i;
+        ssize_t nread = -1;
+
+        if (reader->image == NULL) {
+            for (i = 0; i < n; i++) {
+                local[i].iov_base = &words[done + i];
+                local[i].iov_len = sizeof(uint64_t);
+                remote[i].iov_base = (void *) addresses[done + i];
+                remote[i].iov_len = sizeof(uint64_t);
+            }
+            nread = process_vm_readv(reader->pid, local, n, remote, n, 0);
+        }
+        for (i = 0; i < n && nread >= (ssize_t) sizeof(uint64_t); i++, nread -= sizeof(uint64_t))
+            sizes[done + i] = sizeof(uint64_t);
+
+        /* the first word which could not be read in full */
+        if (i < n) {
+            words[done + i] = 0;
+            sizes[done + i] = sm_reader_read(reader, (uint8_t *) &words[done + i],
+                                             addresses[done + i], sizeof(uint64_t));
+            i++;
+        }
+        done += i;
+    }
+}
+
+ssize_t sm_ptrchains_check(globals_t *vars, sm_ptrchain_t *chains, size_t count,
+                           const uservalue_t *value)
+{
+    sm_reader_t *reader = &vars->reader;
+    uintptr_t *addresses, *pending;
+    uint64_t *words;
+    size_t *sizes, *index, kept = 0, i;
+    ssize_t ret = -1;
+    scan_routine_t routine;
+    unsigned level;
+    bool *ok;
+
+    if (!sm_choose_scanroutine(vars->options.scan_data_type, MATCHEQUALTO, value,
+                               vars->options.reverse_endianness)) {
+        show_error("the value cannot be of the scan_data_type, see `help option`.\n");
+        return -1;
+    }
+    routine = sm_scan_routine;
+
+    addresses = calloc(count + 1, sizeof(uintptr_t));
+    pending = calloc(count + 1, sizeof(uintptr_t));
+    words = calloc(count + 1, sizeof(uint64_t));
+    sizes = calloc(count + 1, sizeof(size_t));
+    index = calloc(count + 1, sizeof(size_t));
+    ok = calloc(count + 1, sizeof(bool));
+    if (!addresses || !pending || !words || !sizes || !index || !ok) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto out;
+    }
+    if (reader->image == NULL && sm_attach(reader->pid) == false)
+        goto out;
+    sm_reader_invalidate(reader);
+
+    for (i = 0; i < count; i++) {
+        addresses[i] = chains[i].base;
+        ok[i] = true;
+    }
+
+    /* every chain still followed is one pointer further at each level, and
+     * the chains `level` pointers long read the value they lead to */
+    for (level = 0; level <= SM_PTR_MAX_DEPTH; level++) {
+        size_t n = 0, k;
+
+        for (i = 0; i < count; i++) {
+            if (ok[i] && chains[i].depth >= level) {
+                index[n] = i;
+                pending[n++] = addresses[i];
+            }
+        }
+        if (n == 0)
+            break;
+        read_words(reader, pending, words, sizes, n);
+
+        for (k = 0; k < n; k++) {
+            sm_ptrchain_t *chain = &chains[index[k]];
+            uintptr_t pointer;
+
+            if (chain->depth == level) {
+                uint16_t saveflags = 0;
+
+                ok[index[k]] = sizes[k] > 0 &&
+                    routine((const mem64_t *) &words[k], sizes[k], NULL, value, &saveflags) > 0;
+                continue;
+            }
+            if (sizes[k] < sizeof(uintptr_t)) {
+                ok[index[k]] = false;
+                continue;
+            }
+            memcpy(&pointer, &words[k], sizeof(pointer));
+            addresses[index[k]] = pointer + chain->offsets[level];
+        }
+    }
+
+    if (reader->image == NULL)
+        sm_detach(reader->pid);
+
+    for (i = 0; i < count; i++) {
+        if (ok[i])
+            chains[kept++] = chains[i];
+    }
+    ret = (ssize_t) kept;
+
+out:
+    free(addresses);
+    free(pending);
+    free(words);
+    free(sizes);
+    free(index);
+    free(ok);
+    return ret;
+}
@@ -0,0 +1,157 @@
+/*
+    Finding chains of pointers leading to an address.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POINTER_H
+#define POINTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "maps.h"
+#include "scanmem.h"
+
+/* the longest chain looked for */
+#define SM_PTR_MAX_DEPTH 8
+
+/* an aligned word of the target holding an address inside a known region */
+typedef struct {
+    uintptr_t address;
+    uintptr_t value;
+} sm_ptrmap_entry_t;
+
+/* every pointer of the target, sorted by value, then address */
+typedef struct sm_ptrmap {
+    sm_ptrmap_entry_t *entries;
+    size_t count;
+} sm_ptrmap_t;
+
+/* The address reached from `base`, in a region of the executable or a
+ * library: the pointer stored there is followed, `offsets[0]` added, and
+ * so on for every pointer followed. */
+typedef struct {
+    uintptr_t base;
+    unsigned region_id;
+    unsigned depth;                     /* pointers followed */
+    long offsets[SM_PTR_MAX_DEPTH];
+} sm_ptrchain_t;
+
+/* the last pointer scan of a session */
+typedef struct sm_ptrscan {
+    sm_ptrmap_t *map;
+    region_table_t *regions;    /* of a map file, NULL for those of the session */
+    uintptr_t target;
+    sm_ptrchain_t *chains;
+    size_t num_chains;
+} sm_ptrscan_t;
+
+/*
+ * A map file holds a map with every address and value as an offset from
+ * the load address of its region, so that it can be searched once the
+ * target is gone, in the byte order of the host:
+ *
+ *   sm_ptrmap_header_t               at the start of the file
+ *   sm_ptrmap_region_t[num_regions]  sorted by address
+ *   names                            the file names of the regions, each
+ *                                    followed by a zero
+ *   sm_ptrmap_record_t[num_entries]  from a page boundary, sorted by value
+ */
+#define SM_PTRMAP_MAGIC "SMPTRMAP"
+
+typedef struct {
+    char magic[8];
+    uint32_t num_regions;
+    uint32_t reserved;
+    uint64_t num_entries;
+    uint64_t entries_offset;        /* of the records in the file */
+    uint64_t names_offset;
+    uint64_t names_size;
+} sm_ptrmap_header_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t size;
+    uint64_t load_addr;
+    uint64_t name_offset;           /* into the names */
+    uint32_t name_length;
+    uint32_t id;
+    uint32_t type;                  /* a region_type_t */
+    uint32_t reserved;
+} sm_ptrmap_region_t;
+
+typedef struct {
+    uint64_t address_offset;        /* from the load address of its region */
+    uint64_t value_offset;
+    uint32_t address_region;        /* the ids of the regions */
+    uint32_t value_region;
+} sm_ptrmap_record_t;
+
+/* Read every aligned word of the regions of `vars`, with the target stopped
+ * once. Returns NULL on failure or if `stop_flag` was set. */
+sm_ptrmap_t *sm_ptrmap_build(globals_t *vars);
+void sm_ptrmap_destroy(sm_ptrmap_t *map);
+
+/* save `map` of the target with `regions` to a map file at `path` */
+bool sm_ptrmap_save(const sm_ptrmap_t *map, const region_table_t *regions, const char *path);
+
+/* Map the file at `path` and read the map back, at the addresses it was
+ * saved with; its regions are added to the empty table `regions`. */
+sm_ptrmap_t *sm_ptrmap_load(const char *path, region_table_t *regions);
+
+/*
+ * Find the chains from a static region, where the executable or a library
+ * keeps its variables, to `target`: following up to `depth` pointers, with
+ * up to `max_offset` added to or taken from each. The search is spread over
+ * a thread per processor and stops once `max_chains` are found or
+ * `stop_flag` is set. The chains stored in `chains`, to be freed, are the
+ * shortest first. Returns how many, or -1.
+ */
+ssize_t sm_ptrscan(const sm_ptrmap_t *map, const region_table_t *regions, uintptr_t target,
+                   unsigned depth, unsigned long max_offset, size_t max_chains,
+                   const volatile bool *stop_flag, sm_ptrchain_t **chains);
+
+void sm_ptrscan_destroy(sm_ptrscan_t *ptrscan);
+
+/* the module a static region belongs to, the name of its file */
+const char *sm_ptr_module(const region_table_t *regions, const region_t *region);
+
+/* print `chain` as `module+offset -> +o1 -> +o2` to `buf` */
+int sm_ptrchain_format(const region_table_t *regions, const sm_ptrchain_t *chain,
+                       char *buf, size_t size);
+
+/* read a chain printed by sm_ptrchain_format(), for the modules in `regions` */
+bool sm_ptrchain_parse(const region_table_t *regions, const char *text, sm_ptrchain_t *chain);
+
+/* save `chains` to `path`, one per line */
+bool sm_ptrchains_save(const region_table_t *regions, const sm_ptrchain_t *chains, size_t count,
+                       const char *path);
+
+/* Read the chains saved at `path` into `chains`, to be freed, leaving out
+ * those of modules not in `regions`. Returns how many, or -1. */
+ssize_t sm_ptrchains_load(const region_table_t *regions, const char *path, sm_ptrchain_t **chains);
+
+/* Follow all `chains` through the target of `vars`, stopped once, reading
+ * the next pointer of every chain at a time in as few system calls as
+ * possible. Only the chains which lead to `value`, of the scan_data_type,
+ * are kept, in the same order. Returns how many, or -1. */
+ssize_t sm_ptrchains_check(globals_t *vars, sm_ptrchain_t *chains, size_t count,
+                           const uservalue_t *value);
+
+#endif /* POINTER_H */
@@ -44,6 +44,8 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
 
 // dirty hack for FreeBSD
 #if defined(__FreeBSD__) || defined(__FreeBSD_kernel__)
@@ -54,12 +56,15 @@
 #endif
 
 #include "common.h"
+#include "core.h"
+#include "layout.h"
 #include "value.h"
 #include "scanroutines.h"
 #include "scanmem.h"
 #include "show_message.h"
 #include "targetmem.h"
 #include "interrupt.h"
+#include "recorder.h"
 
 /* progress handling */
 #define NUM_DOTS (10)
@@ -70,48 +75,311 @@
 #endif
 #define SAMPLES_PER_DOT (NUM_SAMPLES / NUM_DOTS)
 #define PROGRESS_PER_SAMPLE (MAX_PROGRESS / NUM_SAMPLES)
-
-/* ptrace peek buffer, used by peekdata() as a mirror of the process memory.
- * Max size is the maximum allowed rounded VLT scan length, aka UINT16_MAX,
- * plus a `PEEKDATA_CHUNK`, to store a full extra chunk for maneuverability */
-#if HAVE_PROCMEM
-# define PEEKDATA_CHUNK 2048
-#else
-# define PEEKDATA_CHUNK sizeof(long)
-#endif
-#define MAX_PEEKBUF_SIZE ((1<<16) + PEEKDATA_CHUNK)
-static struct {
-    uint8_t cache[MAX_PEEKBUF_SIZE];  /* read from ptrace()  */
-    unsigned size;              /* amount of valid memory stored (in bytes) */
-    uintptr_t base;           /* base address of cached region */
+/* how many bytes of matches are checked between two looks at the stop flag */
+#define STOP_CHECK_BYTES (1 << 16)
+
+/* Peek cache, used by sm_peekdata() as a mirror of the process memory.
+ * It holds `PEEK_PAGES` pages, found through a hash of their address and
+ * recycled in least recently used order. Requests crossing a page boundary
+ * are copied together into `span`, which fits the maximum allowed VLT scan
+ * length, aka UINT16_MAX. Without `/proc/<pid>/mem` every word costs a
+ * ptrace() call, so pages are kept small. */
 #if HAVE_PROCMEM
-    int procmem_fd;             /* file descriptor of the opened `/proc/<pid>/mem` file */
+# define PEEK_PAGE_SIZE 4096
 #else
-    pid_t pid;                  /* pid of scanned process */
+# define PEEK_PAGE_SIZE (8 * sizeof(long))
 #endif
-} peekbuf;
+#define PEEK_PAGES 64
+#define PEEK_BUCKETS 128            /* must be a power of 2 */
+/* larger sm_read_array() requests bypass the cache, not to flush it */
+#define MAX_CACHED_READ (PEEK_PAGES / 4 * PEEK_PAGE_SIZE)
+
+struct sm_peekpage {
+    uintptr_t base;             /* address of the page */
+    unsigned size;              /* amount of valid memory stored, 0 if unused */
+    int hash_next;              /* next page in the same bucket, or -1 */
+    int lru_prev, lru_next;     /* neighbours in the LRU list, or -1 */
+    uint8_t data[PEEK_PAGE_SIZE];
+};
+
+struct sm_peekbuf {
+    struct sm_peekpage pages[PEEK_PAGES];
+    int buckets[PEEK_BUCKETS];  /* first page of each bucket, or -1 */
+    int lru_first, lru_last;    /* most and least recently used pages */
+    int last;                   /* page of the last lookup, or -1 */
+    uint8_t span[UINT16_MAX];
+};
+
+
+/* Threads stopped by sm_attach() when `stop_all_threads` is set.
+ * Every thread is seized with PTRACE_SEIZE and stopped with PTRACE_INTERRUPT,
+ * a signal which stopped a thread instead of the interrupt is kept in `sig`,
+ * so that it can be delivered again when the thread is detached.
+ * ptrace() ties tracees to the thread which attached them, so this is kept
+ * per thread and group workers can attach to their own targets. */
+static __thread struct {
+    struct {
+        pid_t tid;
+        int sig;
+    } *threads;
+    size_t count;
+    size_t capacity;
+    struct timespec attach_time;    /* when sm_attach() started stopping */
+    double stop_time;           /* milliseconds spent stopping the target */
+    double pause_time;          /* milliseconds the target stayed stopped */
+} stopped;
+
+/* Set in threads scanning on behalf of a process group (see group.c): the
+ * dispatching thread owns the SIGINT handler, and progress output is left
+ * out as it would interleave with the other workers. */
+static __thread bool scan_worker;
+
+/* Set while sm_searchnewregions() searches: only the regions flagged as
+ * unscanned are searched, and the matches found are only a part of the
+ * final ones. */
+static __thread bool partial_scan;
+
+/* Set while sm_searchnear() or sm_checknear() scan: the places matching
+ * either value are only matches with the other value near them. */
+static __thread const sm_proximity_t *proximity;
+
+/* Set while sm_searchlayout() searches: a match is a place where the whole
+ * structure fits, recorded at its first field. */
+static __thread const sm_layout_t *layout_scan;
+
+void sm_set_scan_worker(bool worker)
+{
+    scan_worker = worker;
+}
+
+static inline double elapsed_ms(const struct timespec *from, const struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000.0 + (to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+#ifdef PTRACE_SEIZE
+static bool thread_is_stopped(pid_t tid)
+{
+    size_t i;
+
+    for (i = 0; i < stopped.count; i++) {
+        if (stopped.threads[i].tid == tid)
+            return true;
+    }
+    return false;
+}
+
+static void detach_all_threads(void)
+{
+    size_t i;
+
+    for (i = 0; i < stopped.count; i++)
+        (void) ptrace(PTRACE_DETACH, stopped.threads[i].tid, 1, stopped.threads[i].sig);
+    stopped.count = 0;
+}
+
+/* Seize and interrupt every thread listed in /proc/<pid>/task */
+static bool attach_all_threads(pid_t target)
+{
+    char task_path[32];
+    bool found_new;
+    size_t i;
+
+    snprintf(task_path, sizeof(task_path), "/proc/%d/task", target);
+    stopped.count = 0;
 
+    /* the threads still running can create new ones while we are busy
+     * seizing them, so rescan the task directory until it stays stable */
+    do {
+        DIR *task_dir;
+        struct dirent *entry;
+
+        found_new = false;
+        if ((task_dir = opendir(task_path)) == NULL) {
+            show_error("failed to open %s, %s\n", task_path, strerror(errno));
+            goto fail;
+        }
+
+        while ((entry = readdir(task_dir)) != NULL) {
+            char *end;
+            pid_t tid = (pid_t) strtol(entry->d_name, &end, 10);
+
+            /* skip `.`, `..` and threads we already hold */
+            if (*end != '\0' || tid <= 0 || thread_is_stopped(tid))
+                continue;
+
+            if (ptrace(PTRACE_SEIZE, tid, NULL, NULL) == -1L) {
+                /* the thread exited in the meantime */
+                if (errno == ESRCH)
+                    continue;
+                show_error("failed to seize thread %d, %s\n", tid, strerror(errno));
+                closedir(task_dir);
+                goto fail;
+            }
+
+            if (stopped.count == stopped.capacity) {
+                size_t capacity = stopped.capacity ? stopped.capacity * 2 : 16;
+                void *threads = realloc(stopped.threads, capacity * sizeof(*stopped.threads));
+                if (threads == NULL) {
+                    show_error("sorry, there was a memory allocation error.\n");
+                    (void) ptrace(PTRACE_DETACH, tid, 1, 0);
+                    closedir(task_dir);
+                    goto fail;
+                }
+                stopped.threads = threads;
+                stopped.capacity = capacity;
+            }
+            stopped.threads[stopped.count].tid = tid;
+            stopped.threads[stopped.count].sig = 0;
+            stopped.count++;
+            found_new = true;
+
+            if (ptrace(PTRACE_INTERRUPT, tid, NULL, NULL) == -1L && errno != ESRCH) {
+                show_error("failed to interrupt thread %d, %s\n", tid, strerror(errno));
+                closedir(task_dir);
+                goto fail;
+            }
+        }
+        closedir(task_dir);
+    } while (found_new);
+
+    /* wait for every thread to stop */
+    for (i = 0; i < stopped.count; ) {
+        int status;
+        pid_t tid = stopped.threads[i].tid;
+
+        if (waitpid(tid, &status, __WALL) == -1 || WIFEXITED(status) || WIFSIGNALED(status)) {
+            /* the thread is gone, forget about it */
+            stopped.threads[i] = stopped.threads[--stopped.count];
+            continue;
+        }
+        if (!WIFSTOPPED(status)) {
+            show_error("there was an error waiting for thread %d to stop.\n", tid);
+            goto fail;
+        }
+        /* a signal arrived before the interrupt, deliver it on detach */
+        if ((status >> 16) != PTRACE_EVENT_STOP)
+            stopped.threads[i].sig = WSTOPSIG(status);
+        i++;
+    }
+
+    if (stopped.count == 0) {
+        show_error("failed to attach to %d, no threads left.\n", target);
+        return false;
+    }
+
+    return true;
+
+fail:
+    detach_all_threads();
+    return false;
+}
+#endif
 
 bool sm_attach(pid_t target)
 {
     int status;
+    struct timespec stop_end;
 
-    /* attach to the target application, which should cause a SIGSTOP */
-    if (ptrace(PTRACE_ATTACH, target, NULL, NULL) == -1L) {
-        show_error("failed to attach to %d, %s\n", target, strerror(errno));
+    clock_gettime(CLOCK_MONOTONIC, &stopped.attach_time);
+
+    if (sm_globals.options.stop_all_threads) {
+#ifdef PTRACE_SEIZE
+        if (!attach_all_threads(target))
+            return false;
+#else
+        show_error("stopping all threads is not supported on this system.\n");
         return false;
+#endif
+    } else {
+        /* attach to the target application, which should cause a SIGSTOP */
+        if (ptrace(PTRACE_ATTACH, target, NULL, NULL) == -1L) {
+            show_error("failed to attach to %d, %s\n", target, strerror(errno));
+            return false;
+        }
+
+        /* wait for the SIGSTOP to take place. */
+        if (waitpid(target, &status, 0) == -1 || !WIFSTOPPED(status)) {
+            show_error("there was an error waiting for the target to stop.\n");
+            show_info("%s\n", strerror(errno));
+            return false;
+        }
     }
 
-    /* wait for the SIGSTOP to take place. */
-    if (waitpid(target, &status, 0) == -1 || !WIFSTOPPED(status)) {
-        show_error("there was an error waiting for the target to stop.\n");
-        show_info("%s\n", strerror(errno));
-        return false;
+    clock_gettime(CLOCK_MONOTONIC, &stop_end);
+    stopped.stop_time = elapsed_ms(&stopped.attach_time, &stop_end);
+
+    /* everything looks okay */
+    return true;
+
+}
+
+bool sm_detach(pid_t target)
+{
+    struct timespec detach_time;
+
+    clock_gettime(CLOCK_MONOTONIC, &detach_time);
+    stopped.pause_time = elapsed_ms(&stopped.attach_time, &detach_time);
+
+#ifdef PTRACE_SEIZE
+    if (stopped.count > 0) {
+        detach_all_threads();
+        return true;
     }
+#endif
+
+    /* addr is ignored on Linux, but should be 1 on FreeBSD in order to let
+     * the child process continue execution where it had been interrupted */
+    return ptrace(PTRACE_DETACH, target, 1, 0) == 0;
+}
+
+/* report how long the last sm_attach() took to stop the target */
+static void report_stop_time(globals_t *vars)
+{
+    if (vars->options.stop_all_threads)
+        show_info("stopped %zu threads in %.3f ms.\n", stopped.count, stopped.stop_time);
+    else
+        show_debug("stopped the target in %.3f ms.\n", stopped.stop_time);
+}
+
+/* report how long the target stayed stopped, call after sm_detach() */
+static void report_pause_time(globals_t *vars)
+{
+    if (vars->options.stop_all_threads || vars->options.stop_copy)
+        show_info("target was paused for %.3f ms.\n", stopped.pause_time);
+    else
+        show_debug("target was paused for %.3f ms.\n", stopped.pause_time);
+}
+
+/* stop the target of `reader` for reading, nothing to do for an image */
+static bool stop_target(globals_t *vars, sm_reader_t *reader)
+{
+    if (reader->image)
+        return true;
+    if (sm_attach(reader->pid) == false)
+        return false;
+    report_stop_time(vars);
+    return true;
+}
 
-    /* reset the peek buffer */
-    peekbuf.size = 0;
-    peekbuf.base = NULL;
+static bool resume_target(globals_t *vars, sm_reader_t *reader)
+{
+    if (reader->image)
+        return true;
+    if (sm_detach(reader->pid) == false)
+        return false;
+    report_pause_time(vars);
+    return true;
+}
+
+
+bool sm_reader_open(sm_reader_t *reader, pid_t target)
+{
+    reader->pid = target;
+    reader->procmem_fd = -1;
+    reader->peekbuf = NULL;
+    reader->image = NULL;
+    memset(&reader->stats, 0, sizeof(reader->stats));
 
 #if HAVE_PROCMEM
     { /* open the `/proc/<pid>/mem` file */
@@ -126,47 +394,160 @@ bool sm_attach(pid_t target)
             show_error("unable to open %s.\n", mem);
             return false;
         }
-        peekbuf.procmem_fd = fd;
+        reader->procmem_fd = fd;
     }
-#else
-    peekbuf.pid = target;
 #endif
 
-    /* everything looks okay */
     return true;
+}
 
+void sm_reader_open_image(sm_reader_t *reader, struct sm_image *image)
+{
+    reader->pid = 0;
+    reader->procmem_fd = -1;
+    reader->peekbuf = NULL;
+    reader->image = image;
+    memset(&reader->stats, 0, sizeof(reader->stats));
 }
 
-bool sm_detach(pid_t target)
+void sm_reader_close(sm_reader_t *reader)
 {
-#if HAVE_PROCMEM
-    /* close the mem file before detaching */
-    close(peekbuf.procmem_fd);
-#endif
+    if (reader->procmem_fd != -1)
+        close(reader->procmem_fd);
+    free(reader->peekbuf);
+    reader->procmem_fd = -1;
+    reader->peekbuf = NULL;
+    reader->image = NULL;
+    reader->pid = 0;
+}
 
-    /* addr is ignored on Linux, but should be 1 on FreeBSD in order to let
-     * the child process continue execution where it had been interrupted */
-    return ptrace(PTRACE_DETACH, target, 1, 0) == 0;
+static void peekbuf_reset(struct sm_peekbuf *peekbuf)
+{
+    int i;
+
+    for (i = 0; i < PEEK_BUCKETS; i++)
+        peekbuf->buckets[i] = -1;
+
+    /* every page is unused, in any LRU order */
+    for (i = 0; i < PEEK_PAGES; i++) {
+        peekbuf->pages[i].base = 0;
+        peekbuf->pages[i].size = 0;
+        peekbuf->pages[i].hash_next = -1;
+        peekbuf->pages[i].lru_prev = i - 1;
+        peekbuf->pages[i].lru_next = (i + 1 < PEEK_PAGES) ? i + 1 : -1;
+    }
+    peekbuf->lru_first = 0;
+    peekbuf->lru_last = PEEK_PAGES - 1;
+    peekbuf->last = -1;
 }
 
+/* forget the cached memory, needed whenever the target ran since the last read */
+void sm_reader_invalidate(sm_reader_t *reader)
+{
+    if (reader->peekbuf)
+        peekbuf_reset(reader->peekbuf);
+}
+
+static inline unsigned peek_bucket(uintptr_t base)
+{
+    return (base / PEEK_PAGE_SIZE) & (PEEK_BUCKETS - 1);
+}
+
+/* make page `i` the most recently used one */
+static inline void peek_touch(struct sm_peekbuf *peekbuf, int i)
+{
+    struct sm_peekpage *page = &peekbuf->pages[i];
+
+    if (peekbuf->lru_first == i)
+        return;
+
+    /* unlink, the page has a predecessor as it is not the first one */
+    peekbuf->pages[page->lru_prev].lru_next = page->lru_next;
+    if (page->lru_next != -1)
+        peekbuf->pages[page->lru_next].lru_prev = page->lru_prev;
+    else
+        peekbuf->lru_last = page->lru_prev;
+
+    /* and put it in front */
+    page->lru_prev = -1;
+    page->lru_next = peekbuf->lru_first;
+    peekbuf->pages[peekbuf->lru_first].lru_prev = i;
+    peekbuf->lru_first = i;
+}
+
+static inline size_t readmemory(sm_reader_t *reader, uint8_t *dest_buffer, const uintptr_t target_address, size_t size);
+
+/* Get the page at `base` from the cache, reading it on a miss.
+ * Returns NULL if nothing could be read there. */
+static struct sm_peekpage *peek_page(sm_reader_t *reader, uintptr_t base, bool *miss)
+{
+    struct sm_peekbuf *peekbuf = reader->peekbuf;
+    struct sm_peekpage *page;
+    int *link;
+    int i;
+
+    /* most lookups are for the same page as the previous one */
+    if (LIKELY(peekbuf->last != -1 && peekbuf->pages[peekbuf->last].base == base))
+        return &peekbuf->pages[peekbuf->last];
+
+    for (i = peekbuf->buckets[peek_bucket(base)]; i != -1; i = peekbuf->pages[i].hash_next) {
+        if (peekbuf->pages[i].base == base) {
+            peek_touch(peekbuf, i);
+            peekbuf->last = i;
+            return &peekbuf->pages[i];
+        }
+    }
+
+    /* recycle the least recently used page */
+    *miss = true;
+    i = peekbuf->lru_last;
+    page = &peekbuf->pages[i];
+    if (page->size != 0) {
+        for (link = &peekbuf->buckets[peek_bucket(page->base)]; *link != i; )
+            link = &peekbuf->pages[*link].hash_next;
+        *link = page->hash_next;
+        page->size = 0;
+        page->base = 0;
+        if (peekbuf->last == i)
+            peekbuf->last = -1;
+    }
+
+    if ((page->size = readmemory(reader, page->data, base, PEEK_PAGE_SIZE)) == 0)
+        return NULL;
+
+    page->base = base;
+    page->hash_next = peekbuf->buckets[peek_bucket(base)];
+    peekbuf->buckets[peek_bucket(base)] = i;
+    peek_touch(peekbuf, i);
+    peekbuf->last = i;
+    return page;
+}
 
 /* Reads data from the target process, and places it on the `dest_buffer`
- * using either `ptrace` or `pread` on `/proc/pid/mem`.
- * The target process is not passed, but read from the static peekbuf.
+ * using either `ptrace` or `pread` on `/proc/pid/mem`, or from the image
+ * the reader was opened on.
  * `sm_attach()` MUST be called before this function. */
-static inline size_t readmemory(uint8_t *dest_buffer, const uintptr_t target_address, size_t size)
+static inline size_t readmemory(sm_reader_t *reader, uint8_t *dest_buffer, const uintptr_t target_address, size_t size)
 {
     size_t nread = 0;
 
+    if (reader->image) {
+        nread = sm_image_read(reader->image, dest_buffer, target_address, size);
+        reader->stats.reads++;
+        reader->stats.bytes_read += nread;
+        return nread;
+    }
+
 #if HAVE_PROCMEM
     do {
-        ssize_t ret = pread(peekbuf.procmem_fd,
+        ssize_t ret = pread(reader->procmem_fd,
                             dest_buffer + nread,
                             size - nread,
                             target_address + nread);
+        reader->stats.reads++;
         if (ret == -1) {
             /* we can't read further, report what was read */
-            return nread;
+            break;
         }
         else {
             /* some data was read */
@@ -180,7 +561,8 @@ static inline size_t readmemory(uint8_t *dest_buffer, const uintptr_t target_add
     errno = 0;
     for (nread = 0; nread < size; nread += sizeof(long)) {
         const char *ptrace_address = target_address + nread;
-        long ptraced_long = ptrace(PTRACE_PEEKDATA, peekbuf.pid, ptrace_address, NULL);
+        long ptraced_long = ptrace(PTRACE_PEEKDATA, reader->pid, ptrace_address, NULL);
+        reader->stats.reads++;
 
         /* check if ptrace() succeeded */
         if (UNLIKELY(ptraced_long == -1L && errno != 0)) {
@@ -190,7 +572,7 @@ static inline size_t readmemory(uint8_t *dest_buffer, const uintptr_t target_add
                 /* read backwards until we get a good read, then shift out the right value */
                 for (j = 1, errno = 0; j < sizeof(long); j++, errno = 0) {
                     /* try for a shifted ptrace - 'continue' (i.e. try an increased shift) if it fails */
-                    ptraced_long = ptrace(PTRACE_PEEKDATA, peekbuf.pid, ptrace_address - j, NULL);
+                    ptraced_long = ptrace(PTRACE_PEEKDATA, reader->pid, ptrace_address - j, NULL);
                     if ((ptraced_long == -1L) && (errno == EIO || errno == EFAULT))
                         continue;
 
@@ -210,102 +592,126 @@ static inline size_t readmemory(uint8_t *dest_buffer, const uintptr_t target_add
         memcpy(dest_buffer + nread, &ptraced_long, sizeof(long));
     }
 #endif
+    reader->stats.bytes_read += nread;
     return nread;
 }
 
+size_t sm_reader_read(sm_reader_t *reader, uint8_t *dest_buffer, uintptr_t target_address, size_t size)
+{
+    return readmemory(reader, dest_buffer, target_address, size);
+}
+
 /*
- * sm_peekdata - fills the peekbuf cache with memory from the process
+ * sm_peekdata - gets memory of the process through the reader's peek cache
  * 
- * This routine calls either `ptrace(PEEKDATA, ...)` or `pread(...)`,
- * and fills the peekbuf cache, to make a local mirror of the process memory we're interested in.
+ * This routine calls either `ptrace(PEEKDATA, ...)` or `pread(...)` for the
+ * pages which are not cached yet, to make a local mirror of the process memory
+ * we're interested in. At least `length` bytes are returned in `*result_ptr`,
+ * unless the memory ends before. The result is valid until the next call.
  * `sm_attach()` MUST be called before this function.
  */
 
-extern inline bool sm_peekdata(const uintptr_t addr, uint16_t length, const mem64_t **result_ptr, size_t *memlength)
+extern inline bool sm_peekdata(sm_reader_t *reader, const uintptr_t addr, uint16_t length, const mem64_t **result_ptr, size_t *memlength)
 {
-    const uintptr_t reqaddr = addr;
-    unsigned int i;
-    uintptr_t missing_bytes;
+    uintptr_t base = addr - addr % PEEK_PAGE_SIZE;
+    const unsigned offset = addr - base;
+    struct sm_peekbuf *peekbuf = reader->peekbuf;
+    struct sm_peekpage *page;
+    bool miss = false;
+    size_t n;
 
-    assert(peekbuf.size <= MAX_PEEKBUF_SIZE);
     assert(result_ptr != NULL);
     assert(memlength != NULL);
 
-    /* check if we have a full cache hit */
-    if (peekbuf.base != NULL &&
-        reqaddr >= peekbuf.base &&
-        (unsigned long) (reqaddr + length - peekbuf.base) <= peekbuf.size)
-    {
-        *result_ptr = (mem64_t*)&peekbuf.cache[reqaddr - peekbuf.base];
-        *memlength = peekbuf.base - reqaddr + peekbuf.size;
-        return true;
-    }
-    else if (peekbuf.base != NULL &&
-             reqaddr >= peekbuf.base &&
-             (unsigned long) (reqaddr - peekbuf.base) < peekbuf.size)
-    {
-        assert(peekbuf.size != 0);
-
-        /* partial hit, we have some of the data but not all, so remove old entries - shift the frame by as far as is necessary */
-        missing_bytes = (reqaddr + length) - (peekbuf.base + peekbuf.size);
-        /* round up to the nearest PEEKDATA_CHUNK multiple, that is what could
-         * potentially be read and we have to fit it all */
-        missing_bytes = PEEKDATA_CHUNK * (1 + (missing_bytes-1) / PEEKDATA_CHUNK);
-
-        /* head shift if necessary */
-        if (peekbuf.size + missing_bytes > MAX_PEEKBUF_SIZE)
-        {
-            uintptr_t shift_size = reqaddr - peekbuf.base;
-            shift_size = PEEKDATA_CHUNK * (shift_size / PEEKDATA_CHUNK);
-
-            memmove(peekbuf.cache, &peekbuf.cache[shift_size], peekbuf.size-shift_size);
-
-            peekbuf.size -= shift_size;
-            peekbuf.base += shift_size;
+    if (UNLIKELY(peekbuf == NULL)) {
+        if ((peekbuf = reader->peekbuf = malloc(sizeof(struct sm_peekbuf))) == NULL) {
+            show_error("sorry, there was a memory allocation error.\n");
+            return false;
         }
+        peekbuf_reset(peekbuf);
     }
-    else {
-        /* cache miss, invalidate the cache */
-        missing_bytes = length;
-        peekbuf.size = 0;
-        peekbuf.base = reqaddr;
+
+    page = peek_page(reader, base, &miss);
+    if (UNLIKELY(page == NULL || page->size <= offset)) {
+        /* hard failure to retrieve memory */
+        reader->stats.cache_misses++;
+        *result_ptr = NULL;
+        *memlength = 0;
+        return false;
     }
 
-    /* we need to retrieve memory to complete the request */
-    for (i = 0; i < missing_bytes; i += PEEKDATA_CHUNK)
-    {
-        const uintptr_t target_address = peekbuf.base + peekbuf.size;
-        size_t len = readmemory(&peekbuf.cache[peekbuf.size], target_address, PEEKDATA_CHUNK);
-
-        /* check if the read succeeded */
-        if (UNLIKELY(len < PEEKDATA_CHUNK)) {
-            if (len == 0) {
-                /* hard failure to retrieve memory */
-                *result_ptr = NULL;
-                *memlength = 0;
-                return false;
-            }
-            /* go ahead with the partial read and stop the gathering process */
-            peekbuf.size += len;
-            break;
+    if (LIKELY(offset + length <= page->size || page->size < PEEK_PAGE_SIZE)) {
+        /* the page has it all, or all there is */
+        *result_ptr = (mem64_t*)&page->data[offset];
+        *memlength = page->size - offset;
+    } else {
+        /* gather the request from the following pages */
+        n = page->size - offset;
+        memcpy(peekbuf->span, &page->data[offset], n);
+        while (n < length) {
+            size_t len;
+
+            base += PEEK_PAGE_SIZE;
+            if ((page = peek_page(reader, base, &miss)) == NULL)
+                break;  /* go ahead with the partial read */
+            len = MIN(page->size, length - n);
+            memcpy(&peekbuf->span[n], page->data, len);
+            n += len;
+            if (page->size < PEEK_PAGE_SIZE)
+                break;
         }
-        
-        /* otherwise, the read worked */
-        peekbuf.size += PEEKDATA_CHUNK;
+        *result_ptr = (mem64_t*)peekbuf->span;
+        *memlength = n;
     }
 
-    /* return result to caller */
-    *result_ptr = (mem64_t*)&peekbuf.cache[reqaddr - peekbuf.base];
-    *memlength = peekbuf.base - reqaddr + peekbuf.size;
+    if (miss)
+        reader->stats.cache_misses++;
+    else
+        reader->stats.cache_hits++;
     return true;
 }
 
+/* report the I/O statistics of a reader, accumulated since it was opened */
+static void report_reader_stats(const sm_reader_t *reader)
+{
+    show_debug("reader: %lu reads, %lu bytes, %lu cache hits, %lu cache misses.\n",
+               reader->stats.reads, reader->stats.bytes_read,
+               reader->stats.cache_hits, reader->stats.cache_misses);
+}
+
+static void report_matches(const globals_t *vars)
+{
+    if (scan_worker || partial_scan)
+        show_debug("%d: %ld matches.\n", vars->target, vars->num_matches);
+    else
+        show_info("we currently have %ld matches.\n", vars->num_matches);
+}
+
+/* append the matches left by a scan to the recording, if there is one */
+static void record_matches(const globals_t *vars, scan_match_type_t match_type)
+{
+    /* a snapshot has every byte as a match, but no value to speak of yet */
+    if (vars->recorder == NULL || scan_worker || partial_scan || match_type == MATCHANY)
+        return;
+    if (!sm_recorder_append(vars->recorder, vars))
+        show_warn("this scan is missing from the recording.\n");
+}
+
 static inline void print_a_dot(void)
 {
+    if (scan_worker)
+        return;
     fprintf(stderr, ".");
     fflush(stderr);
 }
 
+/* let the front end follow the scan, see sm_scan_async() */
+static inline void report_progress(globals_t *vars)
+{
+    if (vars->progress_hook)
+        vars->progress_hook();
+}
+
 static inline uint16_t flags_to_memlength(scan_data_type_t scan_data_type, uint16_t flags)
 {
     switch(scan_data_type)
@@ -324,9 +730,181 @@ static inline uint16_t flags_to_memlength(scan_data_type_t scan_data_type, uint1
     }
 }
 
+/* A place matching one of the values of a proximity scan. The places found
+ * are kept in address order until no place found later can be near them. */
+#define NEAR_A 1
+#define NEAR_B 2
+
+typedef struct {
+    uintptr_t address;
+    mem64_t value;
+    uint16_t flags;
+    uint8_t length;
+    uint8_t kinds;              /* NEAR_A, NEAR_B or both */
+    bool paired;                /* the other value was found near it */
+} near_hit_t;
+
+typedef struct {
+    scan_routine_t routines[2];
+    near_hit_t *hits;           /* a ring of `capacity` */
+    size_t head, count, capacity;
+    near_hit_t last;            /* the last match, its bytes after the first */
+    uintptr_t next;             /* are recorded up to the next match */
+    unsigned extra;
+} near_scan_t;
+
+/* the routines for both values, sm_scan_routine is left to the first one */
+static bool near_routines(const globals_t *vars, scan_routine_t routines[2])
+{
+    int k;
+
+    for (k = 1; k >= 0; k--) {
+        if (!sm_choose_scanroutine(vars->options.scan_data_type, proximity->match_type[k],
+                                   proximity->values[k], vars->options.reverse_endianness))
+            return false;
+        routines[k] = sm_scan_routine;
+    }
+    return true;
+}
+
+/* which values match at `memory_ptr`, with their flags and widest length */
+static inline uint8_t near_kinds(const scan_routine_t routines[2], const mem64_t *memory_ptr,
+                                 size_t memlength, uint16_t *flags, unsigned *length)
+{
+    uint8_t kinds = 0;
+    int k;
+
+    *flags = flags_empty;
+    *length = 0;
+    for (k = 0; k < 2; k++) {
+        uint16_t saveflags = flags_empty;
+        unsigned l = routines[k](memory_ptr, memlength, NULL, proximity->values[k], &saveflags);
+
+        if (l > 0) {
+            kinds |= (k == 0) ? NEAR_A : NEAR_B;
+            *flags |= saveflags;
+            if (l > *length)
+                *length = l;
+        }
+    }
+    return kinds;
+}
+
+static inline bool near_partners(uint8_t a, uint8_t b)
+{
+    return ((a & NEAR_A) && (b & NEAR_B)) || ((a & NEAR_B) && (b & NEAR_A));
+}
+
+static void near_record(globals_t *vars, swath_t **swath, near_scan_t *scan, const near_hit_t *hit)
+{
+    /* the bytes after the previous match, up to this one */
+    for ( ; scan->extra > 0 && (hit == NULL || scan->next < hit->address); scan->extra--, scan->next++)
+        *swath = matches__add_element(&vars->matches, *swath, scan->next,
+                                      scan->last.value.bytes[scan->next - scan->last.address],
+                                      flags_empty);
+    if (hit == NULL)
+        return;
+
+    *swath = matches__add_element(&vars->matches, *swath, hit->address, hit->value.bytes[0],
+                                  hit->flags);
+    ++vars->num_matches;
+    scan->last = *hit;
+    scan->next = hit->address + 1;
+    scan->extra = hit->length - 1;
+}
+
+/* Record or drop the places found before `address` which nothing can be
+ * near anymore, or all of them without an address. */
+static void near_settle(globals_t *vars, swath_t **swath, near_scan_t *scan, const uintptr_t *address)
+{
+    while (scan->count > 0) {
+        const near_hit_t *hit = &scan->hits[scan->head];
+
+        if (address && hit->address + proximity->window >= *address)
+            break;
+        if (hit->paired)
+            near_record(vars, swath, scan, hit);
+        scan->head = (scan->head + 1) % scan->capacity;
+        scan->count--;
+    }
+    if (address == NULL)
+        near_record(vars, swath, scan, NULL);
+}
+
+static void near_step(globals_t *vars, swath_t **swath, near_scan_t *scan, uintptr_t address,
+                      const mem64_t *memory_ptr, size_t memlength)
+{
+    near_hit_t *hit;
+    uint16_t flags;
+    unsigned length;
+    uint8_t kinds = near_kinds(scan->routines, memory_ptr, memlength, &flags, &length);
+    size_t i;
+
+    near_settle(vars, swath, scan, &address);
+    if (kinds == 0)
+        return;
+
+    /* everything left is near enough */
+    hit = &scan->hits[(scan->head + scan->count) % scan->capacity];
+    memset(hit, 0, sizeof(near_hit_t));
+    for (i = 0; i < scan->count; i++) {
+        near_hit_t *other = &scan->hits[(scan->head + i) % scan->capacity];
+
+        if (near_partners(other->kinds, kinds))
+            other->paired = hit->paired = true;
+    }
+    hit->address = address;
+    memcpy(hit->value.bytes, memory_ptr->bytes, MIN(memlength, sizeof(mem64_t)));
+    hit->flags = flags;
+    hit->length = length;
+    hit->kinds = kinds;
+    scan->count++;
+}
+
+/* Whether the match at `address` has one value, with the other one near
+ * it. `*memory_ptr` is read again, the peek cache is used on the way. */
+static unsigned near_check(sm_reader_t *reader, const scan_routine_t routines[2], uintptr_t address,
+                           const mem64_t **memory_ptr, size_t *memlength, uint16_t *checkflags)
+{
+    const size_t window = proximity->window;
+    const mem64_t *around;
+    uintptr_t lo, q;
+    size_t avail, want;
+    uint16_t flags;
+    unsigned length, l;
+    uint8_t kinds = near_kinds(routines, *memory_ptr, *memlength, checkflags, &length);
+    bool found = false;
+
+    if (kinds == 0)
+        return 0;
+
+    /* from `window` bytes before, or the first readable page after that */
+    for (lo = (address > window) ? address - window : 0; ; lo = (lo | (PEEK_PAGE_SIZE - 1)) + 1) {
+        if (lo > address)
+            lo = address;
+        want = address + window - lo + sizeof(mem64_t);
+        if (sm_peekdata(reader, lo, want, &around, &avail))
+            break;
+        if (lo == address)
+            return 0;
+    }
+
+    for (q = lo; q < lo + avail && q <= address + window && !found; q++) {
+        if (q == address)
+            continue;
+        found = near_partners(kinds, near_kinds(routines, (const mem64_t *) ((const uint8_t *) around + (q - lo)),
+                                                lo + avail - q, &flags, &l));
+    }
+
+    if (!sm_peekdata(reader, address, length, memory_ptr, memlength))
+        return 0;
+    return found ? length : 0;
+}
+
 /* This is the function that handles when you enter a value (or >, <, =) for the second or later time (i.e. when there's already a list of matches);
  * it reduces the list to those that still match. It returns false on failure to attach, detach, or reallocate memory, otherwise true. */
 bool sm_checkmatches(globals_t *vars,
+                     sm_reader_t *reader,
                      scan_match_type_t match_type,
                      const uservalue_t *uservalue)
 {
@@ -341,7 +919,10 @@ bool sm_checkmatches(globals_t *vars,
     size_t bytes_at_next_sample;
     size_t bytes_per_sample;
 
-    if (sm_choose_scanroutine(vars->options.scan_data_type, match_type, uservalue, vars->options.reverse_endianness) == false)
+    scan_routine_t near[2];
+
+    if (proximity ? !near_routines(vars, near) :
+        sm_choose_scanroutine(vars->options.scan_data_type, match_type, uservalue, vars->options.reverse_endianness) == false)
     {
         show_error("unsupported scan for current data type.\n");
         return false;
@@ -370,10 +951,12 @@ bool sm_checkmatches(globals_t *vars,
     vars->stop_flag = false;
 
     /* stop and attach to the target */
-    if (sm_attach(vars->target) == false)
+    if (stop_target(vars, reader) == false)
         return false;
+    sm_reader_invalidate(reader);
 
-    INTERRUPTABLESCAN();
+    if (!scan_worker)
+        INTERRUPTABLESCAN();
 
     while (reading_swath.first_byte_in_child) {
         unsigned int match_length = 0;
@@ -386,7 +969,7 @@ bool sm_checkmatches(globals_t *vars,
         uintptr_t address = reading_swath.first_byte_in_child + reading_iterator;
 
         /* read value from this address */
-        if (UNLIKELY(sm_peekdata((void *) address, old_length, &memory_ptr, &memlength) == false))
+        if (UNLIKELY(sm_peekdata(reader, address, old_length, &memory_ptr, &memlength) == false))
         {
             /* If we can't look at the data here, just abort the whole recording, something bad happened */
             required_extra_bytes_to_record = 0;
@@ -398,7 +981,10 @@ bool sm_checkmatches(globals_t *vars,
 
             checkflags = flags_empty;
 
-            match_length = (*sm_scan_routine)(memory_ptr, memlength, &old_val, uservalue, &checkflags);
+            if (proximity)
+                match_length = near_check(reader, near, address, &memory_ptr, &memlength, &checkflags);
+            else
+                match_length = (*sm_scan_routine)(memory_ptr, memlength, &old_val, uservalue, &checkflags);
         }
 
         if (match_length > 0)
@@ -436,11 +1022,15 @@ bool sm_checkmatches(globals_t *vars,
                     /* for user, just print a dot */
                     print_a_dot();
                 }
-                /* stop scanning if asked to */
-                if (vars->stop_flag) {
+            }
+        }
+        /* stop scanning if asked to, without waiting long for the next sample */
+        if (UNLIKELY((bytes_scanned % STOP_CHECK_BYTES) == 0)) {
+            report_progress(vars);
+            if (vars->stop_flag) {
+                if (!scan_worker)
                     printf("\n");
-                    break;
-                }
+                break;
             }
         }
         ++bytes_scanned;
@@ -457,7 +1047,8 @@ bool sm_checkmatches(globals_t *vars,
         }
     }
 
-    ENDINTERRUPTABLE();
+    if (!scan_worker)
+        ENDINTERRUPTABLE();
 
     if (!(vars->matches = matches__null_terminate(vars->matches, writing_swath_index)))
     {
@@ -465,58 +1056,331 @@ bool sm_checkmatches(globals_t *vars,
         return false;
     }
 
-    show_user("ok\n");
+    if (!scan_worker)
+        show_user("ok\n");
 
     /* tell front-end we've done */
     vars->scan_progress = MAX_PROGRESS;
 
-    show_info("we currently have %ld matches.\n", vars->num_matches);
+    report_matches(vars);
+    record_matches(vars, match_type);
+
+    report_reader_stats(reader);
 
     /* okay, detach */
-    return sm_detach(vars->target);
+    return resume_target(vars, reader);
+}
+
+
+/* Stop-copy-resume support: the selected regions are copied out of the stopped
+ * target in chunks by a pool of workers, so that the target can be resumed
+ * before the (much slower) scan starts. */
+#define COPY_CHUNK_SIZE (4<<20)
+#define MAX_COPY_WORKERS 16
+
+typedef struct {
+    const region_t *region;
+    uint8_t *data;
+    size_t size;                /* bytes actually copied, from the region start */
+} region_copy_t;
+
+typedef struct {
+    region_copy_t *copy;
+    size_t offset;
+    size_t length;
+    size_t nread;
+} copy_chunk_t;
+
+typedef struct {
+    copy_chunk_t *chunks;
+    size_t num_chunks;
+    size_t next_chunk;          /* shared by the workers */
+} copy_job_t;
+
+typedef struct {
+    copy_job_t *job;
+    sm_reader_t *reader;        /* every worker reads with its own reader */
+} copy_worker_t;
+
+static void *copy_worker(void *arg)
+{
+    copy_worker_t *worker = arg;
+    copy_job_t *job = worker->job;
+    size_t i;
+
+    while ((i = __sync_fetch_and_add(&job->next_chunk, 1)) < job->num_chunks) {
+        copy_chunk_t *chunk = &job->chunks[i];
+        chunk->nread = readmemory(worker->reader, chunk->copy->data + chunk->offset,
+                                  chunk->copy->region->start + chunk->offset,
+                                  chunk->length);
+    }
+    return NULL;
+}
+
+static void free_region_copies(region_copy_t *copies, size_t count)
+{
+    size_t i;
+
+    if (copies == NULL)
+        return;
+    for (i = 0; i < count; i++)
+        free(copies[i].data);
+    free(copies);
+}
+
+/* Allocates local buffers for every region, stops the target, copies the
+ * regions and resumes the target. Returns NULL on failure. */
+static region_copy_t *copy_regions(globals_t *vars, sm_reader_t *reader,
+                                   region_t **regions, size_t count)
+{
+    region_copy_t *copies;
+    copy_job_t job = { NULL, 0, 0 };
+    size_t i, c;
+
+    /* allocate everything up front, so that the pause only covers the copy */
+    if ((copies = calloc(count, sizeof(region_copy_t))) == NULL)
+        goto nomem;
+    for (i = 0; i < count; i++) {
+        region_t *r = regions[i];
+        copies[i].region = r;
+        if ((copies[i].data = malloc(r->size)) == NULL)
+            goto nomem;
+        job.num_chunks += (r->size + COPY_CHUNK_SIZE - 1) / COPY_CHUNK_SIZE;
+    }
+    if ((job.chunks = calloc(job.num_chunks, sizeof(copy_chunk_t))) == NULL)
+        goto nomem;
+    for (i = 0, c = 0; i < count; i++) {
+        size_t offset;
+        for (offset = 0; offset < copies[i].region->size; offset += COPY_CHUNK_SIZE, c++) {
+            job.chunks[c].copy = &copies[i];
+            job.chunks[c].offset = offset;
+            job.chunks[c].length = MIN(COPY_CHUNK_SIZE, copies[i].region->size - offset);
+        }
+    }
+
+    if (sm_attach(vars->target) == false)
+        goto fail;
+    report_stop_time(vars);
+
+#if HAVE_PROCMEM
+    {
+        /* pread() on `/proc/<pid>/mem` can be issued from any thread */
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t num_workers = MIN((size_t) (ncpus > 0 ? ncpus : 1), MAX_COPY_WORKERS);
+        pthread_t threads[MAX_COPY_WORKERS];
+        copy_worker_t workers[MAX_COPY_WORKERS];
+        sm_reader_t readers[MAX_COPY_WORKERS];
+        size_t started;
+
+        num_workers = MIN(num_workers, job.num_chunks);
+        /* this thread is the first worker, using the caller's reader */
+        workers[0].job = &job;
+        workers[0].reader = reader;
+        for (started = 1; started < num_workers; started++) {
+            if (!sm_reader_open(&readers[started], vars->target))
+                break;
+            workers[started].job = &job;
+            workers[started].reader = &readers[started];
+            if (pthread_create(&threads[started], NULL, copy_worker, &workers[started]) != 0) {
+                sm_reader_close(&readers[started]);
+                break;
+            }
+        }
+        copy_worker(&workers[0]);
+        while (--started > 0) {
+            pthread_join(threads[started], NULL);
+            reader->stats.reads += readers[started].stats.reads;
+            reader->stats.bytes_read += readers[started].stats.bytes_read;
+            sm_reader_close(&readers[started]);
+        }
+    }
+#else
+    {
+        /* ptrace() requests must come from the tracing thread */
+        copy_worker_t worker = { &job, reader };
+        copy_worker(&worker);
+    }
+#endif
+
+    if (sm_detach(vars->target) == false) {
+        show_error("failed to detach from %d.\n", vars->target);
+        goto fail;
+    }
+    report_pause_time(vars);
+
+    /* a region is valid up to its first short read */
+    for (c = 0; c < job.num_chunks; c++) {
+        copy_chunk_t *chunk = &job.chunks[c];
+        if (chunk->copy->size == chunk->offset)
+            chunk->copy->size += chunk->nread;
+    }
+
+    free(job.chunks);
+    return copies;
+
+nomem:
+    show_error("sorry, there was a memory allocation error.\n");
+    show_info("`stop_copy` needs as much memory as the regions to search.\n");
+fail:
+    free(job.chunks);
+    free_region_copies(copies, count);
+    return NULL;
+}
+
+/* the residency filters of first scans, see sm_readsmaps() */
+static bool resident_enough(const globals_t *vars, const region_t *r)
+{
+    if (r->rss < vars->options.min_rss)
+        return false;
+    /* the content of clean file-backed pages is the file */
+    if (vars->options.skip_clean_files && r->inode != 0 && r->anonymous == 0 && r->dirty == 0)
+        return false;
+    return true;
+}
+
+/* the most resident regions (relative to their size) first */
+static int compare_density(const void *a, const void *b)
+{
+    const region_t *x = *(const region_t * const *) a;
+    const region_t *y = *(const region_t * const *) b;
+    double dx = (double) x->rss / x->size;
+    double dy = (double) y->rss / y->size;
+
+    if (dx != dy)
+        return (dx > dy) ? -1 : 1;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+static unsigned region_priority(const region_t *r)
+{
+    switch (r->type) {
+    case REGION_TYPE_HEAP:
+        return 0;
+    case REGION_TYPE_EXE:       /* only .data and .bss are writable */
+        return 1;
+    case REGION_TYPE_STACK:
+        return 2;
+    default:
+        return 3;
+    }
 }
 
+/* the regions most likely to hold the variables of the program first */
+static int compare_priority(const void *a, const void *b)
+{
+    const region_t *x = *(const region_t * const *) a;
+    const region_t *y = *(const region_t * const *) b;
+
+    if (region_priority(x) != region_priority(y))
+        return (region_priority(x) < region_priority(y)) ? -1 : 1;
+    return (x->start > y->start) - (x->start < y->start);
+}
 
 /* sm_searchregions() performs an initial search of the process for values matching `uservalue` */
-bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const uservalue_t *uservalue)
+bool sm_searchregions(globals_t *vars, sm_reader_t *reader, scan_match_type_t match_type, const uservalue_t *uservalue)
 {
     swath_t *writing_swath_index;
     int required_extra_bytes_to_record = 0;
     unsigned long total_size = 0;
     unsigned regnum = 0;
-    element_t *n = vars->regions->head;
-    region_t *r;
+    region_t **regions, *r;
+    size_t num_regions = 0, i;
+    unsigned long num_skipped = 0, skipped_bytes = 0;
+    int (*compare)(const void *, const void *) = NULL;
+    bool residency, ranked;
     unsigned long total_scan_bytes = 0;
     unsigned char *data = NULL;
+    region_copy_t *copies = NULL;
+    near_scan_t near;
 
-    if (sm_choose_scanroutine(vars->options.scan_data_type, match_type, uservalue, vars->options.reverse_endianness) == false)
+    memset(&near, 0, sizeof(near));
+    if (layout_scan == NULL &&
+        (proximity ? !near_routines(vars, near.routines) :
+         sm_choose_scanroutine(vars->options.scan_data_type, match_type, uservalue, vars->options.reverse_endianness) == false))
     {
         show_error("unsupported scan for current data type.\n"); 
         return false;
     }
 
-    assert(sm_scan_routine);
-
-    /* stop and attach to the target */
-    if (sm_attach(vars->target) == false)
-        return false;
+    assert(layout_scan || sm_scan_routine);
 
-   
     /* make sure we have some regions to search */
     if (vars->regions->size == 0) {
         show_warn("no regions defined, perhaps you deleted them all?\n");
         show_info("use the \"reset\" command to refresh regions.\n");
-        return sm_detach(vars->target);
+        return true;
+    }
+
+    residency = vars->options.min_rss || vars->options.skip_clean_files ||
+                vars->options.scan_order == SCAN_ORDER_DENSITY;
+    /* an image keeps the residency the target had */
+    if (residency && reader->image == NULL && !sm_readsmaps(vars->target, vars->regions)) {
+        show_warn("searching without residency data.\n");
+        residency = false;
     }
 
-    INTERRUPTABLESCAN();
+    /* pick the regions to search, only the new ones for a partial scan */
+    if ((regions = malloc(vars->regions->size * sizeof(region_t *))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return false;
+    }
+    for (i = 0; i < vars->regions->size; i++) {
+        r = vars->regions->regions[i];
+        if (!partial_scan || r->flags.unscanned) {
+            r->flags.unscanned = false;
+            if (residency && !resident_enough(vars, r)) {
+                num_skipped++;
+                skipped_bytes += r->size;
+                continue;
+            }
+            regions[num_regions++] = r;
+        }
+    }
+    if (num_skipped > 0)
+        show_info("skipping %lu regions (%lu bytes) by residency.\n", num_skipped, skipped_bytes);
+
+    /* the matches are written out of order then, and sorted at the end */
+    if (vars->options.scan_order == SCAN_ORDER_DENSITY && residency)
+        compare = compare_density;
+    else if (vars->options.scan_order == SCAN_ORDER_PRIORITY)
+        compare = compare_priority;
+    ranked = (compare != NULL && num_regions > 1);
+    if (ranked)
+        qsort(regions, num_regions, sizeof(region_t *), compare);
+
+    /* a proximity scan holds what it finds until nothing later can be near */
+    if (proximity) {
+        near.capacity = proximity->window + 2;
+        if ((near.hits = calloc(near.capacity, sizeof(near_hit_t))) == NULL) {
+            show_error("sorry, there was a memory allocation error.\n");
+            free(regions);
+            return false;
+        }
+    }
+
+    if (vars->options.stop_copy && reader->image == NULL) {
+        /* copy the regions and let the target run while we scan */
+        if ((copies = copy_regions(vars, reader, regions, num_regions)) == NULL) {
+            free(near.hits);
+            free(regions);
+            return false;
+        }
+    } else {
+        /* stop and attach to the target */
+        if (stop_target(vars, reader) == false) {
+            free(near.hits);
+            free(regions);
+            return false;
+        }
+    }
+
+    if (!scan_worker)
+        INTERRUPTABLESCAN();
     
     total_size = sizeof(matches_t);
 
-    while (n) {
-        total_size += ((region_t *)(n->data))->size * sizeof(old_value_and_match_info) + sizeof(swath_t);
-        n = n->next;
-    }
+    for (i = 0; i < num_regions; i++)
+        total_size += regions[i]->size * sizeof(old_value_and_match_info) + sizeof(swath_t);
     
     total_size += sizeof(swath_t); /* for null terminate */
     
@@ -525,6 +1389,9 @@ bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const userv
     if (!(vars->matches = matches__allocate_array(vars->matches, total_size)))
     {
         show_error("could not allocate match array\n");
+        free_region_copies(copies, num_regions);
+        free(near.hits);
+        free(regions);
         return false;
     }
     
@@ -533,21 +1400,22 @@ bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const userv
     writing_swath_index->number_of_bytes = 0;
     
     /* get total number of bytes */
-    for(n = vars->regions->head; n; n = n->next)
-        total_scan_bytes += ((region_t *)n->data)->size;
+    for (i = 0; i < num_regions; i++)
+        total_scan_bytes += regions[i]->size;
 
     vars->scan_progress = 0.0;
     vars->stop_flag = false;
-    n = vars->regions->head;
 
     /* check every memory region */
-    while (n) {
+    for (i = 0; i < num_regions; i++) {
         size_t bytes_at_next_dot;
         size_t bytes_per_dot;
         double progress_per_dot;
+        unsigned long region_matches = vars->num_matches;
 
         /* load the next region */
-        r = n->data;
+        r = regions[i];
+        region_copy_t *copy = copies ? &copies[i] : NULL;
         bytes_per_dot = r->size / NUM_DOTS;
         bytes_at_next_dot = bytes_per_dot * NUM_DOTS;
         progress_per_dot = (double)bytes_per_dot / total_scan_bytes;
@@ -559,16 +1427,20 @@ bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const userv
 #define MAX_BUFFER_SIZE (1<<20)
 #define MAX_ALLOC_SIZE  (MAX_BUFFER_SIZE + (1<<16))
 
-        /* allocate data array */
+        /* allocate data array, a copied region is scanned in place */
         size_t alloc_size = MIN(r->size, MAX_ALLOC_SIZE);
-        if ((data = malloc(alloc_size * sizeof(char))) == NULL) {
+        if (copy == NULL && (data = malloc(alloc_size * sizeof(char))) == NULL) {
             show_error("sorry, there was a memory allocation error.\n");
+            free(near.hits);
+            free(regions);
             return false;
         }
 
         /* print a progress meter so user knows we haven't crashed */
-        show_user("%02u/%02u searching %#10lx - %#10lx", ++regnum,
-                vars->regions->size, r->start, r->start + r->size);
+        ++regnum;
+        if (!scan_worker)
+            show_user("%02u/%02lu searching %#10lx - %#10lx", regnum,
+                    (unsigned long) num_regions, r->start, r->start + r->size);
         fflush(stderr);
     
         /* For every offset, check if we have a match. */
@@ -586,6 +1458,7 @@ bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const userv
                     /* for front-end, update percentage */
                     vars->scan_progress += progress_per_dot;
                 }
+                report_progress(vars);
 
                 /* the whole region is finished */
                 if (memlength == 0) break;
@@ -595,7 +1468,14 @@ bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const userv
 
                 /* load the next buffer block */
                 size_t alloc_size = MIN(memlength, MAX_ALLOC_SIZE);
-                size_t nread = readmemory(data, reg_pos, alloc_size);
+                size_t nread;
+                if (copy) {
+                    size_t offset = reg_pos - r->start;
+                    nread = (offset < copy->size) ? MIN(alloc_size, copy->size - offset) : 0;
+                    data = copy->data + offset;
+                } else {
+                    nread = readmemory(reader, data, reg_pos, alloc_size);
+                }
                 if (nread < alloc_size) {
                     /* the region ends here, update `memlength` */
                     memlength = nread;
@@ -611,19 +1491,48 @@ bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const userv
             const mem64_t* memory_ptr = (mem64_t*)buf_pos;
             unsigned int match_length;
             uint16_t checkflags;
+            uintptr_t record_pos;
+            uint8_t record_byte;
+
+            if (proximity) {
+                near_step(vars, &writing_swath_index, &near, reg_pos, memory_ptr, memlength);
+                continue;
+            }
 
             /* initialize checkflags */
             checkflags = flags_empty;
 
-            /* check if we have a match */
-            match_length = (*sm_scan_routine)(memory_ptr, memlength, NULL, uservalue, &checkflags);
+            if (layout_scan) {
+                /* the buffer goes on for a whole structure past its last place */
+                size_t fits = memlength < layout_scan->size ? 0 : memlength - layout_scan->size + 1;
+                size_t skip;
+
+                /* nothing to record until the anchor matches again */
+                if (required_extra_bytes_to_record == 0 &&
+                    (skip = sm_layout_find(layout_scan, buf_pos, MIN(fits, buffer_size), 0)) > 0) {
+                    memlength -= skip - 1;
+                    buffer_size -= skip - 1;
+                    reg_pos += skip - 1;
+                    buf_pos += skip - 1;
+                    continue;
+                }
+                match_length = fits ? sm_layout_match(layout_scan, buf_pos, &checkflags) : 0;
+                /* recorded at the first field */
+                record_pos = reg_pos + layout_scan->fields[0].offset;
+                record_byte = buf_pos[layout_scan->fields[0].offset];
+            } else {
+                /* check if we have a match */
+                match_length = (*sm_scan_routine)(memory_ptr, memlength, NULL, uservalue, &checkflags);
+                record_pos = reg_pos;
+                record_byte = get_u8b(memory_ptr);
+            }
             if (UNLIKELY(match_length > 0))
             {
-                assert(match_length <= memlength);
+                assert(layout_scan || match_length <= memlength);
                 writing_swath_index = matches__add_element(&vars->matches,
                                                            writing_swath_index,
-                                                           reg_pos,
-                                                           get_u8b(memory_ptr),
+                                                           record_pos,
+                                                           record_byte,
                                                            checkflags);
                 
                 ++vars->num_matches;
@@ -634,25 +1543,55 @@ bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const userv
             {
                 writing_swath_index = matches__add_element(&vars->matches,
                                                            writing_swath_index,
-                                                           reg_pos,
-                                                           get_u8b(memory_ptr),
+                                                           record_pos,
+                                                           record_byte,
                                                            flags_empty);
                 --required_extra_bytes_to_record;
             }
         }
 
-        free(data);
+        /* nothing is near what is left past the end of the region */
+        if (proximity)
+            near_settle(vars, &writing_swath_index, &near, NULL);
+
+        if (copy) {
+            free(copy->data);
+            copy->data = NULL;
+        } else {
+            free(data);
+        }
         
         /* stop scanning if asked to */
         if (vars->stop_flag) {
-            printf("\n");
+            if (!scan_worker)
+                printf("\n");
+            break;
+        }
+        if (!scan_worker)
+            show_user("ok\n");
+
+        /* let the user follow the most likely regions as they are done */
+        if (!scan_worker && vars->options.scan_order == SCAN_ORDER_PRIORITY)
+            show_info("%s region %u: %lu matches, %lu so far.\n", region_type_names[r->type],
+                      r->id, vars->num_matches - region_matches, vars->num_matches);
+
+        /* few enough matches to narrow them down */
+        if (!partial_scan && vars->options.early_stop > 0 && vars->num_matches > 0 &&
+            vars->num_matches <= vars->options.early_stop && i + 1 < num_regions) {
+            if (!scan_worker)
+                show_info("stopping early, after %lu of %lu regions.\n",
+                          (unsigned long) (i + 1), (unsigned long) num_regions);
             break;
         }
-        n = n->next;
-        show_user("ok\n");
     }
+    /* the regions not reached by a stopped scan are left for the next one */
+    for (i++; i < num_regions; i++)
+        regions[i]->flags.unscanned = true;
+    free(regions);
+    free(near.hits);
 
-    ENDINTERRUPTABLE();
+    if (!scan_worker)
+        ENDINTERRUPTABLE();
 
     /* tell front-end we've finished */
     vars->scan_progress = MAX_PROGRESS;
@@ -663,10 +1602,192 @@ bool sm_searchregions(globals_t *vars, scan_match_type_t match_type, const userv
         return false;
     }
 
-    show_info("we currently have %ld matches.\n", vars->num_matches);
+    if (ranked) {
+        matches_t *sorted = matches__sort_swaths(vars->matches);
+
+        if (sorted == NULL) {
+            show_error("memory allocation error while sorting matches\n");
+            return false;
+        }
+        free(vars->matches);
+        vars->matches = sorted;
+    }
+
+    report_matches(vars);
+    record_matches(vars, match_type);
+    report_reader_stats(reader);
+
+    if (copies) {
+        /* the target is already running again */
+        free_region_copies(copies, num_regions);
+        return true;
+    }
 
     /* okay, detach */
-    return sm_detach(vars->target);
+    return resume_target(vars, reader);
+}
+
+/* Search the regions added by sm_refreshmaps() since the last scan, or not
+ * reached by a scan stopped early, and merge what is found into the known
+ * matches. */
+bool sm_searchnewregions(globals_t *vars, sm_reader_t *reader, scan_match_type_t match_type,
+                         const uservalue_t *uservalue)
+{
+    matches_t *matches = vars->matches;
+    unsigned long num_matches = vars->num_matches;
+    size_t num_new = 0, i;
+    bool ret;
+
+    assert(matches != NULL);
+
+    for (i = 0; i < vars->regions->size; i++) {
+        if (vars->regions->regions[i]->flags.unscanned)
+            num_new++;
+    }
+    if (num_new == 0)
+        return true;
+
+    show_info("searching %lu new regions.\n", (unsigned long) num_new);
+
+    vars->matches = NULL;
+    vars->num_matches = 0;
+    partial_scan = true;
+    ret = sm_searchregions(vars, reader, match_type, uservalue);
+    partial_scan = false;
+
+    if (ret) {
+        matches_t *merged = matches__merge(matches, vars->matches);
+
+        if (merged == NULL) {
+            show_error("memory allocation error while merging matches.\n");
+            ret = false;
+        } else {
+            free(matches);
+            matches = merged;
+            num_matches += vars->num_matches;
+        }
+    }
+    free(vars->matches);
+
+    vars->matches = matches;
+    vars->num_matches = num_matches;
+    return ret;
+}
+
+bool sm_searchnear(globals_t *vars, sm_reader_t *reader, const sm_proximity_t *near)
+{
+    bool ret;
+
+    proximity = near;
+    ret = sm_searchregions(vars, reader, near->match_type[0], near->values[0]);
+    proximity = NULL;
+    return ret;
+}
+
+bool sm_checknear(globals_t *vars, sm_reader_t *reader, const sm_proximity_t *near)
+{
+    bool ret;
+
+    proximity = near;
+    ret = sm_checkmatches(vars, reader, near->match_type[0], near->values[0]);
+    proximity = NULL;
+    return ret;
+}
+
+/* The first scan for a structure: every place of every region where it
+ * fits is a candidate, the match is recorded at its first field. The
+ * regions are chosen, read and reported on as by sm_searchregions(). */
+bool sm_searchlayout(globals_t *vars, sm_reader_t *reader, const sm_layout_t *layout)
+{
+    bool ret;
+
+    layout_scan = layout;
+    ret = sm_searchregions(vars, reader, MATCHEQUALTO, NULL);
+    layout_scan = NULL;
+    return ret;
+}
+
+/* keep the matches which are still the first field of the structure */
+bool sm_checklayout(globals_t *vars, sm_reader_t *reader, const sm_layout_t *layout)
+{
+    const size_t first_offset = layout->fields[0].offset;
+    swath_t *reading_swath_index = vars->matches->swaths;
+    swath_t reading_swath = *reading_swath_index;
+    swath_t *writing_swath_index = vars->matches->swaths;
+    unsigned int required_extra_bytes_to_record = 0;
+    size_t reading_iterator = 0;
+    unsigned long bytes_checked = 0;
+
+    writing_swath_index->first_byte_in_child = 0;
+    writing_swath_index->number_of_bytes = 0;
+    vars->num_matches = 0;
+    vars->stop_flag = false;
+
+    if (stop_target(vars, reader) == false)
+        return false;
+    sm_reader_invalidate(reader);
+
+    if (!scan_worker)
+        INTERRUPTABLESCAN();
+
+    while (reading_swath.first_byte_in_child && !vars->stop_flag) {
+        uintptr_t address = reading_swath.first_byte_in_child + reading_iterator;
+        uint16_t old_flags = reading_swath_index->data[reading_iterator].flags;
+        unsigned int match_length = 0;
+        uint16_t checkflags = flags_empty;
+        const mem64_t *memory_ptr;
+        size_t memlength;
+
+        if (old_flags != flags_empty && address >= first_offset &&
+            sm_peekdata(reader, address - first_offset, layout->size, &memory_ptr, &memlength) &&
+            memlength >= layout->size) {
+            match_length = sm_layout_match(layout, (const uint8_t *) memory_ptr, &checkflags);
+            if (match_length > 0) {
+                writing_swath_index = matches__add_element(&vars->matches, writing_swath_index,
+                                                           address, ((const uint8_t *) memory_ptr)[first_offset],
+                                                           checkflags);
+                ++vars->num_matches;
+                required_extra_bytes_to_record = match_length - 1;
+            }
+        }
+        if (match_length == 0 && required_extra_bytes_to_record) {
+            if (sm_peekdata(reader, address, 1, &memory_ptr, &memlength)) {
+                writing_swath_index = matches__add_element(&vars->matches, writing_swath_index,
+                                                           address, get_u8b(memory_ptr), flags_empty);
+                --required_extra_bytes_to_record;
+            } else {
+                required_extra_bytes_to_record = 0;
+            }
+        }
+
+        /* let the front end stop it, see sm_checkmatches() */
+        if (UNLIKELY((++bytes_checked % STOP_CHECK_BYTES) == 0))
+            report_progress(vars);
+
+        /* go on to the next one... */
+        ++reading_iterator;
+        if (reading_iterator >= reading_swath.number_of_bytes) {
+            reading_swath_index = (swath_t *)
+                (&reading_swath_index->data[reading_swath.number_of_bytes]);
+            reading_swath = *reading_swath_index;
+            reading_iterator = 0;
+            required_extra_bytes_to_record = 0;
+        }
+    }
+
+    if (!scan_worker)
+        ENDINTERRUPTABLE();
+
+    if (!(vars->matches = matches__null_terminate(vars->matches, writing_swath_index))) {
+        show_error("memory allocation error while reducing matches-array size\n");
+        return false;
+    }
+    vars->scan_progress = MAX_PROGRESS;
+
+    report_matches(vars);
+    record_matches(vars, MATCHEQUALTO);
+    report_reader_stats(reader);
+    return resume_target(vars, reader);
 }
 
 /* Needs to support only ANYNUMBER types */
@@ -675,12 +1796,18 @@ bool sm_setaddr(pid_t target, uintptr_t addr, const value_t *to)
     unsigned int i;
     uint8_t memarray[sizeof(uint64_t)] = {0};
     size_t memlength;
+    sm_reader_t reader;
 
     if (sm_attach(target) == false) {
         return false;
     }
 
-    memlength = readmemory(memarray, addr, sizeof(uint64_t));
+    if (sm_reader_open(&reader, target) == false) {
+        sm_detach(target);
+        return false;
+    }
+    memlength = readmemory(&reader, memarray, addr, sizeof(uint64_t));
+    sm_reader_close(&reader);
     if (memlength == 0) {
         show_error("couldn't access the target address %10p\n", addr);
         return false;
@@ -708,20 +1835,320 @@ bool sm_setaddr(pid_t target, uintptr_t addr, const value_t *to)
     return sm_detach(target);
 }
 
-bool sm_read_array(pid_t target, const uintptr_t addr, char *buf, size_t len)
+bool sm_read_array(sm_reader_t *reader, const uintptr_t addr, char *buf, size_t len)
 {
-    if (sm_attach(target) == false) {
+    size_t nread = 0;
+
+    if (reader->image == NULL && sm_attach(reader->pid) == false) {
         return false;
     }
-
-    size_t nread = readmemory(buf, addr, len);
+    /* the target ran since the last read */
+    sm_reader_invalidate(reader);
+
+    if (len > MAX_CACHED_READ) {
+        nread = readmemory(reader, (uint8_t *)buf, addr, len);
+    } else {
+        /* small reads go through the cache, page by page */
+        while (nread < len) {
+            const mem64_t *memory_ptr;
+            size_t memlength;
+            uint16_t chunk = MIN(len - nread, PEEK_PAGE_SIZE - (addr + nread) % PEEK_PAGE_SIZE);
+
+            if (!sm_peekdata(reader, addr + nread, chunk, &memory_ptr, &memlength))
+                break;
+            memlength = MIN(memlength, chunk);
+            memcpy(buf + nread, memory_ptr, memlength);
+            nread += memlength;
+            if (memlength < chunk)
+                break;
+        }
+    }
+    if (reader->image)
+        return nread == len;
     if (nread < len)
     {
-        sm_detach(target);
+        sm_detach(reader->pid);
         return false;
     }
 
-    return sm_detach(target);
+    return sm_detach(reader->pid);
+}
+
+/* spans of sm_readmany() closer than this are read together */
+#define READMANY_GAP 4096
+
+typedef struct {
+    uintptr_t address;
+    size_t index;
+} span_order_t;
+
+static int compare_span_order(const void *a, const void *b)
+{
+    const span_order_t *x = a, *y = b;
+
+    if (x->address != y->address)
+        return x->address < y->address ? -1 : 1;
+    return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+bool sm_readmany(sm_reader_t *reader, sm_read_span_t *spans, size_t count, uint8_t *buf)
+{
+    span_order_t *order = NULL;
+    size_t *offsets = NULL;
+    uint8_t *chunk = NULL;
+    size_t i, j, k, total = 0;
+
+    if (count == 0)
+        return true;
+    order = calloc(count, sizeof(span_order_t));
+    offsets = calloc(count, sizeof(size_t));
+    chunk = malloc(MAX_BUFFER_SIZE);
+    if (order == NULL || offsets == NULL || chunk == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        free(order);
+        free(offsets);
+        free(chunk);
+        return false;
+    }
+    for (i = 0; i < count; i++) {
+        order[i].address = spans[i].address;
+        order[i].index = i;
+        offsets[i] = total;
+        total += spans[i].length;
+        spans[i].ok = 0;
+    }
+    memset(buf, 0, total);
+    /* by address, so that neighbours are read at once */
+    qsort(order, count, sizeof(span_order_t), compare_span_order);
+
+    if (reader->image == NULL && sm_attach(reader->pid) == false) {
+        free(order);
+        free(offsets);
+        free(chunk);
+        return false;
+    }
+    /* the target ran since the last read */
+    sm_reader_invalidate(reader);
+
+    for (i = 0; i < count; i = j) {
+        uintptr_t lo = order[i].address;
+        uintptr_t hi = lo + spans[order[i].index].length;
+        size_t nread;
+
+        /* a span longer than the chunk is read alone, straight to `buf` */
+        for (j = i + 1; hi - lo <= MAX_BUFFER_SIZE && j < count &&
+                        order[j].address <= hi + READMANY_GAP; j++) {
+            uintptr_t end = order[j].address + spans[order[j].index].length;
+
+            if (end > hi) {
+                if (end - lo > MAX_BUFFER_SIZE)
+                    break;
+                hi = end;
+            }
+        }
+        nread = (j > i + 1) ? readmemory(reader, chunk, lo, hi - lo) : 0;
+
+        for (k = i; k < j; k++) {
+            sm_read_span_t *span = &spans[order[k].index];
+            size_t offset = span->address - lo;
+
+            if (offset + span->length <= nread) {
+                memcpy(buf + offsets[order[k].index], chunk + offset, span->length);
+                span->ok = 1;
+            } else {
+                /* alone, or past where the whole could be read */
+                uint8_t *dest = buf + offsets[order[k].index];
+
+                span->ok = (readmemory(reader, dest, span->address, span->length) == span->length);
+                if (!span->ok)
+                    memset(dest, 0, span->length);
+            }
+        }
+    }
+
+    free(order);
+    free(offsets);
+    free(chunk);
+    return reader->image ? true : sm_detach(reader->pid);
+}
+
+/* the chunks sm_dump_memory() goes through, a multiple of the page size */
+#define DUMP_CHUNK_SIZE (1 << 20)
+
+/* Find where the memory is readable again from `addr`, which is not, going
+ * page by page. Returns `end` if nothing is. */
+static uintptr_t skip_unreadable(sm_reader_t *reader, uintptr_t addr, uintptr_t end)
+{
+    uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t page = (addr | (page_size - 1)) + 1;
+    uint8_t byte[sizeof(long)];
+
+    for ( ; page < end; page += page_size) {
+        if (readmemory(reader, byte, page, sizeof(byte)) > 0)
+            return page;
+    }
+    return end;
+}
+
+static bool add_hole(address_range_t **holes, size_t *num_holes, uintptr_t start, uintptr_t end)
+{
+    address_range_t *h;
+
+    /* holes next to each other are one */
+    if (*num_holes > 0 && (*holes)[*num_holes - 1].end == start) {
+        (*holes)[*num_holes - 1].end = end;
+        return true;
+    }
+    if ((h = realloc(*holes, (*num_holes + 1) * sizeof(address_range_t))) == NULL)
+        return false;
+    h[*num_holes].start = start;
+    h[*num_holes].end = end;
+    *holes = h;
+    (*num_holes)++;
+    return true;
+}
+
+#if HAVE_PROCMEM
+/* Copy straight from /proc/pid/mem to the file where the kernel can, returns
+ * the bytes copied, 0 if nothing could be, -1 if it cannot be done at all. */
+static ssize_t copy_memory(sm_reader_t *reader, int fd, uintptr_t addr, size_t len, off_t offset)
+{
+    loff_t in = (loff_t) addr, out = offset;
+    ssize_t n = copy_file_range(reader->procmem_fd, &in, fd, &out, len, 0);
+
+    if (n >= 0)
+        return n;
+    return (errno == EIO || errno == EFAULT) ? 0 : -1;
+}
+#endif
+
+/* Write what is not zeros, page by page as the file sees them: the pages
+ * left out are holes reading zeros. */
+static bool write_sparse(int fd, const uint8_t *buf, size_t len, off_t offset)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    while (len > 0) {
+        size_t n = MIN(len, page_size - offset % page_size);
+
+        if ((buf[0] != 0 || memcmp(buf, buf + 1, n - 1) != 0) && !sm_write_at(fd, buf, n, offset))
+            return false;
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+/*
+ * Save the memory of the target in `ranges` on to `fd`, each range at its
+ * offset in `offsets`, while the target is stopped once. The memory goes
+ * through a fixed buffer, one chunk at a time, or is copied by the kernel
+ * without one where it allows it. The file has to be empty where the
+ * memory goes: pages of zeros read through the buffer are not written.
+ * What cannot be read is left as a hole in the file, reading zeros, and
+ * reported in `holes`, which is to be freed. Stops early if `stop_flag` is
+ * set.
+ */
+bool sm_dump_memory(globals_t *vars, const address_range_t *ranges, const off_t *offsets,
+                    size_t count, int fd, address_range_t **holes, size_t *num_holes)
+{
+    sm_reader_t *reader = &vars->reader;
+    unsigned long long total = 0, done = 0;
+    off_t file_end = 0;
+    struct stat st;
+    uint8_t *buf;
+#if HAVE_PROCMEM
+    bool copy = (reader->image == NULL);
+#else
+    bool copy = false;
+#endif
+    bool ret = false;
+    unsigned dots = 0;
+    size_t r;
+
+    *holes = NULL;
+    *num_holes = 0;
+    vars->scan_progress = 0;
+
+    for (r = 0; r < count; r++)
+        total += ranges[r].end - ranges[r].start;
+
+    if ((buf = malloc(DUMP_CHUNK_SIZE)) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return false;
+    }
+    if (!stop_target(vars, reader)) {
+        free(buf);
+        return false;
+    }
+    sm_reader_invalidate(reader);
+
+    for (r = 0; r < count && !vars->stop_flag; r++) {
+        uintptr_t addr = ranges[r].start, pos = addr, end = ranges[r].end;
+
+        while (pos < end && !vars->stop_flag) {
+            /* chunks end on a page boundary, so that reads never straddle two */
+            size_t chunk = MIN(end - pos, DUMP_CHUNK_SIZE - pos % DUMP_CHUNK_SIZE), nread = 0;
+            off_t offset = offsets[r] + (off_t) (pos - addr);
+
+#if HAVE_PROCMEM
+            if (copy) {
+                ssize_t n = copy_memory(reader, fd, pos, chunk, offset);
+
+                if (n == -1) {
+                    show_debug("copy_file_range() from /proc/%d/mem: %s, reading instead.\n",
+                               reader->pid, strerror(errno));
+                    copy = false;
+                } else {
+                    nread = n;
+                }
+            }
+#endif
+            if (!copy) {
+                /* ptrace() reads whole words */
+                nread = MIN(readmemory(reader, buf, pos, (chunk + sizeof(long) - 1) & ~(sizeof(long) - 1)),
+                            chunk);
+                if (nread > 0 && !write_sparse(fd, buf, nread, offset)) {
+                    show_error("failed to write the dump: %s.\n", strerror(errno));
+                    goto out;
+                }
+            }
+            pos += nread;
+
+            if (nread < chunk) {
+                uintptr_t resume = skip_unreadable(reader, pos, end);
+
+                if (!add_hole(holes, num_holes, pos, resume)) {
+                    show_error("sorry, there was a memory allocation error.\n");
+                    goto out;
+                }
+                pos = resume;
+            }
+
+            vars->scan_progress = (double) (done + pos - addr) / total;
+            while (dots < vars->scan_progress * NUM_DOTS) {
+                print_a_dot();
+                dots++;
+            }
+        }
+        done += end - addr;
+        if (offsets[r] + (off_t) (pos - addr) > file_end)
+            file_end = offsets[r] + (off_t) (pos - addr);
+    }
+
+    /* holes and zeros at the end still belong to the file */
+    if (fstat(fd, &st) == 0 && st.st_size < file_end &&
+        ftruncate(fd, file_end) == -1 && errno != EINVAL) {
+        show_error("failed to write the dump: %s.\n", strerror(errno));
+        goto out;
+    }
+    ret = true;
+
+out:
+    vars->scan_progress = MAX_PROGRESS;
+    free(buf);
+    return resume_target(vars, reader) && ret;
 }
 
 /* TODO: may use /proc/<pid>/mem here */
@@ -0,0 +1,409 @@
+/*
+    Recording the matches of every scan to a file.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "endianness.h"
+#include "recorder.h"
+#include "scanroutines.h"
+#include "show_message.h"
+#include "targetmem.h"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t flags;
+    uint32_t scan_data_type;
+    uint32_t reserved;
+    uint64_t time;
+    uint64_t count;
+    uint64_t addresses_size;
+} generation_header_t;
+
+sm_recorder_t *sm_recorder_open(const char *path)
+{
+    sm_recorder_t *recorder;
+
+    if ((recorder = calloc(1, sizeof(sm_recorder_t))) == NULL ||
+        (recorder->path = strdup(path)) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        free(recorder);
+        return NULL;
+    }
+    if ((recorder->file = fopen(path, "wb")) == NULL) {
+        show_error("failed to create `%s`: %s.\n", path, strerror(errno));
+        goto error;
+    }
+    if (fwrite(SM_RECORD_MAGIC, 8, 1, recorder->file) != 1 || fflush(recorder->file) != 0) {
+        show_error("failed to write to `%s`: %s.\n", path, strerror(errno));
+        goto error;
+    }
+    recorder->size = 8;
+    return recorder;
+
+error:
+    sm_recorder_close(recorder);
+    return NULL;
+}
+
+void sm_recorder_close(sm_recorder_t *recorder)
+{
+    if (recorder == NULL)
+        return;
+    if (recorder->file)
+        fclose(recorder->file);
+    free(recorder->path);
+    free(recorder);
+}
+
+static inline uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t) v | 0x80;
+        v >>= 7;
+    }
+    *p++ = (uint8_t) v;
+    return p;
+}
+
+bool sm_recorder_append(sm_recorder_t *recorder, const globals_t *vars)
+{
+    generation_header_t header = { SM_RECORD_GENERATION, 0, 0, 0, 0, 0, 0 };
+    uint8_t *addresses = NULL, *values = NULL, *ap, *vp;
+    uint16_t *flags = NULL;
+    uintptr_t previous = 0;
+    struct timespec now;
+    const swath_t *swath;
+    bool ret = false;
+    size_t count = 0, i;
+
+    if ((vars->options.scan_data_type == BYTEARRAY) || (vars->options.scan_data_type == STRING)) {
+        show_warn("bytearray and string scans are not recorded.\n");
+        return true;
+    }
+
+    /* the largest each column can get */
+    addresses = malloc(vars->num_matches * 10 + 1);
+    flags = malloc(vars->num_matches * sizeof(uint16_t) + 1);
+    values = malloc(vars->num_matches * sizeof(uint64_t) + 1);
+    if (!addresses || !flags || !values) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto out;
+    }
+
+    ap = addresses;
+    vp = values;
+    for (swath = vars->matches ? vars->matches->swaths : NULL;
+         swath && swath->first_byte_in_child && count < vars->num_matches;
+         swath = swath__local_address_beyond_last_element((swath_t *) swath)) {
+        for (i = 0; i < swath->number_of_bytes && count < vars->num_matches; i++) {
+            uintptr_t address;
+            int64_t delta;
+            value_t v;
+
+            if (swath->data[i].flags == flags_empty)
+                continue;
+
+            v = data_to_val(swath, i);
+            address = (uintptr_t) swath__remote_address_of_nth_element((swath_t *) swath, i);
+            delta = (int64_t) (address - previous);
+            ap = put_varint(ap, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+            previous = address;
+
+            flags[count++] = v.flags;
+            memcpy(vp, v.bytes, flags_width(v.flags));
+            vp += flags_width(v.flags);
+        }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.flags = vars->options.reverse_endianness ? SM_RECORD_REVERSED : 0;
+    header.scan_data_type = vars->options.scan_data_type;
+    header.time = now.tv_sec * 1000000000ULL + now.tv_nsec;
+    header.count = count;
+    header.addresses_size = ap - addresses;
+
+    if (fwrite(&header, sizeof(header), 1, recorder->file) != 1 ||
+        fwrite(addresses, 1, ap - addresses, recorder->file) != (size_t) (ap - addresses) ||
+        fwrite(flags, sizeof(uint16_t), count, recorder->file) != count ||
+        fwrite(values, 1, vp - values, recorder->file) != (size_t) (vp - values) ||
+        fflush(recorder->file) != 0) {
+        show_error("failed to write to `%s`: %s.\n", recorder->path, strerror(errno));
+        goto out;
+    }
+
+    recorder->generations++;
+    recorder->matches += count;
+    recorder->size += sizeof(header) + (ap - addresses) + count * sizeof(uint16_t) + (vp - values);
+    ret = true;
+
+out:
+    free(addresses);
+    free(flags);
+    free(values);
+    return ret;
+}
+
+/* a match of a generation being read */
+typedef struct {
+    uintptr_t address;
+    uint64_t value;
+    match_flags flags;
+} record_entry_t;
+
+/* what is known of an address while reading generation after generation */
+typedef struct {
+    uintptr_t address;
+    uint64_t value;             /* the last one */
+    match_flags flags;
+    uint64_t prefixes;          /* bit j: the last values matched sequence[0..j] */
+    bool found;
+} record_track_t;
+
+static int compare_entries(const void *a, const void *b)
+{
+    const record_entry_t *x = a, *y = b;
+
+    return (x->address > y->address) - (x->address < y->address);
+}
+
+/* read the next generation, returns its number of entries, or -1 at the end */
+static ssize_t read_generation(FILE *file, generation_header_t *header, record_entry_t **entries)
+{
+    uint8_t *addresses = NULL, *ap, *end;
+    uint16_t *flags = NULL;
+    uintptr_t address = 0;
+    record_entry_t *e = NULL;
+    bool sorted = true;
+    size_t i;
+
+    if (fread(header, sizeof(*header), 1, file) != 1)
+        return -1;
+    if (header->magic != SM_RECORD_GENERATION || header->addresses_size > header->count * 10 ||
+        header->count > SIZE_MAX / sizeof(record_entry_t)) {
+        show_error("the recording is corrupt.\n");
+        return -1;
+    }
+
+    addresses = malloc(header->addresses_size + 1);
+    flags = malloc(header->count * sizeof(uint16_t) + 1);
+    e = malloc(header->count * sizeof(record_entry_t) + 1);
+    if (!addresses || !flags || !e) {
+        show_error("sorry, there was a memory allocation error.\n");
+        goto error;
+    }
+    if (fread(addresses, 1, header->addresses_size, file) != header->addresses_size ||
+        fread(flags, sizeof(uint16_t), header->count, file) != header->count)
+        goto truncated;
+
+    ap = addresses;
+    end = addresses + header->addresses_size;
+    for (i = 0; i < header->count; i++) {
+        uint64_t zigzag = 0;
+        unsigned shift = 0;
+
+        do {
+            if (ap == end || shift > 63)
+                goto truncated;
+            zigzag |= (uint64_t) (*ap & 0x7f) << shift;
+            shift += 7;
+        } while (*ap++ & 0x80);
+        address += (uintptr_t) ((zigzag >> 1) ^ -(zigzag & 1));
+
+        e[i].address = address;
+        e[i].flags = flags[i];
+        e[i].value = 0;
+        if (fread(&e[i].value, flags_width(flags[i]), 1, file) != 1)
+            goto truncated;
+        if (i > 0 && e[i - 1].address >= address)
+            sorted = false;
+    }
+
+    if (!sorted)
+        qsort(e, header->count, sizeof(record_entry_t), compare_entries);
+
+    free(addresses);
+    free(flags);
+    *entries = e;
+    return (ssize_t) header->count;
+
+truncated:
+    show_warn("the recording ends with an incomplete generation.\n");
+error:
+    free(addresses);
+    free(flags);
+    free(e);
+    return -1;
+}
+
+/* the elements of the sequence matched by `value`, one bit each */
+static uint64_t matching_elements(const record_entry_t *entry, const uservalue_t *sequence,
+                                  const scan_routine_t *routines, size_t length)
+{
+    uint64_t bits = 0;
+    size_t j;
+
+    for (j = 0; j < length; j++) {
+        uint16_t saveflags = 0;
+
+        if (sequence[j].flags == flags_empty) {
+            bits |= 1ULL << j;
+            continue;
+        }
+        if (routines[j]((const mem64_t *) &entry->value, flags_width(entry->flags), NULL,
+                        &sequence[j], &saveflags) > 0 && (saveflags & entry->flags))
+            bits |= 1ULL << j;
+    }
+    return bits;
+}
+
+ssize_t sm_record_query(const char *path, const uservalue_t *sequence, size_t length,
+                        sm_record_hit_t **hits)
+{
+    scan_routine_t routines[2][SM_RECORD_MAX_SEQUENCE];
+    record_track_t *tracks = NULL, *next;
+    size_t num_tracks = 0, num_hits = 0, capacity = 0, j;
+    unsigned long generation;
+    uint64_t complete;
+    char magic[8];
+    FILE *file;
+
+    *hits = NULL;
+    if (length == 0 || length > SM_RECORD_MAX_SEQUENCE)
+        return -1;
+    complete = 1ULL << (length - 1);
+
+    for (j = 0; j < length; j++) {
+        if (sequence[j].flags == flags_empty)
+            continue;
+        routines[0][j] = sm_get_scanroutine(ANYNUMBER, MATCHEQUALTO, sequence[j].flags, false);
+        routines[1][j] = sm_get_scanroutine(ANYNUMBER, MATCHEQUALTO, sequence[j].flags, true);
+        if (!routines[0][j] || !routines[1][j]) {
+            show_error("no scan routine for element %zu of the sequence.\n", j);
+            return -1;
+        }
+    }
+
+    if ((file = fopen(path, "rb")) == NULL) {
+        show_error("failed to open `%s`: %s.\n", path, strerror(errno));
+        return -1;
+    }
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, SM_RECORD_MAGIC, 8) != 0) {
+        show_error("`%s` is not a recording.\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    for (generation = 0; ; generation++) {
+        generation_header_t header;
+        record_entry_t *entries;
+        const scan_routine_t *r;
+        ssize_t count = read_generation(file, &header, &entries);
+        size_t i, p = 0;
+
+        if (count < 0)
+            break;
+        r = routines[(header.flags & SM_RECORD_REVERSED) ? 1 : 0];
+
+        if ((next = malloc(count * sizeof(record_track_t) + 1)) == NULL) {
+            show_error("sorry, there was a memory allocation error.\n");
+            free(entries);
+            goto error;
+        }
+
+        /* both are sorted by address, follow each address from the last generation */
+        for (i = 0; i < (size_t) count; i++) {
+            const record_entry_t *e = &entries[i];
+            record_track_t *t = &next[i];
+
+            while (p < num_tracks && tracks[p].address < e->address)
+                p++;
+            if (p < num_tracks && tracks[p].address == e->address) {
+                uint64_t mask = UINT64_MAX;
+                size_t width = MIN(flags_width(tracks[p].flags), flags_width(e->flags));
+
+                if (width < sizeof(uint64_t))
+                    mask = (1ULL << (width * 8)) - 1;
+                *t = tracks[p];
+                /* the same value again, not a step of the sequence */
+                if (((t->value ^ e->value) & mask) == 0) {
+                    t->flags = e->flags;
+                    continue;
+                }
+            } else {
+                memset(t, 0, sizeof(*t));
+                t->address = e->address;
+            }
+
+            t->prefixes = ((t->prefixes << 1) | 1) & matching_elements(e, sequence, r, length);
+            t->value = e->value;
+            t->flags = e->flags;
+
+            if ((t->prefixes & complete) && !t->found) {
+                sm_record_hit_t *hit;
+
+                if (num_hits == capacity) {
+                    size_t n = capacity ? capacity * 2 : 64;
+                    sm_record_hit_t *h = realloc(*hits, n * sizeof(sm_record_hit_t));
+
+                    if (h == NULL) {
+                        show_error("sorry, there was a memory allocation error.\n");
+                        free(entries);
+                        free(next);
+                        goto error;
+                    }
+                    *hits = h;
+                    capacity = n;
+                }
+                hit = &(*hits)[num_hits++];
+                hit->address = e->address;
+                hit->generation = generation;
+                memset(&hit->value, 0, sizeof(hit->value));
+                memcpy(hit->value.bytes, &e->value, sizeof(e->value));
+                hit->value.flags = e->flags;
+                fix_endianness(&hit->value, header.flags & SM_RECORD_REVERSED);
+                t->found = true;
+            }
+        }
+
+        free(entries);
+        free(tracks);
+        tracks = next;
+        num_tracks = count;
+    }
+
+    free(tracks);
+    fclose(file);
+    return (ssize_t) num_hits;
+
+error:
+    free(tracks);
+    free(*hits);
+    *hits = NULL;
+    fclose(file);
+    return -1;
+}
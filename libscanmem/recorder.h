@@ -0,0 +1,86 @@
+/*
+    Recording the matches of every scan to a file.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "scanmem.h"
+#include "value.h"
+
+/*
+ * A recording is the magic "SMREC" followed by a version byte and two
+ * zeros, then a generation for each scan. A generation holds the matches
+ * left after the scan, column by column, in the byte order of the host:
+ *
+ *   uint32_t magic "SMGN"
+ *   uint32_t flags                 SM_RECORD_REVERSED, reverse_endianness
+ *   uint32_t scan_data_type
+ *   uint32_t reserved
+ *   uint64_t time                  nanoseconds since the epoch
+ *   uint64_t count                 matches
+ *   uint64_t addresses_size        bytes of the address column
+ *   addresses                      LEB128 varints, the difference to the
+ *                                  previous address zigzag encoded
+ *   uint16_t flags[count]          the match_flags of every match
+ *   values                         flags_width(flags) bytes of each match
+ */
+#define SM_RECORD_MAGIC "SMREC\1\0\0"
+#define SM_RECORD_GENERATION 0x4e474d53 /* "SMGN" */
+#define SM_RECORD_REVERSED 1
+
+typedef struct sm_recorder {
+    FILE *file;
+    char *path;
+    unsigned long generations;
+    unsigned long long matches;         /* recorded over all generations */
+    unsigned long long size;            /* of the file */
+} sm_recorder_t;
+
+/* start a recording at `path`, replacing what is there */
+sm_recorder_t *sm_recorder_open(const char *path);
+void sm_recorder_close(sm_recorder_t *recorder);
+
+/* append the matches of `vars` as a new generation */
+bool sm_recorder_append(sm_recorder_t *recorder, const globals_t *vars);
+
+typedef struct {
+    uintptr_t address;
+    unsigned long generation;           /* where the sequence was complete */
+    value_t value;                      /* the last value of the sequence */
+} sm_record_hit_t;
+
+/* the longest sequence a query can look for */
+#define SM_RECORD_MAX_SEQUENCE 64
+
+/*
+ * Find the addresses which took the values of `sequence` one after the
+ * other, in consecutive generations where they changed; a value repeated
+ * by the following generations counts once. An element with no flags
+ * matches any value. Returns the number of hits stored in `hits`, to be
+ * freed, or -1.
+ */
+ssize_t sm_record_query(const char *path, const uservalue_t *sequence, size_t length,
+                        sm_record_hit_t **hits);
+
+#endif /* RECORDER_H */
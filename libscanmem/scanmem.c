@@ -32,10 +32,21 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 
 #include "scanmem.h"
 #include "commands.h"
+#include "core.h"
+#include "endianness.h"
+#include "freeze.h"
+#include "group.h"
 #include "handlers.h"
+#include "pointer.h"
+#include "recorder.h"
 #include "show_message.h"
 
 
@@ -52,7 +63,14 @@ globals_t sm_globals = {
     NULL,                       /* matches */
     0,                          /* match count */
     0,                          /* scan progress */
+    NULL,                       /* progress_hook */
     NULL,                       /* regions */
+    { 0, -1, NULL, NULL, { 0 } },   /* reader */
+    NULL,                       /* image */
+    NULL,                       /* group */
+    NULL,                       /* freezer */
+    NULL,                       /* recorder */
+    NULL,                       /* ptrscan */
     NULL,                       /* commands */
     NULL,                       /* current_cmdline */
     sm_printversion,            /* printversion() pointer */
@@ -62,11 +80,16 @@ globals_t sm_globals = {
         0,                      /* backend */
         1,                      /* dump_with_ascii */
         0,                      /* reverse_endianness */
-        0,                      /* padding1 */
+        0,                      /* stop_all_threads */
+        0,                      /* stop_copy */
+        0,                      /* skip_clean_files */
+        SCAN_ORDER_ADDRESS,     /* scan_order */
         0,                      /* padding2 */
         1,                      /* alignment */
         ANYINTEGER,             /* scan_data_type */
         REGION_HEAP_STACK_EXECUTABLE_BSS, /* region_scan_level */
+        0,                      /* min_rss */
+        0,                      /* early_stop */
     }
 };
 
@@ -141,8 +164,18 @@ bool sm_init(void)
                        DELETE_LONGDOC, NULL);
     sm_registercommand("reset", handler__reset, vars->commands, RESET_SHRTDOC,
                        RESET_LONGDOC, NULL);
+    sm_registercommand("refresh", handler__refresh, vars->commands, REFRESH_SHRTDOC,
+                       REFRESH_LONGDOC, NULL);
     sm_registercommand("pid", handler__pid, vars->commands, PID_SHRTDOC,
                        PID_LONGDOC, NULL);
+    sm_registercommand("freeze", handler__freeze, vars->commands, FREEZE_SHRTDOC,
+                       FREEZE_LONGDOC, FREEZE_COMPLETE);
+    sm_registercommand("record", handler__record, vars->commands, RECORD_SHRTDOC,
+                       RECORD_LONGDOC, RECORD_COMPLETE);
+    sm_registercommand("ptrscan", handler__ptrscan, vars->commands, PTRSCAN_SHRTDOC,
+                       PTRSCAN_LONGDOC, PTRSCAN_COMPLETE);
+    sm_registercommand("group", handler__group, vars->commands, GROUP_SHRTDOC,
+                       GROUP_LONGDOC, GROUP_COMPLETE);
     sm_registercommand("snapshot", handler__snapshot, vars->commands,
                        SNAPSHOT_SHRTDOC, SNAPSHOT_LONGDOC, NULL);
     sm_registercommand("dregion", handler__dregion, vars->commands,
@@ -167,6 +200,10 @@ bool sm_init(void)
                        DECREASED_LONGDOC, NULL);
     sm_registercommand("\"", handler__string, vars->commands, STRING_SHRTDOC,
                        STRING_LONGDOC, NULL);
+    sm_registercommand("struct", handler__struct, vars->commands, STRUCT_SHRTDOC,
+                       STRUCT_LONGDOC, NULL);
+    sm_registercommand("near", handler__near, vars->commands, NEAR_SHRTDOC,
+                       NEAR_LONGDOC, NULL);
     sm_registercommand("update", handler__update, vars->commands, UPDATE_SHRTDOC,
                        UPDATE_LONGDOC, NULL);
     sm_registercommand("exit", handler__exit, vars->commands, EXIT_SHRTDOC,
@@ -187,6 +224,12 @@ bool sm_init(void)
                        SHOW_LONGDOC, SHOW_COMPLETE);
     sm_registercommand("dump", handler__dump, vars->commands, DUMP_SHRTDOC,
                        DUMP_LONGDOC, NULL);
+    sm_registercommand("readmany", handler__readmany, vars->commands, READMANY_SHRTDOC,
+                       READMANY_LONGDOC, NULL);
+    sm_registercommand("savecore", handler__savecore, vars->commands, SAVECORE_SHRTDOC,
+                       SAVECORE_LONGDOC, NULL);
+    sm_registercommand("loadcore", handler__loadcore, vars->commands, LOADCORE_SHRTDOC,
+                       LOADCORE_LONGDOC, NULL);
     sm_registercommand("write", handler__write, vars->commands, WRITE_SHRTDOC,
                        WRITE_LONGDOC, WRITE_COMPLETE);
     sm_registercommand("option", handler__option, vars->commands, OPTION_SHRTDOC,
@@ -202,10 +245,37 @@ bool sm_init(void)
     return true;
 }
 
+/* the scan run by sm_scan_async() */
+static struct {
+    pthread_t thread;
+    bool started;                   /* the thread is yet to be joined */
+    sm_scan_status_t status;        /* written by the thread while it runs */
+    bool cancel;
+    scan_match_type_t match_type;
+    const uservalue_t *values;
+    sm_scan_callback_t callback;
+    void *data;
+    struct timespec last_report;
+    int eventfd;                    /* -1 until sm_scan_eventfd() */
+} async = { .status = SM_SCAN_IDLE, .eventfd = -1 };
+
 void sm_cleanup(void)
 {
+    /* a scan still running uses everything below */
+    sm_scan_cancel();
+    sm_scan_wait();
+    if (async.eventfd != -1)
+        close(async.eventfd);
+    async.eventfd = -1;
+
     /* free any allocated memory used */
-    l_destroy(sm_globals.regions);
+    rt_destroy(sm_globals.regions);
+    sm_reader_close(&sm_globals.reader);
+    sm_image_close(sm_globals.image);
+    sm_group_destroy(sm_globals.group);
+    sm_freezer_destroy(sm_globals.freezer);
+    sm_recorder_close(sm_globals.recorder);
+    sm_ptrscan_destroy(sm_globals.ptrscan);
     if (sm_globals.commands)
         sm_free_all_completions(sm_globals.commands);
     l_destroy(sm_globals.commands);
@@ -224,18 +294,367 @@ void sm_set_backend(void)
     sm_globals.options.backend = 1;
 }
 
+/* raised whenever the matches may have changed, which makes iterators stale */
+static unsigned long generation = 1;
+
+/* where the last window of sm_get_matches() ended */
+static sm_match_iter_t cursor;
+
 void sm_backend_exec_cmd(const char *commandline)
 {
-    sm_execcommand(&sm_globals, commandline);
+    sm_exec_cmd(commandline);
     fflush(stdout);
     fflush(stderr);
 }
 
+/* the session belongs to an asynchronous scan until it ends */
+static bool scan_running(void)
+{
+    if (sm_get_scan_status() != SM_SCAN_RUNNING)
+        return false;
+    show_error("a scan is running, see sm_scan_wait().\n");
+    return true;
+}
+
+bool sm_exec_cmd(const char *commandline)
+{
+    if (scan_running())
+        return false;
+
+    /* the command may rearrange the matches in place */
+    generation++;
+    return sm_execcommand(&sm_globals, commandline);
+}
+
 unsigned long sm_get_num_matches(void)
 {
     return sm_globals.num_matches;
 }
 
+unsigned sm_get_api_version(void)
+{
+    return SM_API_VERSION;
+}
+
+static bool scan(scan_match_type_t match_type, const uservalue_t *values)
+{
+    globals_t *vars = &sm_globals;
+
+    if (vars->target == 0 && vars->image == NULL) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+
+    generation++;
+
+    if (vars->matches) {
+        /* regions added by `refresh` are searched, then checked with the others */
+        if (!sm_needs_old_values(match_type) &&
+            !sm_searchnewregions(vars, &vars->reader, match_type, values)) {
+            show_error("failed to search the new regions.\n");
+            return false;
+        }
+        if (vars->num_matches == 0) {
+            show_error("there are currently no matches.\n");
+            return false;
+        }
+        if (!sm_checkmatches(vars, &vars->reader, match_type, values)) {
+            show_error("failed to search target address space.\n");
+            return false;
+        }
+    } else if (sm_needs_old_values(match_type)) {
+        show_error("cannot use that search without matches\n");
+        return false;
+    } else if (!sm_searchregions(vars, &vars->reader, match_type, values)) {
+        show_error("failed to search target address space.\n");
+        return false;
+    }
+    return true;
+}
+
+bool sm_scan(scan_match_type_t match_type, const uservalue_t *values)
+{
+    if (scan_running())
+        return false;
+    return scan(match_type, values);
+}
+
+void sm_match_iter_init(sm_match_iter_t *iter)
+{
+    memset(iter, 0, sizeof(sm_match_iter_t));
+    iter->generation = generation;
+    /* the matches of a running scan are not there yet */
+    if (sm_globals.matches && sm_get_scan_status() != SM_SCAN_RUNNING)
+        iter->swath = sm_globals.matches->swaths;
+}
+
+/* move to the next byte flagged as a match, false if there is none */
+static bool iter_seek(sm_match_iter_t *iter)
+{
+    if (iter->generation != generation || iter->swath == NULL)
+        return false;
+
+    while (iter->swath->first_byte_in_child &&
+           iter->swath->data[iter->index].flags == flags_empty) {
+        if (++iter->index >= iter->swath->number_of_bytes) {
+            iter->swath = swath__local_address_beyond_last_element((swath_t *) iter->swath);
+            iter->index = 0;
+        }
+    }
+    return iter->swath->first_byte_in_child != 0;
+}
+
+/* go past the match found by iter_seek() */
+static void iter_step(sm_match_iter_t *iter)
+{
+    if (++iter->index >= iter->swath->number_of_bytes) {
+        iter->swath = swath__local_address_beyond_last_element((swath_t *) iter->swath);
+        iter->index = 0;
+    }
+    iter->id++;
+}
+
+bool sm_match_iter_next(sm_match_iter_t *iter, sm_match_record_t *record)
+{
+    const globals_t *vars = &sm_globals;
+    const swath_t *swath;
+    size_t index;
+    uintptr_t address;
+    match_flags flags;
+
+    if (sm_get_scan_status() == SM_SCAN_RUNNING || !iter_seek(iter))
+        return false;
+    swath = iter->swath;
+    index = iter->index;
+
+    flags = swath->data[index].flags;
+    address = (uintptr_t) swath__remote_address_of_nth_element((swath_t *) swath, index);
+    memset(record, 0, sizeof(*record));
+    record->address = address;
+    record->flags = flags;
+    if ((vars->options.scan_data_type == BYTEARRAY) || (vars->options.scan_data_type == STRING)) {
+        size_t i;
+
+        for (i = 0; i < sizeof(record->value) && index + i < swath->number_of_bytes; i++)
+            ((uint8_t *) &record->value)[i] = swath->data[index + i].old_value;
+    } else {
+        value_t v = data_to_val(swath, index);
+
+        /* the number, not the bytes as the target has them */
+        fix_endianness(&v, vars->options.reverse_endianness);
+        memcpy(&record->value, v.bytes, flags_width(v.flags));
+    }
+
+    /* matches come in address order, most share the region of the previous */
+    if (iter->region == NULL || address < iter->region->start ||
+        address >= iter->region->start + iter->region->size)
+        iter->region = vars->regions ? rt_find(vars->regions, address) : NULL;
+    if (iter->region) {
+        record->region_id = iter->region->id;
+        record->offset = address - iter->region->load_addr;
+        record->region_type = iter->region->type;
+    } else {
+        record->region_id = UINT32_MAX;
+    }
+
+    iter_step(iter);
+    return true;
+}
+
+/* Fill `records` with up to `count` matches, starting at match-id `first`,
+ * and return how many were filled. A window following the previous one is
+ * found without going over the matches before it again, so that a front-end
+ * can page through millions of them. */
+size_t sm_get_matches(size_t first, size_t count, sm_match_record_t *records)
+{
+    const globals_t *vars = &sm_globals;
+    size_t n = 0;
+
+    if (scan_running() || vars->matches == NULL || first >= vars->num_matches)
+        return 0;
+
+    if (cursor.generation != generation || cursor.id > first)
+        sm_match_iter_init(&cursor);
+
+    while (cursor.id < first && iter_seek(&cursor))
+        iter_step(&cursor);
+    while (n < count && sm_match_iter_next(&cursor, &records[n]))
+        n++;
+    return n;
+}
+
+size_t sm_get_num_regions(void)
+{
+    return sm_globals.regions ? sm_globals.regions->size : 0;
+}
+
+size_t sm_get_regions(size_t first, size_t count, sm_region_record_t *records)
+{
+    const region_table_t *regions = sm_globals.regions;
+    size_t n;
+
+    if (scan_running())
+        return 0;
+    for (n = 0; regions && n < count && first + n < regions->size; n++) {
+        const region_t *region = regions->regions[first + n];
+        sm_region_record_t *r = &records[n];
+
+        memset(r, 0, sizeof(*r));
+        r->start = region->start;
+        r->size = region->size;
+        r->load_addr = region->load_addr;
+        r->filename = region->filename;
+        r->id = region->id;
+        r->type = region->type;
+        r->flags = (region->flags.read ? SM_REGION_READ : 0) |
+                   (region->flags.write ? SM_REGION_WRITE : 0) |
+                   (region->flags.exec ? SM_REGION_EXEC : 0) |
+                   (region->flags.shared ? SM_REGION_SHARED : 0);
+    }
+    return n;
+}
+
+bool sm_read_memory(uintptr_t address, void *buf, size_t length)
+{
+    if (scan_running())
+        return false;
+    if (sm_globals.target == 0 && sm_globals.image == NULL) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+    return sm_read_array(&sm_globals.reader, address, buf, length);
+}
+
+bool sm_read_many(sm_read_span_t *spans, size_t count, void *buf)
+{
+    if (scan_running())
+        return false;
+    if (sm_globals.target == 0 && sm_globals.image == NULL) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+    return sm_readmany(&sm_globals.reader, spans, count, buf);
+}
+
+bool sm_write_memory(uintptr_t address, const void *buf, size_t length)
+{
+    if (scan_running())
+        return false;
+    if (sm_globals.image) {
+        show_error("an image cannot be written to.\n");
+        return false;
+    }
+    if (sm_globals.target == 0) {
+        show_error("no target has been specified, see `help pid`.\n");
+        return false;
+    }
+    return sm_write_array(sm_globals.target, address, buf, length);
+}
+
+static void async_notify(sm_scan_status_t status)
+{
+    uint64_t one = 1;
+
+    if (async.callback)
+        async.callback(status, sm_globals.scan_progress, sm_globals.num_matches, async.data);
+    if (async.eventfd != -1 && write(async.eventfd, &one, sizeof(one)) != sizeof(one))
+        show_debug("could not signal the scan eventfd.\n");
+}
+
+/* the progress_hook of the scan, on its thread */
+static void async_progress(void)
+{
+    struct timespec now;
+    long elapsed_ms;
+
+    /* each step of a scan clears the stop flag as it starts */
+    if (__atomic_load_n(&async.cancel, __ATOMIC_ACQUIRE))
+        sm_globals.stop_flag = true;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ms = (now.tv_sec - async.last_report.tv_sec) * 1000 +
+                 (now.tv_nsec - async.last_report.tv_nsec) / 1000000;
+    if (elapsed_ms < SM_SCAN_REPORT_INTERVAL_MS)
+        return;
+    async.last_report = now;
+    async_notify(SM_SCAN_RUNNING);
+}
+
+static void *async_scan(void *arg)
+{
+    sm_scan_status_t status;
+    bool ok;
+
+    (void) arg;
+    ok = scan(async.match_type, async.values);
+    if (__atomic_load_n(&async.cancel, __ATOMIC_ACQUIRE))
+        status = SM_SCAN_CANCELLED;
+    else
+        status = ok ? SM_SCAN_DONE : SM_SCAN_FAILED;
+
+    /* the hook is not called anymore, and `async` is only read until joined */
+    __atomic_store_n(&async.status, status, __ATOMIC_RELEASE);
+    async_notify(status);
+    return NULL;
+}
+
+bool sm_scan_async(scan_match_type_t match_type, const uservalue_t *values,
+                   sm_scan_callback_t callback, void *data)
+{
+    if (sm_get_scan_status() == SM_SCAN_RUNNING) {
+        show_error("a scan is already running.\n");
+        return false;
+    }
+    sm_scan_wait();
+
+    async.match_type = match_type;
+    async.values = values;
+    async.callback = callback;
+    async.data = data;
+    async.cancel = false;
+    async.status = SM_SCAN_RUNNING;
+    clock_gettime(CLOCK_MONOTONIC, &async.last_report);
+    sm_globals.progress_hook = async_progress;
+    if (pthread_create(&async.thread, NULL, async_scan, NULL) != 0) {
+        show_error("failed to start the scan thread.\n");
+        sm_globals.progress_hook = NULL;
+        async.status = SM_SCAN_FAILED;
+        return false;
+    }
+    async.started = true;
+    return true;
+}
+
+void sm_scan_cancel(void)
+{
+    if (sm_get_scan_status() != SM_SCAN_RUNNING)
+        return;
+    __atomic_store_n(&async.cancel, true, __ATOMIC_RELEASE);
+    sm_set_stop_flag(true);
+}
+
+sm_scan_status_t sm_scan_wait(void)
+{
+    if (async.started) {
+        pthread_join(async.thread, NULL);
+        async.started = false;
+        sm_globals.progress_hook = NULL;
+    }
+    return async.status;
+}
+
+sm_scan_status_t sm_get_scan_status(void)
+{
+    return __atomic_load_n(&async.status, __ATOMIC_ACQUIRE);
+}
+
+int sm_scan_eventfd(void)
+{
+    if (async.eventfd == -1 && (async.eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1)
+        show_error("failed to create the scan eventfd.\n");
+    return async.eventfd;
+}
+
 const char *sm_get_version(void)
 {
     return PACKAGE_VERSION;
@@ -249,4 +668,5 @@ double sm_get_scan_progress(void)
 void sm_set_stop_flag(bool stop_flag)
 {
     sm_globals.stop_flag = stop_flag;
+    sm_group_set_stop_flag(sm_globals.group, stop_flag);
 }
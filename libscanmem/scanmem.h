@@ -37,6 +37,42 @@
 #include "targetmem.h"
 
 
+/* Statistics of a reader, see sm_reader_t */
+typedef struct {
+    unsigned long reads;            /* read requests sent to the kernel */
+    unsigned long bytes_read;       /* bytes obtained from the target */
+    unsigned long cache_hits;       /* sm_peekdata() calls served by the cache */
+    unsigned long cache_misses;     /* sm_peekdata() calls which needed a read */
+} sm_reader_stats_t;
+
+struct sm_image;
+struct sm_layout;
+
+/* Reader context, holding everything needed to read the memory of a target.
+ * Readers do not share any state, so threads reading concurrently must each
+ * use their own one. Without `/proc/<pid>/mem`, reads go through ptrace()
+ * and only the thread which called sm_attach() may use a reader. */
+typedef struct {
+    pid_t pid;
+    int procmem_fd;                 /* `/proc/<pid>/mem`, -1 if not opened */
+    struct sm_peekbuf *peekbuf;     /* sm_peekdata() cache, allocated on first use */
+    struct sm_image *image;         /* read instead of `pid` if set, see core.h */
+    sm_reader_stats_t stats;
+} sm_reader_t;
+
+/* the order of the regions in first scans */
+typedef enum {
+    SCAN_ORDER_ADDRESS,
+    SCAN_ORDER_DENSITY,                    /* most resident first, see sm_readsmaps() */
+    SCAN_ORDER_PRIORITY                    /* heap, exe data and bss, stack, the rest */
+} scan_order_t;
+
+struct sm_group;
+struct sm_freezer;
+struct sm_recorder;
+struct sm_ptrscan;
+
+
 /* global settings */
 typedef struct {
     _Bool exit;
@@ -45,7 +81,14 @@ typedef struct {
     matches_t *matches;
     unsigned long num_matches;
     double scan_progress;
-    list_t *regions;
+    void (*progress_hook)(void);   /* called as a scan goes on, see sm_scan_async() */
+    region_table_t *regions;
+    sm_reader_t reader;            /* reader for the target */
+    struct sm_image *image;        /* scanned instead of a process, see core.h */
+    struct sm_group *group;        /* other targets scanned together, see group.h */
+    struct sm_freezer *freezer;    /* values kept in place, see freeze.h */
+    struct sm_recorder *recorder;  /* matches of every scan, see recorder.h */
+    struct sm_ptrscan *ptrscan;    /* the last pointer scan, see pointer.h */
     list_t *commands;              /* command handlers */
     const char *current_cmdline;   /* the command being executed */
     void (*printversion)(FILE *outfd);
@@ -55,17 +98,88 @@ typedef struct {
                                       output will be more machine-readable */
         unsigned dump_with_ascii:1;
         unsigned reverse_endianness:1;
-        unsigned _future_options_padding1:4;
-        unsigned _future_options_padding2:8;
+        unsigned stop_all_threads:1;   /* if 1, every thread of the target is
+                                          stopped, not only the main one */
+        unsigned stop_copy:1;          /* if 1, first scans copy the regions
+                                          and resume the target before scanning */
+        unsigned skip_clean_files:1;   /* if 1, first scans skip file-backed
+                                          regions without modified pages */
+        unsigned scan_order:2;         /* a scan_order_t */
+        unsigned _future_options_padding2:7;
         uint16_t alignment;
         scan_data_type_t scan_data_type;
         region_scan_level_t region_scan_level;
+        unsigned long min_rss;         /* first scans skip regions with less
+                                          resident bytes, 0 to scan them all */
+        unsigned long early_stop;      /* first scans stop after a region once
+                                          they have up to this many matches */
     } options;
 } globals_t;
 
 /* global settings */
 extern globals_t sm_globals;
 
+/* A match as handed out by sm_get_matches(): 32 bytes, no padding, in the
+ * byte order of the host. */
+typedef struct {
+    uint64_t address;
+    uint64_t offset;               /* from the load address of the region */
+    uint64_t value;                /* the number matched, as many bytes as
+                                      its widest type, swapped back if
+                                      reverse_endianness is set; the first
+                                      8 bytes of a bytearray or string */
+    uint32_t region_id;            /* UINT32_MAX if the region is gone */
+    uint16_t flags;                /* match_flags, or the length of a
+                                      bytearray or string */
+    uint8_t region_type;           /* a region_type_t */
+    uint8_t reserved;
+} sm_match_record_t;
+
+/* A position in the matches, see sm_match_iter_init(). It goes stale when
+ * the matches change, after a scan or any command. */
+typedef struct {
+    unsigned long generation;      /* of the matches it goes through */
+    const swath_t *swath;
+    size_t index;
+    size_t id;                     /* match-id of the next match */
+    const region_t *region;        /* of the last match */
+} sm_match_iter_t;
+
+#define SM_REGION_READ   0x01
+#define SM_REGION_WRITE  0x02
+#define SM_REGION_EXEC   0x04
+#define SM_REGION_SHARED 0x08
+
+/* A region as handed out by sm_get_regions(). */
+typedef struct {
+    uint64_t start;
+    uint64_t size;
+    uint64_t load_addr;
+    const char *filename;          /* valid until the regions are read again */
+    uint32_t id;
+    uint8_t type;                  /* a region_type_t */
+    uint8_t flags;                 /* SM_REGION_* */
+    uint16_t reserved;
+} sm_region_record_t;
+
+/* One read of sm_readmany(). */
+typedef struct {
+    uint64_t address;
+    uint32_t length;
+    uint32_t ok;                   /* set to whether all of it could be read */
+} sm_read_span_t;
+
+/* the most bytes a proximity scan allows between its two values */
+#define SM_PROXIMITY_MAX_WINDOW 4096
+
+/* Two values, each one number or a range, found within `window` bytes of
+ * each other, see sm_searchnear(). */
+typedef struct {
+    scan_match_type_t match_type[2];   /* MATCHEQUALTO or MATCHRANGE */
+    uservalue_t values[2][2];
+    size_t window;
+} sm_proximity_t;
+
 bool sm_init(void);
 void sm_cleanup(void);
 void sm_printversion(FILE *outfd);
@@ -74,18 +188,99 @@ void sm_backend_exec_cmd(const char *commandline);
 unsigned long sm_get_num_matches(void);
 const char *sm_get_version(void);
 double sm_get_scan_progress(void);
+size_t sm_get_matches(size_t first, size_t count, sm_match_record_t *records);
 void sm_set_stop_flag(bool stop_flag);
 
+/*
+ * The C API for front ends, on the session the commands act on. Its version
+ * is raised with any incompatible change to the functions or records below;
+ * a front end checks sm_get_api_version() against the SM_API_VERSION it was
+ * built with. The commands are a client of it.
+ */
+#define SM_API_VERSION 1
+
+unsigned sm_get_api_version(void);
+/* like sm_backend_exec_cmd(), telling whether the command succeeded */
+bool sm_exec_cmd(const char *commandline);
+/* A scan: the first one, or one narrowing the matches down. `values` holds
+ * two values for MATCHRANGE, one for the other match types which compare
+ * with a value, and is ignored by the others. See set_uservalue_int(). */
+bool sm_scan(scan_match_type_t match_type, const uservalue_t *values);
+void sm_match_iter_init(sm_match_iter_t *iter);
+/* the next match, false at the end or once the matches changed */
+bool sm_match_iter_next(sm_match_iter_t *iter, sm_match_record_t *record);
+size_t sm_get_num_regions(void);
+/* like sm_get_matches(), the regions in address order */
+size_t sm_get_regions(size_t first, size_t count, sm_region_record_t *records);
+bool sm_read_memory(uintptr_t address, void *buf, size_t length);
+bool sm_write_memory(uintptr_t address, const void *buf, size_t length);
+/* sm_readmany() on the target, `buf` holding the lengths of all the spans */
+bool sm_read_many(sm_read_span_t *spans, size_t count, void *buf);
+
+typedef enum {
+    SM_SCAN_IDLE,
+    SM_SCAN_RUNNING,
+    SM_SCAN_DONE,
+    SM_SCAN_FAILED,
+    SM_SCAN_CANCELLED
+} sm_scan_status_t;
+
+/* Called on the thread of the scan, as it goes on with SM_SCAN_RUNNING and
+ * at most every SM_SCAN_REPORT_INTERVAL_MS, then once with how it ended.
+ * It must not call the functions below. */
+typedef void (*sm_scan_callback_t)(sm_scan_status_t status, double progress,
+                                   unsigned long num_matches, void *data);
+
+#define SM_SCAN_REPORT_INTERVAL_MS 50
+
+/* Run sm_scan() on a thread of the library and return at once. `values`
+ * must stay valid until the scan ends, and until then the only calls
+ * allowed are the ones below, sm_get_scan_progress() and
+ * sm_get_num_matches(); the functions above for commands, scans, matches,
+ * regions and memory fail meanwhile. sm_scan_wait() must follow. */
+bool sm_scan_async(scan_match_type_t match_type, const uservalue_t *values,
+                   sm_scan_callback_t callback, void *data);
+/* ask the scan to stop, which it does within a buffer of the target */
+void sm_scan_cancel(void);
+/* wait for the scan to end, and tell how it did */
+sm_scan_status_t sm_scan_wait(void);
+sm_scan_status_t sm_get_scan_status(void);
+/* An eventfd written to along with each call to the callback, so that a
+ * main loop can wait for it instead; get it before the scan starts. */
+int sm_scan_eventfd(void);
+
 /* ptrace.c */
 bool sm_detach(pid_t target);
 bool sm_setaddr(pid_t target, uintptr_t addr, const value_t *to);
-bool sm_checkmatches(globals_t *vars, scan_match_type_t match_type,
+bool sm_checkmatches(globals_t *vars, sm_reader_t *reader, scan_match_type_t match_type,
                      const uservalue_t *uservalue);
-bool sm_searchregions(globals_t *vars, scan_match_type_t match_type,
+bool sm_searchregions(globals_t *vars, sm_reader_t *reader, scan_match_type_t match_type,
                       const uservalue_t *uservalue);
-bool sm_peekdata(const uintptr_t addr, uint16_t length, const mem64_t **result_ptr, size_t *memlength);
+bool sm_searchnewregions(globals_t *vars, sm_reader_t *reader, scan_match_type_t match_type,
+                         const uservalue_t *uservalue);
+/* like sm_searchregions() and sm_checkmatches(), but only the places where
+ * either value is found with the other one near it are matches */
+bool sm_searchnear(globals_t *vars, sm_reader_t *reader, const sm_proximity_t *near);
+bool sm_checknear(globals_t *vars, sm_reader_t *reader, const sm_proximity_t *near);
+bool sm_searchlayout(globals_t *vars, sm_reader_t *reader, const struct sm_layout *layout);
+bool sm_checklayout(globals_t *vars, sm_reader_t *reader, const struct sm_layout *layout);
+bool sm_reader_open(sm_reader_t *reader, pid_t target);
+/* read `image` instead of a process, the image stays open after closing */
+void sm_reader_open_image(sm_reader_t *reader, struct sm_image *image);
+void sm_reader_close(sm_reader_t *reader);
+void sm_reader_invalidate(sm_reader_t *reader);
+size_t sm_reader_read(sm_reader_t *reader, uint8_t *dest_buffer, uintptr_t target_address, size_t size);
+bool sm_peekdata(sm_reader_t *reader, const uintptr_t addr, uint16_t length, const mem64_t **result_ptr, size_t *memlength);
 bool sm_attach(pid_t target);
-bool sm_read_array(pid_t target, const uintptr_t addr, char *buf, size_t len);
+bool sm_read_array(sm_reader_t *reader, const uintptr_t addr, char *buf, size_t len);
+/* Read every span into `buf`, one after the other as they are given, with
+ * the target attached once and neighbouring spans read together. A span
+ * which cannot be read is left as zeros. False if the target could not be
+ * attached to. */
+bool sm_readmany(sm_reader_t *reader, sm_read_span_t *spans, size_t count, uint8_t *buf);
 bool sm_write_array(pid_t target, uintptr_t addr, const char *data, size_t len);
+bool sm_dump_memory(globals_t *vars, const address_range_t *ranges, const off_t *offsets,
+                    size_t count, int fd, address_range_t **holes, size_t *num_holes);
+void sm_set_scan_worker(bool worker);
 
 #endif /* SCANMEM_H */
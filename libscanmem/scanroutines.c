@@ -31,7 +31,7 @@
 
 /* for convenience */
 #define SCAN_ROUTINE_ARGUMENTS (const mem64_t *memory_ptr, size_t memlength, const value_t *old_value, const uservalue_t *user_value, uint16_t *saveflags)
-unsigned int (*sm_scan_routine) SCAN_ROUTINE_ARGUMENTS;
+__thread unsigned int (*sm_scan_routine) SCAN_ROUTINE_ARGUMENTS;
 
 #define MEMORY_COMP(value,field,op)  (((value)->flags & flag_##field) && (get_##field(memory_ptr) op get_##field(value)))
 #define GET_FLAG(valptr, field)      ((valptr)->flags & flag_##field)
@@ -61,6 +61,19 @@ typedef enum {
 } scan_match_type_t;
 
 
+/* whether a scan compares with the values of the previous one, and so
+ * cannot be the first scan */
+static inline bool sm_needs_old_values(scan_match_type_t m)
+{
+    return (m == MATCHNOTCHANGED  ||
+            m == MATCHCHANGED     ||
+            m == MATCHDECREASED   ||
+            m == MATCHINCREASED   ||
+            m == MATCHDECREASEDBY ||
+            m == MATCHINCREASEDBY);
+}
+
+
 /* Matches a memory area given by `memory_ptr` and `memlength` against `user_value` or `old_value`
  * (or both, depending on the matching type), stores the result into saveflags.
  * NOTE: saveflags must be set to 0, since only useful bits are set, but extra bits are not cleared!
@@ -68,10 +81,10 @@ typedef enum {
  */
 typedef unsigned int (*scan_routine_t)(const mem64_t *memory_ptr, size_t memlength,
                                        const value_t *old_value, const uservalue_t *user_value, uint16_t *saveflags);
-extern scan_routine_t sm_scan_routine;
+extern __thread scan_routine_t sm_scan_routine;
 
 /* 
- * Choose the global scanroutine according to the given parameters, sm_scan_routine will be set.
+ * Choose the scanroutine of the calling thread according to the given parameters, sm_scan_routine will be set.
  * Returns whether a proper routine has been found.
  */
 bool sm_choose_scanroutine(scan_data_type_t dt, scan_match_type_t mt, const uservalue_t* uval, bool reverse_endianness);
@@ -406,6 +406,112 @@ matches__delete_in_address_range(matches_t *matches,
 }
 
 
+/* merges the matches of two arrays covering distinct addresses into a new
+   array, both arrays are left untouched */
+static inline
+matches_t *
+matches__merge(matches_t *matches,
+               matches_t *other)
+{
+    matches_t *merged;
+    swath_t *writing_swath_index;
+    swath_t *swaths[2] = { matches->swaths, other->swaths };
+    size_t iterators[2] = { 0, 0 };
+    
+    /* the result is never larger than both arrays together */
+    if ((merged = matches__allocate_array(NULL, matches->bytes_allocated
+                                                + other->bytes_allocated)) == NULL)
+        return NULL;
+    
+    writing_swath_index = merged->swaths;
+    writing_swath_index->first_byte_in_child = 0;
+    writing_swath_index->number_of_bytes = 0;
+    
+    while (swaths[0]->first_byte_in_child || swaths[1]->first_byte_in_child) {
+        /* take the element at the lowest address */
+        int i = (swaths[1]->first_byte_in_child == 0 ||
+                 (swaths[0]->first_byte_in_child &&
+                  swaths[0]->first_byte_in_child + iterators[0] <
+                  swaths[1]->first_byte_in_child + iterators[1])) ? 0 : 1;
+        old_value_and_match_info old_byte = swaths[i]->data[iterators[i]];
+        
+        writing_swath_index = matches__add_element(&merged,
+                                                   writing_swath_index,
+                                                   swaths[i]->first_byte_in_child + iterators[i],
+                                                   old_byte.old_value,
+                                                   old_byte.flags);
+        if (merged == NULL)
+            return NULL;
+        
+        /* go on to the next one... */
+        if (++iterators[i] >= swaths[i]->number_of_bytes) {
+            swaths[i] = swath__local_address_beyond_last_element(swaths[i]);
+            iterators[i] = 0;
+        }
+    }
+    
+    return matches__null_terminate(merged, writing_swath_index);
+}
+
+
+static inline
+int
+swath__compare_address(const void *a,
+                       const void *b)
+{
+    const swath_t *x = *(const swath_t * const *) a;
+    const swath_t *y = *(const swath_t * const *) b;
+    
+    return (x->first_byte_in_child > y->first_byte_in_child) -
+           (x->first_byte_in_child < y->first_byte_in_child);
+}
+
+/* copies an array whose swaths were written out of address order (but do
+   not overlap) into a new array in address order, `matches` is left
+   untouched */
+static inline
+matches_t *
+matches__sort_swaths(matches_t *matches)
+{
+    matches_t *sorted;
+    swath_t *swath, *writing_swath_index, **swaths;
+    size_t count = 0, bytes, i;
+    
+    for (swath = matches->swaths; swath->first_byte_in_child;
+         swath = swath__local_address_beyond_last_element(swath))
+        count++;
+    bytes = (char *) swath + sizeof(swath_t) - (char *) matches;
+    
+    if ((swaths = malloc((count + 1) * sizeof(swath_t *))) == NULL)
+        return NULL;
+    if ((sorted = malloc(bytes)) == NULL) {
+        free(swaths);
+        return NULL;
+    }
+    
+    for (i = 0, swath = matches->swaths; i < count;
+         i++, swath = swath__local_address_beyond_last_element(swath))
+        swaths[i] = swath;
+    qsort(swaths, count, sizeof(swath_t *), swath__compare_address);
+    
+    sorted->bytes_allocated = bytes;
+    sorted->max_needed_bytes = matches->max_needed_bytes;
+    writing_swath_index = sorted->swaths;
+    for (i = 0; i < count; i++) {
+        size_t swath_bytes = (char *) swath__local_address_beyond_last_element(swaths[i])
+                             - (char *) swaths[i];
+        
+        memcpy(writing_swath_index, swaths[i], swath_bytes);
+        writing_swath_index = swath__local_address_beyond_last_element(writing_swath_index);
+    }
+    writing_swath_index->first_byte_in_child = 0;
+    writing_swath_index->number_of_bytes = 0;
+    
+    free(swaths);
+    return sorted;
+}
+
+
 /* for printable text representation */
 static inline
 void data_to_printable_string(char *buf,
@@ -184,21 +184,50 @@ bool parse_uservalue_number(const char *nptr, uservalue_t * val)
     }
     else if(parse_uservalue_float(nptr, val))
     {
-        double num = val->float64_value;
-        if (num >=         0 && num <=  UINT8_MAX) { val->flags |= flag_u8b;  set_u8b(val,   (uint8_t)num); }
-        if (num >=  INT8_MIN && num <=   INT8_MAX) { val->flags |= flag_s8b;  set_s8b(val,    (int8_t)num); }
-        if (num >=         0 && num <= UINT16_MAX) { val->flags |= flag_u16b; set_u16b(val, (uint16_t)num); }
-        if (num >= INT16_MIN && num <=  INT16_MAX) { val->flags |= flag_s16b; set_s16b(val,  (int16_t)num); }
-        if (num >=         0 && num <= UINT32_MAX) { val->flags |= flag_u32b; set_u32b(val, (uint32_t)num); }
-        if (num >= INT32_MIN && num <=  INT32_MAX) { val->flags |= flag_s32b; set_s32b(val,  (int32_t)num); }
-        if (num >=         0 && num <= UINT64_MAX) { val->flags |= flag_u64b; set_u64b(val, (uint64_t)num); }
-        if (num >= INT64_MIN && num <=  INT64_MAX) { val->flags |= flag_s64b; set_s64b(val,  (int64_t)num); }
+        set_uservalue_float(val, val->float64_value);
         return true;
     }
 
     return false;
 }
 
+void set_uservalue_int(uservalue_t *val, int64_t n)
+{
+    zero_uservalue(val);
+
+    if (n >= 0         && n <=  UINT8_MAX) { val->flags |= flag_u8b;  set_u8b(val,   (uint8_t)n); }
+    if (n >=  INT8_MIN && n <=   INT8_MAX) { val->flags |= flag_s8b;  set_s8b(val,    (int8_t)n); }
+    if (n >= 0         && n <= UINT16_MAX) { val->flags |= flag_u16b; set_u16b(val, (uint16_t)n); }
+    if (n >= INT16_MIN && n <=  INT16_MAX) { val->flags |= flag_s16b; set_s16b(val,  (int16_t)n); }
+    if (n >= 0         && n <= UINT32_MAX) { val->flags |= flag_u32b; set_u32b(val, (uint32_t)n); }
+    if (n >= INT32_MIN && n <=  INT32_MAX) { val->flags |= flag_s32b; set_s32b(val,  (int32_t)n); }
+    if (n >= 0)                            { val->flags |= flag_u64b; set_u64b(val, (uint64_t)n); }
+    val->flags |= flag_s64b;
+    set_s64b(val, n);
+
+    val->flags |= flags_float;
+    val->float32_value = (float) n;
+    val->float64_value = (double) n;
+}
+
+void set_uservalue_float(uservalue_t *val, double num)
+{
+    zero_uservalue(val);
+
+    val->flags |= flags_float;
+    val->float32_value = (float) num;
+    val->float64_value = num;
+
+    if (num >=         0 && num <=  UINT8_MAX) { val->flags |= flag_u8b;  set_u8b(val,   (uint8_t)num); }
+    if (num >=  INT8_MIN && num <=   INT8_MAX) { val->flags |= flag_s8b;  set_s8b(val,    (int8_t)num); }
+    if (num >=         0 && num <= UINT16_MAX) { val->flags |= flag_u16b; set_u16b(val, (uint16_t)num); }
+    if (num >= INT16_MIN && num <=  INT16_MAX) { val->flags |= flag_s16b; set_s16b(val,  (int16_t)num); }
+    if (num >=         0 && num <= UINT32_MAX) { val->flags |= flag_u32b; set_u32b(val, (uint32_t)num); }
+    if (num >= INT32_MIN && num <=  INT32_MAX) { val->flags |= flag_s32b; set_s32b(val,  (int32_t)num); }
+    if (num >=         0 && num <= UINT64_MAX) { val->flags |= flag_u64b; set_u64b(val, (uint64_t)num); }
+    if (num >= INT64_MIN && num <=  INT64_MAX) { val->flags |= flag_s64b; set_s64b(val,  (int64_t)num); }
+}
+
 bool parse_uservalue_int(const char *nptr, uservalue_t * val)
 {
     int64_t snum;
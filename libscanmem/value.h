@@ -153,6 +153,9 @@ bool parse_uservalue_bytearray(char *const *argv, unsigned argc, uservalue_t *va
 bool parse_uservalue_number(const char *nptr, uservalue_t * val); /* parse int or float */
 bool parse_uservalue_int(const char *nptr, uservalue_t * val);
 bool parse_uservalue_float(const char *nptr, uservalue_t * val);
+/* the value parse_uservalue_number() would read from the text of `n` */
+void set_uservalue_int(uservalue_t *val, int64_t n);
+void set_uservalue_float(uservalue_t *val, double num);
 void free_uservalue(uservalue_t *uval);
 void valcpy(value_t * dst, const value_t * src);
 void uservalue2value(value_t * dst, const uservalue_t * src); /* dst.flags must be set beforehand */
@@ -192,4 +195,16 @@ static inline void zero_uservalue(uservalue_t *val)
     memset(val, 0, sizeof(*val));
 }
 
+/* the size of the widest number `flags` allows, in bytes */
+static inline size_t flags_width(match_flags flags)
+{
+    if (flags & flags_64b)
+        return 8;
+    if (flags & flags_32b)
+        return 4;
+    if (flags & flags_16b)
+        return 2;
+    return 1;
+}
+
 #endif /* VALUE_H */
@@ -0,0 +1,290 @@
+/*
+    Sampling many memory locations at a high rate.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "common.h"
+#include "show_message.h"
+#include "watch.h"
+
+#ifndef IOV_MAX
+# define IOV_MAX 1024
+#endif
+
+sm_watch_t *sm_watch_create(pid_t pid, uint64_t interval_ns)
+{
+    sm_watch_t *watch;
+
+    if ((watch = calloc(1, sizeof(sm_watch_t))) == NULL) {
+        show_error("sorry, there was a memory allocation error.\n");
+        return NULL;
+    }
+    watch->pid = pid;
+    watch->interval_ns = interval_ns;
+    watch->memfd = -1;
+    return watch;
+}
+
+void sm_watch_destroy(sm_watch_t *watch)
+{
+    if (watch == NULL)
+        return;
+    sm_watch_stop(watch);
+    if (watch->memfd != -1)
+        close(watch->memfd);
+    free(watch->entries);
+    free(watch);
+}
+
+bool sm_watch_add(sm_watch_t *watch, uintptr_t address, size_t width, match_flags flags,
+                  long match_id)
+{
+    sm_watch_entry_t *entry;
+
+    if (watch->running || width == 0 || width > sizeof(uint64_t))
+        return false;
+
+    if (watch->count == watch->capacity) {
+        size_t capacity = watch->capacity ? watch->capacity * 2 : 16;
+        sm_watch_entry_t *entries;
+
+        if ((entries = realloc(watch->entries, capacity * sizeof(sm_watch_entry_t))) == NULL) {
+            show_error("sorry, there was a memory allocation error.\n");
+            return false;
+        }
+        watch->entries = entries;
+        watch->capacity = capacity;
+    }
+
+    entry = &watch->entries[watch->count++];
+    memset(entry, 0, sizeof(sm_watch_entry_t));
+    entry->address = address;
+    entry->width = width;
+    entry->flags = flags;
+    entry->match_id = match_id;
+    entry->min_gap_ns = UINT64_MAX;
+    return true;
+}
+
+static inline uint64_t elapsed_ns(const struct timespec *from)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - from->tv_sec) * 1000000000ULL + now.tv_nsec - from->tv_nsec;
+}
+
+/* Read every location, in as few system calls as possible. A batch stops
+ * at the first location which cannot be read, the rest is read again. */
+static void read_values(sm_watch_t *watch, struct iovec *local, struct iovec *remote, bool *ok)
+{
+    size_t done = 0;
+
+    while (done < watch->count) {
+        size_t n = MIN(watch->count - done, IOV_MAX);
+        ssize_t nread;
+
+        if (watch->memfd != -1) {
+            nread = pread(watch->memfd, local[done].iov_base, local[done].iov_len,
+                          (off_t) (uintptr_t) remote[done].iov_base);
+            ok[done] = (nread == (ssize_t) local[done].iov_len);
+            done++;
+            continue;
+        }
+
+        nread = process_vm_readv(watch->pid, &local[done], n, &remote[done], n, 0);
+        if (nread == -1) {
+            if (errno == ESRCH) {
+                __atomic_store_n(&watch->failed, true, __ATOMIC_RELEASE);
+                return;
+            }
+#if HAVE_PROCMEM
+            if (errno == ENOSYS) {
+                char mem[32];
+
+                snprintf(mem, sizeof(mem), "/proc/%d/mem", watch->pid);
+                if ((watch->memfd = open(mem, O_RDONLY)) != -1)
+                    continue;
+            }
+#endif
+            /* the first location failed */
+            ok[done++] = false;
+            continue;
+        }
+
+        for ( ; n > 0 && (size_t) nread >= local[done].iov_len; n--, done++) {
+            nread -= local[done].iov_len;
+            ok[done] = true;
+        }
+        if (n > 0)
+            ok[done++] = false;
+    }
+}
+
+static void record(sm_watch_entry_t *entry, uint64_t now, uint64_t value)
+{
+    entry->samples++;
+    if (entry->samples == 1) {
+        entry->first = entry->last = value;
+        return;
+    }
+    if (value == entry->last)
+        return;
+
+    entry->last = value;
+    if (entry->changes > 0) {
+        uint64_t gap = now - entry->last_change_ns;
+
+        entry->min_gap_ns = MIN(entry->min_gap_ns, gap);
+        if (gap > entry->max_gap_ns)
+            entry->max_gap_ns = gap;
+    }
+    entry->changes++;
+    entry->last_change_ns = now;
+
+    /* never overwrite what the reader has not taken yet */
+    if (entry->head - __atomic_load_n(&entry->tail, __ATOMIC_ACQUIRE) < SM_WATCH_HISTORY) {
+        sm_watch_sample_t *sample = &entry->history[entry->head % SM_WATCH_HISTORY];
+
+        sample->time_ns = now;
+        sample->value = value;
+        __atomic_store_n(&entry->head, entry->head + 1, __ATOMIC_RELEASE);
+    } else {
+        entry->lost++;
+    }
+}
+
+static void *sampler(void *arg)
+{
+    sm_watch_t *watch = arg;
+    struct iovec *local, *remote;
+    uint64_t *values, next_ns = 0;
+    bool *ok;
+    struct timespec start;
+    size_t i;
+
+    local = calloc(watch->count, sizeof(struct iovec));
+    remote = calloc(watch->count, sizeof(struct iovec));
+    values = calloc(watch->count, sizeof(uint64_t));
+    ok = calloc(watch->count, sizeof(bool));
+    if (!local || !remote || !values || !ok) {
+        show_error("sorry, there was a memory allocation error.\n");
+        __atomic_store_n(&watch->failed, true, __ATOMIC_RELEASE);
+        goto out;
+    }
+
+    for (i = 0; i < watch->count; i++) {
+        local[i].iov_base = &values[i];
+        local[i].iov_len = watch->entries[i].width;
+        remote[i].iov_base = (void *) watch->entries[i].address;
+        remote[i].iov_len = watch->entries[i].width;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!__atomic_load_n(&watch->stop, __ATOMIC_ACQUIRE)) {
+        uint64_t now = elapsed_ns(&start);
+        struct timespec wakeup;
+
+        read_values(watch, local, remote, ok);
+        if (__atomic_load_n(&watch->failed, __ATOMIC_ACQUIRE))
+            break;
+        for (i = 0; i < watch->count; i++) {
+            if (ok[i])
+                record(&watch->entries[i], now, values[i]);
+            else
+                watch->entries[i].errors++;
+        }
+        watch->rounds++;
+
+        /* the next tick, skipping those which were missed */
+        next_ns += watch->interval_ns;
+        now = elapsed_ns(&start);
+        if (now > next_ns) {
+            uint64_t missed = (now - next_ns) / watch->interval_ns + 1;
+
+            if (now - next_ns > watch->max_lateness_ns)
+                watch->max_lateness_ns = now - next_ns;
+            watch->late_rounds += missed;
+            next_ns += missed * watch->interval_ns;
+        }
+        wakeup.tv_sec = start.tv_sec + (start.tv_nsec + next_ns) / 1000000000ULL;
+        wakeup.tv_nsec = (start.tv_nsec + next_ns) % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL) == EINTR)
+            ;
+    }
+    watch->elapsed_ns = elapsed_ns(&start);
+
+out:
+    free(local);
+    free(remote);
+    free(values);
+    free(ok);
+    return NULL;
+}
+
+bool sm_watch_start(sm_watch_t *watch)
+{
+    if (watch->running || watch->count == 0 || watch->interval_ns == 0)
+        return false;
+
+    watch->stop = false;
+    watch->failed = false;
+    if (pthread_create(&watch->thread, NULL, sampler, watch) != 0) {
+        show_error("failed to start the sampler thread.\n");
+        return false;
+    }
+    watch->running = true;
+    return true;
+}
+
+void sm_watch_stop(sm_watch_t *watch)
+{
+    if (!watch->running)
+        return;
+    __atomic_store_n(&watch->stop, true, __ATOMIC_RELEASE);
+    pthread_join(watch->thread, NULL);
+    watch->running = false;
+}
+
+size_t sm_watch_drain(sm_watch_t *watch, size_t entry, sm_watch_sample_t *out, size_t max)
+{
+    sm_watch_entry_t *e = &watch->entries[entry];
+    unsigned long head = __atomic_load_n(&e->head, __ATOMIC_ACQUIRE);
+    unsigned long tail = e->tail;
+    size_t n = 0;
+
+    for ( ; tail != head && n < max; tail++, n++)
+        out[n] = e->history[tail % SM_WATCH_HISTORY];
+
+    /* hand the slots back to the sampler */
+    __atomic_store_n(&e->tail, tail, __ATOMIC_RELEASE);
+    return n;
+}
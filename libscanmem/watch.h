@@ -0,0 +1,103 @@
+/*
+    Sampling many memory locations at a high rate.
+
+    This file is part of libscanmem.
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "value.h"
+
+/* changes kept per location until they are drained, a power of 2 */
+#define SM_WATCH_HISTORY 256
+
+typedef struct {
+    uint64_t time_ns;           /* since the watch was started */
+    uint64_t value;             /* the bytes read, zero-extended */
+} sm_watch_sample_t;
+
+/* A watched location. The history is a ring buffer with the sampler as the
+ * only writer and the caller of sm_watch_drain() as the only reader, none of
+ * them ever waits for the other. The statistics belong to the sampler, they
+ * can be read once the watch is stopped. */
+typedef struct {
+    uintptr_t address;
+    size_t width;               /* bytes read, up to 8 */
+    match_flags flags;          /* how to show the value */
+    long match_id;              /* -1 if the address was given */
+
+    sm_watch_sample_t history[SM_WATCH_HISTORY];
+    unsigned long head;         /* changes recorded */
+    unsigned long tail;         /* changes drained */
+
+    uint64_t first;             /* first value read */
+    uint64_t last;              /* last value read */
+    unsigned long samples;
+    unsigned long changes;
+    unsigned long lost;         /* changes not recorded, the history was full */
+    unsigned long errors;       /* failed reads */
+    uint64_t last_change_ns;
+    uint64_t min_gap_ns;        /* shortest time between two changes */
+    uint64_t max_gap_ns;        /* longest time between two changes */
+} sm_watch_entry_t;
+
+typedef struct {
+    pid_t pid;
+    uint64_t interval_ns;
+    size_t count;
+    size_t capacity;
+    sm_watch_entry_t *entries;
+    pthread_t thread;
+    bool running;
+    bool stop;                  /* tells the sampler to stop */
+    bool failed;                /* set by the sampler if the target is gone */
+    int memfd;                  /* /proc/pid/mem, without process_vm_readv() */
+
+    /* statistics of the sampler, valid once stopped */
+    unsigned long rounds;
+    unsigned long late_rounds;  /* ticks missed since a round took too long */
+    uint64_t elapsed_ns;
+    uint64_t max_lateness_ns;
+} sm_watch_t;
+
+sm_watch_t *sm_watch_create(pid_t pid, uint64_t interval_ns);
+void sm_watch_destroy(sm_watch_t *watch);
+
+/* watch `width` bytes at `address`, only before the watch is started */
+bool sm_watch_add(sm_watch_t *watch, uintptr_t address, size_t width, match_flags flags,
+                  long match_id);
+
+bool sm_watch_start(sm_watch_t *watch);
+/* stop sampling and wait for the sampler, the history can still be drained */
+void sm_watch_stop(sm_watch_t *watch);
+
+/* Take up to `max` of the changes recorded for `entry` since the last call,
+ * returns how many were taken. */
+size_t sm_watch_drain(sm_watch_t *watch, size_t entry, sm_watch_sample_t *out, size_t max);
+
+static inline bool sm_watch_failed(sm_watch_t *watch)
+{
+    return __atomic_load_n(&watch->failed, __ATOMIC_ACQUIRE);
+}
+
+#endif /* WATCH_H */
@@ -17,12 +17,28 @@
     along with this library.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 
+// A structure with known values for the tests of sm_test.sh, its `hp` goes
+// down by 5 on each SIGUSR1
+static volatile struct {
+    int64_t id;
+    int64_t hp;
+    double speed;
+} probe = { 5555555123, 100, 1.5 };
+
+static void hit(int sig)
+{
+    (void) sig;
+    probe.hp -= 5;
+}
+
 int main(int argc, char **argv)
 {
     uint MB_to_allocate = 1;
@@ -44,7 +60,9 @@ int main(int argc, char **argv)
         }
     }
 
-    pause();
+    signal(SIGUSR1, hit);
+    while (probe.hp > 0)
+        pause();
 
     free(array);
     return 0;
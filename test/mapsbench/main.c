@@ -0,0 +1,195 @@
+/*
+    Compare the maps parser with the getline()/sscanf() one it replaced
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * usage: mapsbench [lines] [rounds]
+ *
+ * Writes a synthetic maps file of `lines` lines (100000 by default), the
+ * way a process with many libraries and anonymous mappings looks like,
+ * then parses it `rounds` times (10 by default) with both parsers.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "maps.h"
+#include "show_message.h"
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static bool write_maps(const char *path, unsigned long lines)
+{
+    static const char *perms[] = { "r--p", "r-xp", "r--p", "rw-p" };
+    unsigned long addr = 0x7f0000000000UL, i;
+    FILE *f;
+
+    if ((f = fopen(path, "w")) == NULL)
+        return false;
+
+    fprintf(f, "55d0c0a00000-55d0c0a21000 rw-p 00000000 00:00 0"
+               "                          [heap]\n");
+    for (i = 1; i < lines - 1; i++) {
+        unsigned long size = 0x1000UL << (i % 5);
+
+        if (i % 8 < 4) {
+            /* the segments of a library */
+            fprintf(f, "%012lx-%012lx %s %08lx fd:01 %lu"
+                       "                    /usr/lib/x86_64-linux-gnu/libbench%lu.so.%lu\n",
+                    addr, addr + size, perms[i % 4], (i % 4) * 0x1000UL,
+                    1000000 + i / 8, i / 8, i % 3);
+        } else {
+            fprintf(f, "%012lx-%012lx rw-p 00000000 00:00 0 \n", addr, addr + size);
+        }
+        addr += size;
+    }
+    fprintf(f, "7ffd1c5e0000-7ffd1c601000 rw-p 00000000 00:00 0"
+               "                          [stack]\n");
+
+    return fclose(f) == 0;
+}
+
+/* The per-line work of the previous parser: getline(), a cleared buffer for
+ * the filename, sscanf() and one allocation per region. The ELF bookkeeping
+ * is the same for both and left out. The filename buffer was taken with
+ * alloca(), which never gives back the stack within the loop and runs out of
+ * it on files this big, so a VLA stands in for it. */
+static long parse_sscanf(const char *path)
+{
+    FILE *maps;
+    char *line = NULL;
+    size_t len = 0, count = 0, capacity = 0;
+    region_t **regions = NULL;
+    long found;
+
+    if ((maps = fopen(path, "r")) == NULL)
+        return -1;
+
+    while (getline(&line, &len, maps) != -1) {
+        unsigned long start, end, offset, inode;
+        char read, write, exec, cow, filename[len];
+        int dev_major, dev_minor;
+        region_t *map;
+
+        memset(filename, '\0', len);
+
+        if (sscanf(line, "%lx-%lx %c%c%c%c %lx %x:%x %lu %[^\n]", &start, &end, &read,
+                &write, &exec, &cow, &offset, &dev_major, &dev_minor, &inode, filename) < 6)
+            continue;
+        if (write != 'w' || read != 'r' || end == start)
+            continue;
+
+        if ((map = calloc(1, sizeof(region_t) + strlen(filename))) == NULL)
+            break;
+        map->start = start;
+        map->size = end - start;
+        map->offset = offset;
+        map->inode = inode;
+        strcpy(map->filename, filename);
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            regions = realloc(regions, capacity * sizeof(region_t *));
+        }
+        regions[count++] = map;
+    }
+
+    found = (long) count;
+    while (count)
+        free(regions[--count]);
+    free(regions);
+    free(line);
+    fclose(maps);
+    return found;
+}
+
+static long parse_table(const char *path)
+{
+    region_table_t *regions;
+    long found = -1;
+
+    if ((regions = rt_init()) == NULL)
+        return -1;
+    if (sm_parsemaps(path, "", regions, REGION_ALL))
+        found = (long) regions->size;
+    rt_destroy(regions);
+    return found;
+}
+
+static void run(const char *name, long (*parse)(const char *), const char *path,
+                unsigned long lines, unsigned rounds)
+{
+    double best = 0, total = 0;
+    long found = 0;
+    unsigned i;
+
+    for (i = 0; i < rounds; i++) {
+        double start = now_ms(), elapsed;
+
+        found = parse(path);
+        elapsed = now_ms() - start;
+        total += elapsed;
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    printf("%-8s %8ld regions  best %8.2f ms  avg %8.2f ms  %6.2f Mlines/s\n",
+           name, found, best, total / rounds, lines / best / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long lines = 100000;
+    unsigned rounds = 10;
+    char path[] = "/tmp/mapsbench.XXXXXX";
+    int fd;
+
+    if (argc >= 2) lines = strtoul(argv[1], NULL, 0);
+    if (argc >= 3) rounds = atoi(argv[2]);
+    if (argc >= 4 || lines < 2 || rounds == 0) {
+        fprintf(stderr, "usage: %s [lines] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    if ((fd = mkstemp(path)) == -1) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    if (!write_maps(path, lines)) {
+        perror(path);
+        unlink(path);
+        return 1;
+    }
+
+    sm_set_log_level(LOG_WARNING);
+    printf("%lu lines, %u rounds\n", lines, rounds);
+    run("sscanf", parse_sscanf, path, lines, rounds);
+    run("parser", parse_table, path, lines, rounds);
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,392 @@
+/*
+    Time the scan routines over synthetic buffers
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * usage: scanbench [-j] [-s size] [-d density] [-r rounds] [filter]
+ *
+ * Runs every scan routine sm_get_scanroutine() hands out, for each data
+ * type, match type and byte order, over a buffer of `size` bytes (4 MiB by
+ * default) at every byte offset, the way a search of the target does. The
+ * buffer holds elements of the width of the type, and a `density` share of
+ * them (0.01 by default) is made to match: they hold the value searched for,
+ * or for the match types against the old value, they changed the way the
+ * match type looks for. Each routine runs `rounds` times (3 by default) and
+ * the best round counts. Only the routines whose "TYPE MATCH" name contains
+ * `filter` are run, if one is given.
+ *
+ * -j prints the results as JSON, to compare the builds of two commits.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "endianness.h"
+#include "scanroutines.h"
+#include "show_message.h"
+#include "value.h"
+
+/* room for the routines and the old values to look past the last element */
+#define PADDING 64
+
+static const struct {
+    const char *name;
+    scan_data_type_t type;
+    size_t width;               /* of the elements in the buffer */
+    bool is_float;
+} data_types[] = {
+    { "INTEGER8",   INTEGER8,   1,  false },
+    { "INTEGER16",  INTEGER16,  2,  false },
+    { "INTEGER32",  INTEGER32,  4,  false },
+    { "INTEGER64",  INTEGER64,  8,  false },
+    { "FLOAT32",    FLOAT32,    4,  true },
+    { "FLOAT64",    FLOAT64,    8,  true },
+    { "ANYINTEGER", ANYINTEGER, 4,  false },
+    { "ANYFLOAT",   ANYFLOAT,   8,  true },
+    { "ANYNUMBER",  ANYNUMBER,  4,  false },
+    /* one length for each kind of routine: a power of two, a small loop
+     * and the generic one */
+    { "BYTEARRAY",  BYTEARRAY,  4,  false },
+    { "BYTEARRAY",  BYTEARRAY,  6,  false },
+    { "BYTEARRAY",  BYTEARRAY,  16, false },
+    { "STRING",     STRING,     4,  false },
+    { "STRING",     STRING,     6,  false },
+    { "STRING",     STRING,     16, false },
+};
+
+static const struct {
+    const char *name;
+    scan_match_type_t match;
+} match_types[] = {
+    { "ANY",         MATCHANY },
+    { "EQUALTO",     MATCHEQUALTO },
+    { "NOTEQUALTO",  MATCHNOTEQUALTO },
+    { "GREATERTHAN", MATCHGREATERTHAN },
+    { "LESSTHAN",    MATCHLESSTHAN },
+    { "RANGE",       MATCHRANGE },
+    { "UPDATE",      MATCHUPDATE },
+    { "NOTCHANGED",  MATCHNOTCHANGED },
+    { "CHANGED",     MATCHCHANGED },
+    { "INCREASED",   MATCHINCREASED },
+    { "DECREASED",   MATCHDECREASED },
+    { "INCREASEDBY", MATCHINCREASEDBY },
+    { "DECREASEDBY", MATCHDECREASEDBY },
+};
+
+/* The numbers in the buffer: the other elements lie between LOW and HIGH,
+ * the matching ones hold what the match type looks for. All of them fit
+ * in every type, an int8_t too. */
+#define LOW       60
+#define HIGH      80
+#define BELOW     42            /* for LESSTHAN LOW - 10, EQUALTO and RANGE */
+#define ABOVE     100           /* for GREATERTHAN HIGH + 10 */
+
+static const char needle[] = "scanmem!matches?";
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+/* xorshift64, the same buffers every run */
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static bool pick(double density)
+{
+    return (next_random() >> 11) * 0x1.0p-53 < density;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool uses_old_values(scan_match_type_t mt)
+{
+    return mt == MATCHUPDATE || mt == MATCHNOTCHANGED || mt == MATCHCHANGED ||
+           mt == MATCHINCREASED || mt == MATCHDECREASED ||
+           mt == MATCHINCREASEDBY || mt == MATCHDECREASEDBY;
+}
+
+/* only the comparisons with a user value have routines for both byte orders */
+static bool has_reverse(size_t i, scan_match_type_t mt)
+{
+    if (data_types[i].type == BYTEARRAY || data_types[i].type == STRING ||
+        data_types[i].type == INTEGER8)
+        return false;
+    return mt == MATCHEQUALTO || mt == MATCHNOTEQUALTO || mt == MATCHGREATERTHAN ||
+           mt == MATCHLESSTHAN || mt == MATCHRANGE;
+}
+
+static void put_number(uint8_t *p, size_t i, double n, bool reverse)
+{
+    size_t width = data_types[i].width;
+
+    if (data_types[i].is_float) {
+        float f = n;
+        double d = n;
+
+        memcpy(p, width == 4 ? (void *) &f : (void *) &d, width);
+    } else {
+        int8_t i8 = n;
+        int16_t i16 = n;
+        int32_t i32 = n;
+        int64_t i64 = n;
+
+        switch (width) {
+        case 1: memcpy(p, &i8, 1); break;
+        case 2: memcpy(p, &i16, 2); break;
+        case 4: memcpy(p, &i32, 4); break;
+        default: memcpy(p, &i64, 8); break;
+        }
+    }
+    if (reverse)
+        swap_bytes_var(p, width);
+}
+
+/* fill `buf` and, for the match types that need them, `old` */
+static unsigned long fill(uint8_t *buf, uint8_t *old, size_t size, size_t i,
+                          scan_match_type_t mt, bool reverse, double density)
+{
+    size_t width = data_types[i].width, pos, k;
+    unsigned long planted = 0;
+
+    memset(buf, 0, size + PADDING);
+    memset(old, 0, size + PADDING);
+    for (pos = 0; pos + width <= size; pos += width) {
+        bool hit = pick(density);
+
+        planted += hit;
+        if (data_types[i].type == BYTEARRAY || data_types[i].type == STRING) {
+            for (k = 0; k < width; k++)
+                buf[pos + k] = hit ? needle[k] : (char) ('a' + next_random() % 26);
+            memcpy(old + pos, buf + pos, width);
+            continue;
+        }
+
+        double n = LOW + next_random() % (HIGH - LOW), was = n;
+
+        if (hit) {
+            switch (mt) {
+            case MATCHGREATERTHAN: n = ABOVE; break;
+            case MATCHINCREASED:
+            case MATCHINCREASEDBY:
+            case MATCHCHANGED:
+            case MATCHNOTCHANGED: was = n - 1; break;
+            case MATCHDECREASED:
+            case MATCHDECREASEDBY: was = n + 1; break;
+            default: n = BELOW; break;
+            }
+        }
+        put_number(buf + pos, i, n, reverse);
+        put_number(old + pos, i, was, reverse);
+    }
+    return planted;
+}
+
+static void user_values(size_t i, scan_match_type_t mt, uservalue_t uv[2],
+                        uint8_t *bytes, wildcard_t *wildcards)
+{
+    size_t width = data_types[i].width;
+    int64_t value;
+
+    if (data_types[i].type == BYTEARRAY || data_types[i].type == STRING) {
+        zero_uservalue(&uv[0]);
+        memcpy(bytes, needle, width);
+        memset(wildcards, FIXED, width);
+        uv[0].bytearray_value = bytes;
+        uv[0].wildcard_value = wildcards;
+        uv[0].string_value = (const char *) bytes;
+        uv[0].flags = width;
+        return;
+    }
+
+    switch (mt) {
+    case MATCHGREATERTHAN: value = HIGH + 10; break;
+    case MATCHLESSTHAN: value = LOW - 10; break;
+    case MATCHRANGE: value = BELOW - 2; break;
+    case MATCHINCREASEDBY:
+    case MATCHDECREASEDBY: value = 1; break;
+    default: value = BELOW; break;
+    }
+    if (data_types[i].is_float) {
+        set_uservalue_float(&uv[0], value);
+        set_uservalue_float(&uv[1], BELOW + 2);
+    } else {
+        set_uservalue_int(&uv[0], value);
+        set_uservalue_int(&uv[1], BELOW + 2);
+    }
+}
+
+/* the flags a previous scan leaves on the elements of the type */
+static uint16_t old_flags(size_t i)
+{
+    switch (data_types[i].type) {
+    case ANYNUMBER:  return flags_all;
+    case ANYINTEGER: return flags_integer;
+    case ANYFLOAT:   return flags_float;
+    case INTEGER8:   return flags_i8b;
+    case INTEGER16:  return flags_i16b;
+    case INTEGER32:  return flags_i32b;
+    case INTEGER64:  return flags_i64b;
+    case FLOAT32:    return flag_f32b;
+    case FLOAT64:    return flag_f64b;
+    default:         return data_types[i].width;
+    }
+}
+
+/* One pass at every byte offset, as sm_searchregions() and, with old values,
+ * sm_checkmatches() do, without the bookkeeping of the matches. */
+static unsigned long scan(scan_routine_t routine, const uint8_t *buf, const uint8_t *old,
+                          size_t size, uint16_t flags, const uservalue_t *uv)
+{
+    unsigned long matches = 0;
+    size_t pos;
+
+    for (pos = 0; pos < size; pos++) {
+        uint16_t saveflags = flags_empty;
+        value_t old_value, *old_ptr = NULL;
+
+        if (old) {
+            memcpy(old_value.bytes, old + pos, sizeof(old_value.bytes));
+            old_value.flags = flags;
+            old_ptr = &old_value;
+        }
+        if (routine((const mem64_t *) (buf + pos), size - pos, old_ptr, uv, &saveflags) > 0)
+            matches++;
+    }
+    return matches;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-j] [-s size] [-d density] [-r rounds] [filter]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = 4 << 20, i, m;
+    double density = 0.01;
+    unsigned rounds = 3;
+    bool json = false, first = true;
+    const char *filter = NULL;
+    uint8_t *buf, *old;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "js:d:r:h")) != -1) {
+        switch (opt) {
+        case 'j': json = true; break;
+        case 's': size = strtoul(optarg, NULL, 0); break;
+        case 'd': density = strtod(optarg, NULL); break;
+        case 'r': rounds = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc)
+        filter = argv[optind++];
+    if (optind < argc || size == 0 || rounds == 0 || density < 0 || density > 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    buf = malloc(size + PADDING);
+    old = malloc(size + PADDING);
+    if (buf == NULL || old == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
+    sm_set_log_level(LOG_WARNING);
+    if (json)
+        printf("{\n  \"size\": %zu,\n  \"density\": %g,\n  \"rounds\": %u,\n  \"results\": [",
+               size, density, rounds);
+    else
+        printf("%zu bytes, density %g, %u rounds\n", size, density, rounds);
+
+    for (i = 0; i < sizeof(data_types) / sizeof(data_types[0]); i++) {
+        for (m = 0; m < sizeof(match_types) / sizeof(match_types[0]); m++) {
+            scan_match_type_t mt = match_types[m].match;
+            int reverse;
+
+            for (reverse = 0; reverse <= has_reverse(i, mt); reverse++) {
+                uservalue_t uv[2];
+                uint8_t bytes[sizeof(needle)];
+                wildcard_t wildcards[sizeof(needle)];
+                scan_routine_t routine;
+                unsigned long planted, matches = 0;
+                double best = 0, bytes_per_ns;
+                char name[64];
+                unsigned r;
+
+                snprintf(name, sizeof(name), "%s %s", data_types[i].name, match_types[m].name);
+                if (filter && strstr(name, filter) == NULL)
+                    continue;
+
+                user_values(i, mt, uv, bytes, wildcards);
+                routine = sm_get_scanroutine(data_types[i].type, mt, uv[0].flags, reverse);
+                if (routine == NULL)
+                    continue;
+
+                planted = fill(buf, old, size, i, mt, reverse, density);
+                for (r = 0; r < rounds; r++) {
+                    double start = now_ns(), elapsed;
+
+                    matches = scan(routine, buf, uses_old_values(mt) ? old : NULL, size,
+                                   old_flags(i), uv);
+                    elapsed = now_ns() - start;
+                    if (r == 0 || elapsed < best)
+                        best = elapsed;
+                }
+                bytes_per_ns = size / best;
+
+                if (json) {
+                    printf("%s\n    { \"type\": \"%s\", \"width\": %zu, \"match\": \"%s\", "
+                           "\"endianness\": \"%s\", \"planted\": %lu, \"matches\": %lu, "
+                           "\"gb_per_s\": %.4f, \"ns_per_byte\": %.4f }",
+                           first ? "" : ",", data_types[i].name, data_types[i].width,
+                           match_types[m].name, reverse ? "reverse" : "native",
+                           planted, matches, bytes_per_ns, 1 / bytes_per_ns);
+                } else {
+                    printf("%-10s %2zu %-11s %-7s %9lu matches %8.3f GB/s %7.3f ns/byte\n",
+                           data_types[i].name, data_types[i].width, match_types[m].name,
+                           reverse ? "reverse" : "native", matches, bytes_per_ns,
+                           1 / bytes_per_ns);
+                }
+                first = false;
+                fflush(stdout);
+            }
+        }
+    }
+    if (json)
+        printf("\n  ]\n}\n");
+
+    free(buf);
+    free(old);
+    return 0;
+}
@@ -1,14 +1,33 @@
 #!/bin/bash
 set -ev
 
+# Paths can be given, as ctest does for the programs it built
+MEMFAKE=${MEMFAKE:-./memfake}
+SCANMEM=${SCANMEM:-../scanmem}
+export PAGER=cat
+
 # Start memfake
-./memfake 4 1 &
+$MEMFAKE 4 1 &
 memfake_pid=$!
+tmpdir=$(mktemp -d)
+trap 'kill $memfake_pid; rm -rf "$tmpdir"' EXIT
 
 # Test runs
 
+# stdin is not a terminal under ctest, so that nothing waits on it
 test_sm () {
-    ../scanmem -p $memfake_pid -e -c "$1"
+    $SCANMEM -p $memfake_pid -e -c "$1" < /dev/null
+}
+
+# run the commands and check that a line of the output matches $2
+expect_sm () {
+    local output
+    output=$(test_sm "$1" 2>&1)
+    if ! grep -q -e "$2" <<< "$output"; then
+        echo "expected \`$2\` from: $1" >&2
+        echo "$output" >&2
+        return 1
+    fi
 }
 
 test_sm "option scan_data_type int8;0;exit"
@@ -32,5 +51,127 @@ done
 test_sm "option scan_data_type bytearray;${huge_bytearray};exit"
 test_sm "option scan_data_type string;\" ${huge_string};exit"
 
-# Clean up
-kill $memfake_pid
+# The probe of memfake: an i64 id, an i64 hp going down by 5 on SIGUSR1
+# and an f64 at 1.5, one after the other
+id=5555555123
+hit="shell kill -USR1 $memfake_pid"
+
+probe=$(test_sm "option scan_data_type int64;${id};list;exit" 2>/dev/null |
+        sed -n 's/^\[ *0\] \([0-9a-f]*\),.*/\1/p')
+test -n "$probe"
+hp=$(printf "%x" $((0x$probe + 8)))
+
+# Recording, hp goes from 100 to 90
+expect_sm "option scan_data_type int64;record start ${tmpdir}/hp.rec;100;${hit};95;${hit};90;record stop;exit" \
+          "^1> record stop"
+expect_sm "record query ${tmpdir}/hp.rec 100 95 90;exit" "^0x${hp}, .* 90, "
+expect_sm "record query ${tmpdir}/hp.rec 100 ? 90;exit" "^0x${hp}, .* 90, "
+expect_sm "record query ${tmpdir}/hp.rec 90 95;exit" "^info: 0 addresses"
+
+# An image keeps the values it was saved with, hp is 85 in memfake
+expect_sm "savecore ${tmpdir}/core;${hit};loadcore ${tmpdir}/core;option scan_data_type int64;90;list;exit" \
+          "^\[ *0\] ${hp}, .* 90, \[I64 \]"
+expect_sm "loadcore ${tmpdir}/core;option scan_data_type int64;${id};exit" "have 1 matches"
+
+# A structure, a field out of range leaves nothing
+expect_sm "struct i64@0 = ${id}, i64@8 in 0..100, f64@16 = 1.5;list;exit" \
+          "^\[ *0\] ${probe}, .* ${id}, \[I64 \]"
+expect_sm "struct i64@0 = ${id}, f64@16 > 2;exit" "have 0 matches"
+
+# Two values near each other, both are matches
+expect_sm "option scan_data_type int64;near ${id} 85 8;list;exit" "^\[ *1\] ${hp}, .* 85, \[I64 \]"
+expect_sm "option scan_data_type int64;near ${id} 85 8;exit" "have 2 matches"
+
+# Areas read at once, hp is 0x55
+expect_sm "readmany ${probe}:8 ${hp}:2 10:4;exit" "^ *${hp}: 55 00$"
+expect_sm "readmany ${probe}:8 ${hp}:2 10:4;exit" "^ *10: unreadable$"
+
+# A dump to a file, and a note of what could not be read, which has to be
+# written for the dump to succeed
+test_sm "dump ${probe} 16 ${tmpdir}/probe.bin;exit"
+test "$(od -An -td8 ${tmpdir}/probe.bin | tr -s ' ')" = " ${id} 85"
+test_sm "dump 10 16 ${tmpdir}/unmapped.bin;exit"
+grep -qx "10-20" ${tmpdir}/unmapped.bin.holes
+mkdir ${tmpdir}/nowhere.bin.holes
+if test_sm "dump 10 16 ${tmpdir}/nowhere.bin;exit"; then
+    exit 1
+fi
+
+# Watching hp while it goes from 85 to 80, until ^C
+$SCANMEM -p $memfake_pid -e -c "watch @${hp}:8/10;exit" < /dev/null > ${tmpdir}/watch.out 2>&1 &
+watch_pid=$!
+sleep 0.5
+kill -USR1 $memfake_pid
+sleep 0.3
+kill -INT $watch_pid
+wait $watch_pid
+grep -q "^info: 0x${hp}: 1 changes .*, 85, \[I64 F64 \] to 80, " ${tmpdir}/watch.out
+
+# Freezing hp at 50 takes it back there after a hit, until scanmem exits
+expect_sm "freeze add int64 ${hp} 50/10;${hit};shell sleep 0.2;readmany ${hp}:2;exit" "^ *${hp}: 32 00$"
+expect_sm "${hit};shell sleep 0.2;readmany ${hp}:2;exit" "^ *${hp}: 2D 00$"
+
+# The daemon: a client finds and reads the id through it and ends it with
+# `exit`. One serving on a socket keeps it from a second one, a socket
+# nobody listens on is taken over.
+cat > ${tmpdir}/client.py <<'PY'
+import socket, struct, sys, time
+
+sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+for attempt in range(50):
+    try:
+        sock.connect(sys.argv[1])
+        break
+    except (ConnectionRefusedError, FileNotFoundError):
+        time.sleep(0.1)
+else:
+    sys.exit('no daemon on ' + sys.argv[1])
+
+def recv(n):
+    data = b''
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        assert chunk, 'the daemon hung up'
+        data += chunk
+    return data
+
+def request(op, payload=b'', tag=7):
+    sock.sendall(struct.pack('=IHHII', len(payload), op, 0, tag, 0) + payload)
+    length, status, _, rtag, _ = struct.unpack('=IHHII', recv(16))
+    assert (status, rtag) == (0, tag), (op, status, rtag)
+    return recv(length)
+
+if len(sys.argv) > 2:
+    probe, id = int(sys.argv[2], 16), int(sys.argv[3])
+    # version, scan, list, read
+    assert struct.unpack('=I', request(1)) == (1,)
+    assert struct.unpack('=Q', request(3, struct.pack('=IIQQ', 1, 0, id, 0))) == (1,)
+    record = request(5, struct.pack('=QII', 0, 16, 0))
+    assert len(record) == 32 and struct.unpack_from('=QQQ', record)[::2] == (probe, id)
+    assert struct.unpack('=qq', request(7, struct.pack('=QII', probe, 16, 0)))[0] == id
+request(2, b'exit')
+PY
+$SCANMEM -p $memfake_pid --daemon=${tmpdir}/sock < /dev/null &
+daemon_pid=$!
+trap 'kill $daemon_pid $memfake_pid; rm -rf "$tmpdir"' EXIT
+for i in $(seq 50); do
+    test -S ${tmpdir}/sock && break
+    sleep 0.1
+done
+status=0
+timeout 5 $SCANMEM -p $memfake_pid --daemon=${tmpdir}/sock < /dev/null || status=$?
+test $status -eq 1
+python3 ${tmpdir}/client.py ${tmpdir}/sock ${probe} ${id}
+wait $daemon_pid
+test ! -e ${tmpdir}/sock
+python3 -c 'import socket, sys; socket.socket(socket.AF_UNIX).bind(sys.argv[1])' ${tmpdir}/sock
+$SCANMEM -p $memfake_pid --daemon=${tmpdir}/sock < /dev/null &
+daemon_pid=$!
+python3 ${tmpdir}/client.py ${tmpdir}/sock
+wait $daemon_pid
+trap 'kill $memfake_pid; rm -rf "$tmpdir"' EXIT
+
+# A failed command makes scanmem fail with -e
+if test_sm "record query;exit"; then
+    exit 1
+fi
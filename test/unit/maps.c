@@ -0,0 +1,164 @@
+/*
+    Test sm_mergemaps() on region tables made by hand
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "maps.h"
+#include "show_message.h"
+
+#define LIB "/usr/lib/libtest.so"
+
+/* append [start, end) of `filename` at `offset`, anonymous without a name */
+static void add(region_table_t *table, uintptr_t start, uintptr_t end, const char *filename,
+                unsigned long offset)
+{
+    region_t *map = rt_alloc(table, strlen(filename));
+
+    map->start = start;
+    map->size = end - start;
+    map->flags.read = map->flags.write = 1;
+    map->offset = offset;
+    map->inode = filename[0] ? 42 : 0;
+    map->id = table->next_id;
+    strcpy(map->filename, filename);
+    CHECK(rt_append(table, map));
+}
+
+static void check_region(const region_table_t *table, size_t i, uintptr_t start, uintptr_t end,
+                         unsigned long offset, bool unscanned)
+{
+    const region_t *r;
+
+    CHECK(i < table->size);
+    if (i >= table->size)
+        return;
+    r = table->regions[i];
+    CHECK(r->start == start);
+    CHECK(r->start + r->size == end);
+    CHECK(r->offset == offset);
+    CHECK(r->flags.unscanned == unscanned);
+    CHECK(rt_get(table, r->id) == r);
+}
+
+static void check_gone(const address_range_t *removed, size_t n, size_t i, uintptr_t start,
+                       uintptr_t end)
+{
+    CHECK(i < n);
+    if (i < n) {
+        CHECK(removed[i].start == start);
+        CHECK(removed[i].end == end);
+    }
+}
+
+/* a mapping split in two by mprotect() stays mapped as a whole */
+static void test_split(void)
+{
+    region_table_t *regions = rt_init(), *fresh = rt_init();
+    address_range_t *removed;
+    size_t n;
+
+    add(regions, 0x1000, 0x5000, LIB, 0);
+    add(fresh, 0x1000, 0x3000, LIB, 0);
+    add(fresh, 0x3000, 0x5000, LIB, 0x2000);
+
+    CHECK(sm_mergemaps(regions, fresh, &removed, &n));
+    CHECK(n == 0);
+    CHECK(regions->size == 2);
+    check_region(regions, 0, 0x1000, 0x3000, 0, false);
+    check_region(regions, 1, 0x3000, 0x5000, 0x2000, false);
+    CHECK(regions->regions[0]->id == 0);
+    CHECK(regions->regions[1]->id != 0);
+
+    free(removed);
+    rt_destroy(regions);
+    rt_destroy(fresh);
+}
+
+/* split, with a hole unmapped and another mapping in the middle */
+static void test_split_holes(void)
+{
+    region_table_t *regions = rt_init(), *fresh = rt_init();
+    address_range_t *removed;
+    size_t n;
+
+    add(regions, 0x1000, 0x9000, "", 0);
+    add(fresh, 0x1000, 0x2000, "", 0);
+    add(fresh, 0x3000, 0x4000, LIB, 0);
+    add(fresh, 0x4000, 0x6000, "", 0);
+    add(fresh, 0x7000, 0x8000, "", 0);
+
+    CHECK(sm_mergemaps(regions, fresh, &removed, &n));
+    CHECK(n == 4);
+    check_gone(removed, n, 0, 0x2000, 0x3000);
+    check_gone(removed, n, 1, 0x3000, 0x4000);
+    check_gone(removed, n, 2, 0x6000, 0x7000);
+    check_gone(removed, n, 3, 0x8000, 0x9000);
+    CHECK(regions->size == 4);
+    check_region(regions, 0, 0x1000, 0x2000, 0, false);
+    check_region(regions, 1, 0x3000, 0x4000, 0, true);
+    check_region(regions, 2, 0x4000, 0x6000, 0, false);
+    check_region(regions, 3, 0x7000, 0x8000, 0, false);
+
+    free(removed);
+    rt_destroy(regions);
+    rt_destroy(fresh);
+}
+
+/* grown, shrunk, unmapped and newly mapped regions */
+static void test_changes(void)
+{
+    region_table_t *regions = rt_init(), *fresh = rt_init();
+    address_range_t *removed;
+    size_t n;
+
+    add(regions, 0x1000, 0x2000, "", 0);
+    add(regions, 0x4000, 0x8000, LIB, 0x1000);
+    add(regions, 0x9000, 0xa000, "", 0);
+    add(regions, 0xc000, 0xd000, "", 0);
+    add(fresh, 0x1000, 0x3000, "", 0);
+    add(fresh, 0x5000, 0x7000, LIB, 0x2000);
+    add(fresh, 0xb000, 0xc000, "", 0);
+
+    CHECK(sm_mergemaps(regions, fresh, &removed, &n));
+    CHECK(n == 4);
+    check_gone(removed, n, 0, 0x4000, 0x5000);
+    check_gone(removed, n, 1, 0x7000, 0x8000);
+    check_gone(removed, n, 2, 0x9000, 0xa000);
+    check_gone(removed, n, 3, 0xc000, 0xd000);
+    CHECK(regions->size == 4);
+    check_region(regions, 0, 0x1000, 0x2000, 0, false);
+    check_region(regions, 1, 0x2000, 0x3000, 0, true);
+    check_region(regions, 2, 0x5000, 0x7000, 0x2000, false);
+    check_region(regions, 3, 0xb000, 0xc000, 0, true);
+    CHECK(regions->regions[0]->id == 0);
+    CHECK(regions->regions[2]->id == 1);
+
+    free(removed);
+    rt_destroy(regions);
+    rt_destroy(fresh);
+}
+
+int main(void)
+{
+    sm_set_log_level(LOG_WARNING);
+    test_split();
+    test_split_holes();
+    test_changes();
+    return failures != 0;
+}
@@ -0,0 +1,243 @@
+/*
+    Test the pointer scan and the map and chain files it saves
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "maps.h"
+#include "pointer.h"
+#include "show_message.h"
+
+#define EXE "/usr/bin/game"
+#define LIB "/usr/lib/libstdc++.so.6"
+
+/* append [start, end) of `filename` loaded at `load_addr` */
+static void add(region_table_t *table, uintptr_t start, uintptr_t end, const char *filename,
+                unsigned long load_addr, region_type_t type)
+{
+    region_t *map = rt_alloc(table, strlen(filename));
+
+    map->start = start;
+    map->size = end - start;
+    map->load_addr = load_addr;
+    map->type = type;
+    map->flags.read = map->flags.write = 1;
+    map->id = table->next_id;
+    strcpy(map->filename, filename);
+    CHECK(rt_append(table, map));
+}
+
+/* the executable with its .bss, a library with a `+` in its name and the heap */
+static region_table_t *make_regions(void)
+{
+    region_table_t *table = rt_init();
+
+    add(table, 0x400000, 0x402000, EXE, 0x400000, REGION_TYPE_EXE);
+    add(table, 0x402000, 0x404000, "", 0x400000, REGION_TYPE_EXE);
+    add(table, 0x1000000, 0x1100000, "[heap]", 0x1000000, REGION_TYPE_HEAP);
+    add(table, 0x7f0000000000, 0x7f0000010000, LIB, 0x7f0000000000, REGION_TYPE_CODE);
+    return table;
+}
+
+static void check_chain(const region_table_t *regions, const sm_ptrchain_t *chain,
+                        const char *text)
+{
+    sm_ptrchain_t parsed;
+    char buf[256];
+    unsigned i;
+
+    CHECK(sm_ptrchain_format(regions, chain, buf, sizeof(buf)) == (int) strlen(text));
+    CHECK(strcmp(buf, text) == 0);
+    CHECK(sm_ptrchain_parse(regions, buf, &parsed));
+    CHECK(parsed.base == chain->base);
+    CHECK(parsed.region_id == chain->region_id);
+    CHECK(parsed.depth == chain->depth);
+    for (i = 0; i < chain->depth && i < parsed.depth; i++)
+        CHECK(parsed.offsets[i] == chain->offsets[i]);
+}
+
+static void test_chains(void)
+{
+    region_table_t *regions = make_regions();
+    sm_ptrchain_t chain, parsed;
+    unsigned i;
+
+    memset(&chain, 0, sizeof(chain));
+    chain.base = 0x401230;
+    chain.region_id = 0;
+    chain.depth = 2;
+    chain.offsets[0] = 0x18;
+    chain.offsets[1] = -0x8;
+    check_chain(regions, &chain, "game+1230 -> +18 -> -8");
+
+    /* the .bss is named after the module loaded at the same address */
+    chain.base = 0x402010;
+    chain.region_id = 1;
+    chain.depth = 1;
+    chain.offsets[0] = 0;
+    check_chain(regions, &chain, "game+2010 -> +0");
+
+    chain.base = 0x7f0000000040;
+    chain.region_id = 3;
+    chain.depth = SM_PTR_MAX_DEPTH;
+    for (i = 0; i < SM_PTR_MAX_DEPTH; i++)
+        chain.offsets[i] = (i % 2) ? -(long) (i * 0x100) : (long) i;
+    check_chain(regions, &chain, "libstdc++.so.6+40 -> +0 -> -100 -> +2 -> -300 -> +4 -> -500 "
+                                 "-> +6 -> -700");
+
+    /* no pointer followed, an unknown module, the heap, out of the module, too deep */
+    CHECK(!sm_ptrchain_parse(regions, "game+1230", &parsed));
+    CHECK(!sm_ptrchain_parse(regions, "other+1230 -> +8", &parsed));
+    CHECK(!sm_ptrchain_parse(regions, "[heap]+10 -> +8", &parsed));
+    CHECK(!sm_ptrchain_parse(regions, "game+8000 -> +8", &parsed));
+    CHECK(!sm_ptrchain_parse(regions, "game+zz -> +8", &parsed));
+    CHECK(!sm_ptrchain_parse(regions, "game+10 -> 8", &parsed));
+    CHECK(!sm_ptrchain_parse(regions, "game+10 -> +0 -> +1 -> +2 -> +3 -> +4 -> +5 -> +6 "
+                                      "-> +7 -> +8", &parsed));
+
+    rt_destroy(regions);
+}
+
+/* the chains to a heap address, through a cycle and past a pointer too far */
+static void test_scan(void)
+{
+    region_table_t *regions = make_regions();
+    sm_ptrmap_entry_t entries[] = {
+        { 0x401000, 0x1000000 },
+        { 0x1000030, 0x1000010 },
+        { 0x1000018, 0x1000018 },
+        { 0x1000010, 0x1000480 },
+        { 0x402010, 0x1000520 },
+        { 0x7f0000000100, 0x1000900 },
+    };
+    sm_ptrmap_t map = { entries, sizeof(entries) / sizeof(entries[0]) };
+    const long expected[][3] = { { -0x20 }, { 0x10, 0x80 }, { 0x18, -0x8, 0x80 },
+                                 { 0x30, 0, 0x80 } };
+    const uintptr_t bases[] = { 0x402010, 0x401000, 0x401000, 0x401000 };
+    const unsigned depths[] = { 1, 2, 3, 3 };
+    bool stop = false;
+    sm_ptrchain_t *chains;
+    ssize_t n;
+    unsigned i, j;
+
+    n = sm_ptrscan(&map, regions, 0x1000500, 3, 0x100, 100, &stop, &chains);
+    CHECK(n == 4);
+    for (i = 0; i < 4 && (ssize_t) i < n; i++) {
+        CHECK(chains[i].base == bases[i]);
+        CHECK(chains[i].region_id == (bases[i] == 0x402010 ? 1u : 0u));
+        CHECK(chains[i].depth == depths[i]);
+        for (j = 0; j < depths[i] && j < chains[i].depth; j++)
+            CHECK(chains[i].offsets[j] == expected[i][j]);
+    }
+    free(chains);
+
+    /* shorter chains only, then only as many as asked for */
+    CHECK(sm_ptrscan(&map, regions, 0x1000500, 2, 0x100, 100, &stop, &chains) == 2);
+    free(chains);
+    CHECK(sm_ptrscan(&map, regions, 0x1000500, 3, 0x100, 1, &stop, &chains) == 1);
+    free(chains);
+    CHECK(sm_ptrscan(&map, regions, 0x1000500, 1, 0x10, 100, &stop, &chains) == 0);
+    free(chains);
+    CHECK(sm_ptrscan(&map, regions, 0x1000500, 0, 0x100, 100, &stop, &chains) == -1);
+
+    rt_destroy(regions);
+}
+
+static void test_map(void)
+{
+    region_table_t *regions = make_regions(), *loaded = rt_init();
+    sm_ptrmap_entry_t entries[] = {
+        { 0x402008, 0x400010 },
+        { 0x1000040, 0x402000 },
+        { 0x401000, 0x1000020 },
+        { 0x1000000, 0x1000020 },
+        { 0x7f0000000100, 0x1000080 },
+        { 0x7f0000000008, 0x7f000000fff8 },
+    };
+    sm_ptrmap_t map = { entries, sizeof(entries) / sizeof(entries[0]) }, *back;
+    char path[] = "/tmp/test_ptrmap.XXXXXX";
+    size_t i;
+    int fd;
+
+    if ((fd = mkstemp(path)) == -1) {
+        failures++;
+        return;
+    }
+    close(fd);
+
+    CHECK(sm_ptrmap_save(&map, regions, path));
+    back = sm_ptrmap_load(path, loaded);
+    CHECK(back != NULL);
+    if (back != NULL) {
+        CHECK(back->count == map.count);
+        for (i = 0; i < map.count && i < back->count; i++) {
+            CHECK(back->entries[i].address == map.entries[i].address);
+            CHECK(back->entries[i].value == map.entries[i].value);
+        }
+        sm_ptrmap_destroy(back);
+    }
+
+    CHECK(loaded->size == regions->size);
+    for (i = 0; i < regions->size && i < loaded->size; i++) {
+        const region_t *a = regions->regions[i], *b = loaded->regions[i];
+
+        CHECK(b->start == a->start);
+        CHECK(b->size == a->size);
+        CHECK(b->load_addr == a->load_addr);
+        CHECK(b->type == a->type);
+        CHECK(b->id == a->id);
+        CHECK(strcmp(b->filename, a->filename) == 0);
+    }
+
+    /* chains saved for the target read back the same against the map file */
+    {
+        sm_ptrchain_t chains[2], *back_chains;
+        FILE *file;
+
+        CHECK(sm_ptrchain_parse(regions, "libstdc++.so.6+8 -> -10", &chains[0]));
+        CHECK(sm_ptrchain_parse(regions, "game+2010 -> +8 -> +0", &chains[1]));
+        CHECK(sm_ptrchains_save(regions, chains, 2, path));
+        if ((file = fopen(path, "a")) != NULL) {
+            fputs("# a comment\nother+10 -> +8\n", file);
+            fclose(file);
+        }
+        CHECK(sm_ptrchains_load(loaded, path, &back_chains) == 2);
+        CHECK(memcmp(back_chains, chains, sizeof(chains)) == 0);
+        free(back_chains);
+    }
+
+    /* a pointer outside the regions is refused */
+    entries[0].address = 0x500000;
+    CHECK(!sm_ptrmap_save(&map, regions, path));
+    CHECK(access(path, F_OK) == -1);
+
+    unlink(path);
+    rt_destroy(regions);
+    rt_destroy(loaded);
+}
+
+int main(void)
+{
+    sm_set_log_level(LOG_NONE);
+    test_chains();
+    test_scan();
+    test_map();
+    return failures != 0;
+}
@@ -0,0 +1,119 @@
+/*
+    Test sm_readmany() against a child holding known bytes
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "scanmem.h"
+#include "show_message.h"
+
+/* more than the chunk sm_readmany() reads neighbours into */
+#define BIG (2 << 20)
+#define SIZE (BIG + (1 << 20))
+
+static uint8_t pattern(size_t i)
+{
+    return (uint8_t) (i * 7 + (i >> 12));
+}
+
+static void check_spans(sm_reader_t *reader, uint8_t *memory, sm_read_span_t *spans,
+                        size_t count)
+{
+    size_t i, total = 0, offset = 0;
+    uint8_t *buf;
+
+    for (i = 0; i < count; i++)
+        total += spans[i].length;
+    if ((buf = malloc(total)) == NULL) {
+        failures++;
+        return;
+    }
+
+    CHECK(sm_readmany(reader, spans, count, buf));
+    for (i = 0; i < count; i++) {
+        CHECK(spans[i].ok);
+        CHECK(memcmp(buf + offset, memory + (spans[i].address - (uintptr_t) memory),
+                     spans[i].length) == 0);
+        offset += spans[i].length;
+    }
+    free(buf);
+}
+
+int main(void)
+{
+    sm_reader_t reader;
+    uint8_t *memory;
+    pid_t child;
+    size_t i;
+
+    if ((memory = malloc(SIZE)) == NULL)
+        return 1;
+    for (i = 0; i < SIZE; i++)
+        memory[i] = pattern(i);
+
+    /* the child has the same bytes at the same addresses */
+    if ((child = fork()) == 0) {
+        /* not left behind if the test crashes */
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        pause();
+        _exit(0);
+    }
+    sm_set_log_level(LOG_WARNING);
+    if (child == -1 || !sm_reader_open(&reader, child)) {
+        kill(child, SIGKILL);
+        return 1;
+    }
+
+    {
+        /* a span longer than the chunk, one within it and one right after */
+        sm_read_span_t spans[] = {
+            { (uintptr_t) memory, BIG, 0 },
+            { (uintptr_t) memory + 100, 16, 0 },
+            { (uintptr_t) memory + BIG, 64, 0 },
+        };
+        check_spans(&reader, memory, spans, 3);
+    }
+    {
+        /* the long one last, overlapping a small one before it */
+        sm_read_span_t spans[] = {
+            { (uintptr_t) memory + 4096, BIG, 0 },
+            { (uintptr_t) memory + 4000, 200, 0 },
+        };
+        check_spans(&reader, memory, spans, 2);
+    }
+    {
+        /* neighbours read together, given out of order */
+        sm_read_span_t spans[] = {
+            { (uintptr_t) memory + 9000, 8, 0 },
+            { (uintptr_t) memory + 10, 4, 0 },
+            { (uintptr_t) memory + 5000, 100, 0 },
+        };
+        check_spans(&reader, memory, spans, 3);
+    }
+
+    sm_reader_close(&reader);
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    free(memory);
+    return failures != 0;
+}
@@ -0,0 +1,182 @@
+/*
+    Test scans through the C API against a child holding known values
+
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "scanmem.h"
+#include "show_message.h"
+
+/* made at run time, so that the code of the test does not hold it */
+static volatile uint64_t seed = 0x5ca1ab1e;
+static uint64_t in_bss;
+static uint64_t *on_heap;
+static uservalue_t value;
+
+/* enough for an asynchronous scan to be seen running */
+#define BULK_SIZE (64 << 20)
+
+/* what the callback of an asynchronous scan was told last */
+static sm_scan_status_t last_status;
+static unsigned long last_matches;
+static unsigned num_calls;
+
+/* whether a match of the session is at `address` */
+static bool has_match(uintptr_t address)
+{
+    sm_match_record_t record;
+    sm_match_iter_t iter;
+
+    sm_match_iter_init(&iter);
+    while (sm_match_iter_next(&iter, &record)) {
+        if (record.address == address)
+            return true;
+    }
+    return false;
+}
+
+/* the regions an early stop left out are searched by the next scan */
+static void test_early_stop(void)
+{
+    CHECK(sm_exec_cmd("reset"));
+    CHECK(sm_exec_cmd("option early_stop 1"));
+    CHECK(sm_scan(MATCHEQUALTO, &value));
+    CHECK(sm_get_num_matches() == 1);
+    CHECK(has_match((uintptr_t) &in_bss));
+
+    CHECK(sm_scan(MATCHEQUALTO, &value));
+    CHECK(has_match((uintptr_t) &in_bss));
+    CHECK(has_match((uintptr_t) on_heap));
+    CHECK(sm_exec_cmd("option early_stop 0"));
+}
+
+static void callback(sm_scan_status_t status, double progress, unsigned long num_matches,
+                     void *data)
+{
+    CHECK(data == &last_status);
+    CHECK(progress >= 0.0 && progress <= 1.0);
+    last_status = status;
+    last_matches = num_matches;
+    num_calls++;
+}
+
+/* whether each call made while a scan runs fails */
+static void check_refused(void)
+{
+    sm_match_record_t record;
+    sm_match_iter_t iter;
+    sm_read_span_t span = { (uintptr_t) &in_bss, sizeof(in_bss), 0 };
+    uint64_t buf;
+    bool ok[7];
+    unsigned i;
+
+    /* a scan seen running before and after a call ran all along */
+    if (sm_get_scan_status() != SM_SCAN_RUNNING)
+        return;
+    ok[0] = sm_scan(MATCHEQUALTO, &value);
+    ok[1] = sm_get_matches(0, 1, &record) > 0;
+    sm_match_iter_init(&iter);
+    ok[2] = sm_match_iter_next(&iter, &record);
+    ok[3] = sm_read_memory((uintptr_t) &in_bss, &buf, sizeof(buf));
+    ok[4] = sm_read_many(&span, 1, &buf);
+    ok[5] = sm_write_memory((uintptr_t) &in_bss, &in_bss, sizeof(in_bss));
+    ok[6] = sm_exec_cmd("reset");
+    if (sm_get_scan_status() != SM_SCAN_RUNNING)
+        return;
+    for (i = 0; i < sizeof(ok) / sizeof(ok[0]); i++)
+        CHECK(!ok[i]);
+}
+
+/* the same matches as a scan run in place, told to the callback */
+static void test_async(void)
+{
+    uint64_t events;
+    int fd = sm_scan_eventfd();
+
+    CHECK(fd != -1);
+    CHECK(sm_exec_cmd("reset"));
+    num_calls = 0;
+    CHECK(sm_scan_async(MATCHEQUALTO, &value, callback, &last_status));
+    check_refused();
+    CHECK(sm_scan_wait() == SM_SCAN_DONE);
+    CHECK(sm_get_scan_status() == SM_SCAN_DONE);
+    CHECK(last_status == SM_SCAN_DONE);
+    CHECK(last_matches == sm_get_num_matches());
+    CHECK(read(fd, &events, sizeof(events)) == sizeof(events) && events == num_calls);
+    CHECK(has_match((uintptr_t) &in_bss));
+    CHECK(has_match((uintptr_t) on_heap));
+
+    /* narrowed down the same way */
+    CHECK(sm_scan_async(MATCHEQUALTO, &value, callback, &last_status));
+    CHECK(sm_scan_wait() == SM_SCAN_DONE);
+    CHECK(has_match((uintptr_t) &in_bss));
+
+    /* a cancelled scan tells so, unless it was done first */
+    CHECK(sm_exec_cmd("reset"));
+    CHECK(sm_scan_async(MATCHEQUALTO, &value, callback, &last_status));
+    sm_scan_cancel();
+    CHECK(sm_scan_wait() == last_status);
+    CHECK(last_status == SM_SCAN_CANCELLED || last_status == SM_SCAN_DONE);
+    CHECK(sm_scan(MATCHEQUALTO, &value));
+}
+
+int main(void)
+{
+    char command[64];
+    uint8_t *bulk;
+    pid_t child;
+
+    in_bss = seed * seed + 1;
+    if ((on_heap = malloc(sizeof(uint64_t))) == NULL)
+        return 1;
+    *on_heap = in_bss;
+    if ((bulk = malloc(BULK_SIZE)) == NULL)
+        return 1;
+    memset(bulk, 0x11, BULK_SIZE);
+
+    /* the child has the values at the same addresses, but not `value` */
+    if ((child = fork()) == 0) {
+        /* not left behind if the test crashes */
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        pause();
+        _exit(0);
+    }
+    set_uservalue_int(&value, (int64_t) in_bss);
+    sm_set_log_level(LOG_WARNING);
+    snprintf(command, sizeof(command), "pid %d", (int) child);
+    if (child == -1 || !sm_init() || !sm_exec_cmd("option scan_data_type int64") ||
+        !sm_exec_cmd(command)) {
+        kill(child, SIGKILL);
+        return 1;
+    }
+
+    test_early_stop();
+    test_async();
+
+    sm_cleanup();
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    free(bulk);
+    free(on_heap);
+    return failures != 0;
+}